@@ -6097,15 +6097,39 @@ class LIBCLUON_API TerminateHandler {
 
 //#include "cluon/cluon.hpp"
 
+// clang-format off
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+// clang-format on
+
+#include <cstdint>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace cluon {
-
+/**
+This class hands over entries from one or more producing threads to its own
+thread, which calls the delegate for every entry in the order of arrival.
+
+The entries are moved through a bounded lock-free ring buffer (multiple
+producers, single consumer). If the ring buffer is full, add() either drops
+the entry or waits until the delegate's thread made room; both cases are
+counted as overflows. The delegate's thread spins briefly for new entries
+before it sleeps, as bursts arrive faster than a sleeping thread wakes up;
+the number of spins adapts to how often spinning paid off. add() wakes the
+sleeping thread (a futex on Linux) when it finds it asleep and before it
+drops an entry; notifyAll() wakes it explicitly.
+*/
 template <class T>
 class LIBCLUON_API NotifyingPipeline {
    private:
@@ -6115,8 +6139,24 @@ class LIBCLUON_API NotifyingPipeline {
     NotifyingPipeline &operator=(NotifyingPipeline &&) = delete;
 
    public:
-    NotifyingPipeline(std::function<void(T &&)> delegate)
-        : m_delegate(delegate) {
+    static constexpr uint32_t DEFAULT_CAPACITY{4096};
+
+    /**
+     * Constructor.
+     *
+     * @param delegate Function to call for every entry.
+     * @param capacity Number of entries in the ring buffer (rounded up to a power of two).
+     * @param waitWhenFull true to let add() wait for room; false to drop entries that do not fit.
+     */
+    NotifyingPipeline(std::function<void(T &&)> delegate, uint32_t capacity = DEFAULT_CAPACITY, bool waitWhenFull = false)
+        : m_delegate(delegate)
+        , m_waitWhenFull(waitWhenFull) {
+        uint64_t size{2};
+        while (size < capacity) { size <<= 1; }
+        m_cells.reset(new Cell[size]);
+        for (uint64_t i{0}; i < size; i++) { m_cells[i].m_sequence.store(i, std::memory_order_relaxed); }
+        m_mask = size - 1;
+
         m_pipelineThread = std::thread(&NotifyingPipeline::processPipeline, this);
 
         // Let the operating system spawn the thread.
@@ -6128,7 +6168,7 @@ class LIBCLUON_API NotifyingPipeline {
         m_pipelineThreadRunning.store(false);
 
         // Wake any waiting threads.
-        m_pipelineCondition.notify_all();
+        notifyAll();
 
         // Joining the thread could fail.
         try {
@@ -6139,65 +6179,186 @@ class LIBCLUON_API NotifyingPipeline {
     }
 
    public:
-    inline void add(T &&entry) noexcept {
-        std::unique_lock<std::mutex> lck(m_pipelineMutex);
-        m_pipeline.emplace_back(entry);
+    /**
+     * This method moves an entry into the pipeline and wakes the delegate's
+     * thread if it sleeps.
+     *
+     * @param entry Entry to add.
+     * @return true if the entry was added; false if it was dropped as the pipeline was full.
+     */
+    inline bool add(T &&entry) noexcept {
+        bool retVal{tryAdd(entry)};
+        if (!retVal) {
+            m_overflows.fetch_add(1, std::memory_order_relaxed);
+            do {
+                // Let the delegate's thread make room before dropping or while waiting for room.
+                notifyAll();
+                std::this_thread::yield();
+                retVal = tryAdd(entry);
+            } while (!retVal && m_waitWhenFull && m_pipelineThreadRunning.load());
+        }
+        // Pairs with the fence in processPipeline: either the delegate's thread sees the entry before it sleeps or this sees it sleeping.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (retVal && m_sleeping.load(std::memory_order_relaxed)) {
+            notifyAll();
+        }
+        return retVal;
+    }
+
+    /**
+     * This method moves all given entries into the pipeline.
+     *
+     * @param entries Entries to add; the vector is emptied but keeps its capacity.
+     */
+    inline void add(std::vector<T> &entries) noexcept {
+        for (auto &entry : entries) { add(std::move(entry)); }
+        entries.clear();
     }
 
-    inline void notifyAll() noexcept { m_pipelineCondition.notify_all(); }
+    inline void notifyAll() noexcept {
+        m_wakeups.fetch_add(1);
+        if (m_sleeping.load()) {
+#ifdef __linux__
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&m_wakeups), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0); // NOLINT
+#else
+            std::lock_guard<std::mutex> lck(m_sleepMutex);
+            m_sleepCondition.notify_all();
+#endif
+        }
+    }
 
     inline bool isRunning() noexcept { return m_pipelineThreadRunning.load(); }
 
+    /**
+     * @return Handle of the thread calling the delegate.
+     */
+    inline std::thread::native_handle_type nativeHandle() noexcept { return m_pipelineThread.native_handle(); }
+
+    /**
+     * @return Number of entries that did not fit into the pipeline right away.
+     */
+    inline uint64_t overflows() const noexcept { return m_overflows.load(std::memory_order_relaxed); }
+
    private:
+    // Claims the next free cell for the entry; the entry is only moved on success.
+    inline bool tryAdd(T &entry) noexcept {
+        uint64_t position{m_addPosition.load(std::memory_order_relaxed)};
+        for (;;) {
+            Cell &cell{m_cells[position & m_mask]};
+            const int64_t DIFFERENCE{static_cast<int64_t>(cell.m_sequence.load(std::memory_order_acquire) - position)};
+            if (0 == DIFFERENCE) {
+                if (m_addPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.m_entry = std::move(entry);
+                    cell.m_sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (0 > DIFFERENCE) {
+                // The cell still holds the entry of the previous round.
+                return false;
+            } else {
+                position = m_addPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    inline bool hasEntry() const noexcept {
+        return (m_takePosition + 1 == m_cells[m_takePosition & m_mask].m_sequence.load(std::memory_order_acquire));
+    }
+
+    inline bool tryTake(T &entry) noexcept {
+        if (!hasEntry()) {
+            return false;
+        }
+        Cell &cell{m_cells[m_takePosition & m_mask]};
+        entry = std::move(cell.m_entry);
+        cell.m_sequence.store(m_takePosition + m_mask + 1, std::memory_order_release);
+        m_takePosition++;
+        return true;
+    }
+
+    static inline void relax() noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
     inline void processPipeline() noexcept {
+        constexpr uint32_t MIN_SPINS{16};
+        constexpr uint32_t MAX_SPINS{4096};
+        uint32_t spins{MIN_SPINS};
+
         // Indicate to caller that we are ready.
         m_pipelineThreadRunning.store(true);
 
         while (m_pipelineThreadRunning.load()) {
-            std::unique_lock<std::mutex> lck(m_pipelineMutex);
-            // Wait until the thread should stop or data is available.
-            m_pipelineCondition.wait(lck, [this] { return (!this->m_pipelineThreadRunning.load() || !this->m_pipeline.empty()); });
-
-            // The condition will automatically lock the mutex after waking up.
-            // As we are locking per entry, we need to unlock the mutex first.
-            lck.unlock();
-
-            uint32_t entries{0};
-            {
-                lck.lock();
-                entries = static_cast<uint32_t>(m_pipeline.size());
-                lck.unlock();
-            }
-            for (uint32_t i{0}; i < entries; i++) {
-                T entry;
-                {
-                    lck.lock();
-                    entry = m_pipeline.front();
-                    lck.unlock();
-                }
-
+            T entry;
+            if (tryTake(entry)) {
                 if (nullptr != m_delegate) {
                     m_delegate(std::move(entry));
                 }
+                continue;
+            }
 
-                {
-                    lck.lock();
-                    m_pipeline.pop_front();
-                    lck.unlock();
-                }
+            bool ready{false};
+            for (uint32_t i{0}; (i < spins) && !ready; i++) {
+                relax();
+                ready = hasEntry();
+            }
+            spins = ready ? (std::min)(2 * spins, MAX_SPINS) : (std::max)(spins / 2, MIN_SPINS);
+            if (ready) {
+                continue;
+            }
+
+            // notifyAll() changes m_wakeups after adding; waiting returns right away if it changed since.
+            const uint32_t WAKEUPS{m_wakeups.load()};
+            m_sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!hasEntry() && m_pipelineThreadRunning.load()) {
+#ifdef __linux__
+                struct timespec timeout {};
+                timeout.tv_nsec = 100 * 1000 * 1000;
+                ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&m_wakeups), FUTEX_WAIT_PRIVATE, WAKEUPS, &timeout, nullptr, 0); // NOLINT
+#else
+                std::unique_lock<std::mutex> lck(m_sleepMutex);
+                m_sleepCondition.wait_for(lck, std::chrono::milliseconds(100), [this, WAKEUPS] {
+                    return (WAKEUPS != this->m_wakeups.load()) || !this->m_pipelineThreadRunning.load();
+                });
+#endif
             }
+            m_sleeping.store(false);
         }
     }
 
    private:
+    struct Cell {
+        std::atomic<uint64_t> m_sequence{0};
+        T m_entry{};
+    };
+
     std::function<void(T &&)> m_delegate;
+    const bool m_waitWhenFull;
 
     std::atomic<bool> m_pipelineThreadRunning{false};
     std::thread m_pipelineThread{};
-    std::mutex m_pipelineMutex{};
-    std::condition_variable m_pipelineCondition{};
 
-    std::deque<T> m_pipeline{};
+    std::unique_ptr<Cell[]> m_cells{};
+    uint64_t m_mask{0};
+    // Producers and consumer work on different cache lines.
+    char m_paddingBeforeAddPosition[64]{};
+    std::atomic<uint64_t> m_addPosition{0};
+    char m_paddingBeforeTakePosition[64]{};
+    uint64_t m_takePosition{0};
+    char m_paddingAfterTakePosition[64]{};
+
+    std::atomic<uint32_t> m_wakeups{0};
+    std::atomic<bool> m_sleeping{false};
+    std::atomic<uint64_t> m_overflows{0};
+#ifndef __linux__
+    std::mutex m_sleepMutex{};
+    std::condition_variable m_sleepCondition{};
+#endif
 };
 } // namespace cluon
 
@@ -6364,6 +6525,9 @@ class LIBCLUON_API UDPSender {
 #else
     #include <netinet/in.h>
 #endif
+#ifdef __linux__
+    #include <linux/filter.h>
+#endif
 // clang-format on
 
 #include <cstdint>
@@ -6377,6 +6541,7 @@ class LIBCLUON_API UDPSender {
 #include <set>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace cluon {
 /**
@@ -6443,6 +6608,57 @@ class LIBCLUON_API UDPReceiver {
      */
     bool isRunning() const noexcept;
 
+    /**
+     * @return Number of datagrams dropped as the delegate's thread fell behind.
+     */
+    uint64_t overflows() const noexcept;
+
+    /**
+     * This method lets the receiving thread call the delegate itself instead
+     * of handing the datagrams over to the delegate's thread. This saves a
+     * thread hop per datagram but delays reading while the delegate runs;
+     * it is meant for delegates that return quickly.
+     *
+     * @param enable true to call the delegate on the receiving thread.
+     */
+    void dispatchInline(bool enable) noexcept;
+
+    /**
+     * This method returns the handles of the receiving thread and, if any, of
+     * the delegate's thread, e.g., to set their CPU affinity or scheduling
+     * policy; the handles are valid as long as this UDPReceiver exists.
+     *
+     * @return Handles of the threads of this UDPReceiver.
+     */
+    std::vector<std::thread::native_handle_type> threads() noexcept;
+
+#ifdef __linux__
+    /**
+     * This method attaches a classic BPF program to the socket that the kernel
+     * runs on every datagram before queueing it: datagrams for which the
+     * program returns 0 are dropped without being copied to user space. The
+     * program sees the datagram from the UDP header on, i.e., the payload
+     * starts at offset 8.
+     *
+     * @param program Instructions of the program; an empty program detaches the attached one.
+     * @return true if the program was attached or detached.
+     */
+    bool setSocketFilter(const std::vector<struct sock_filter> &program) noexcept;
+
+    /**
+     * This method switches the receiving thread to reading up to the given
+     * number of datagrams per system call (recvmmsg) into a preallocated
+     * slab of buffers; the datagrams of a batch are handed over to the
+     * delegate's thread at once. Batches of 1 read datagram by datagram.
+     *
+     * @param numberOfDatagrams Maximum number of datagrams per batch [1 .. MAX_BATCH_SIZE].
+     * @return true if the batch size was set.
+     */
+    bool receiveInBatches(uint32_t numberOfDatagrams) noexcept;
+
+    static constexpr uint32_t MAX_BATCH_SIZE{64};
+#endif
+
    private:
     /**
      * This method closes the socket.
@@ -6453,6 +6669,11 @@ class LIBCLUON_API UDPReceiver {
 
     void readFromSocket() noexcept;
 
+    /**
+     * @return true if the given sender is the local port that an application is using to send data.
+     */
+    bool isSentFromUs(unsigned long sendFromIP, uint16_t sendFromPort) const noexcept;
+
    private:
     int32_t m_socket{-1};
     bool m_isBlockingSocket{true};
@@ -6464,6 +6685,8 @@ class LIBCLUON_API UDPReceiver {
 
     std::atomic<bool> m_readFromSocketThreadRunning{false};
     std::thread m_readFromSocketThread{};
+    std::atomic<uint32_t> m_batchSize{1};
+    std::atomic<bool> m_dispatchInline{false};
 
    private:
     std::function<void(std::string &&, std::string &&, std::chrono::system_clock::time_point)> m_delegate{};
@@ -6607,6 +6830,11 @@ class LIBCLUON_API TCPConnection {
      */
     bool isRunning() const noexcept;
 
+    /**
+     * @return Number of times reading had to wait for the delegate's thread.
+     */
+    uint64_t overflows() const noexcept;
+
     /**
      * Send a given string.
      *
@@ -8118,19 +8346,268 @@ inline std::pair<bool, cluon::data::Envelope> extractEnvelope(std::istream &in)
     return std::make_pair(retVal, env);
 }
 
+/**
+ * This function decodes the given data with the fixed-layout codec that
+ * cluon-msc generates for messages with scalar fields only.
+ *
+ * @return true if the message has such a codec; false to use a FromProtoVisitor.
+ */
+template <typename T>
+inline auto decodeWithFixedLayout(const char *data, std::size_t size, T &msg, int) noexcept -> decltype(msg.decodeFrom(data, size), bool()) {
+    msg.decodeFrom(data, size);
+    return true;
+}
+
+template <typename T>
+inline bool decodeWithFixedLayout(const char * /*data*/, std::size_t /*size*/, T & /*msg*/, long) noexcept {
+    return false;
+}
+
+/**
+ * This function encodes the given message with the fixed-layout codec that
+ * cluon-msc generates for messages with scalar fields only.
+ *
+ * @return true if the message has such a codec; false to use a ToProtoVisitor.
+ */
+template <typename T>
+inline auto encodeWithFixedLayout(const T &msg, std::string &data, int) noexcept -> decltype(msg.encodeTo(nullptr, 0), bool()) {
+    char buffer[T::MAX_ENCODED_SIZE];
+    data.assign(buffer, msg.encodeTo(buffer, sizeof(buffer)));
+    return true;
+}
+
+template <typename T>
+inline bool encodeWithFixedLayout(const T & /*msg*/, std::string & /*data*/, long) noexcept {
+    return false;
+}
+
 /**
  * @return Extract a given Envelope's payload into the desired type.
  */
 template <typename T>
 inline T extractMessage(cluon::data::Envelope &&envelope) noexcept {
-    cluon::FromProtoVisitor decoder;
+    T msg;
+    const std::string DATA{envelope.serializedData()};
+    if (!decodeWithFixedLayout(DATA.data(), DATA.size(), msg, 0)) {
+        cluon::FromProtoVisitor decoder;
+
+        std::stringstream sstr(DATA);
+        decoder.decodeFrom(sstr);
+
+        msg.accept(decoder);
+    }
+    return msg;
+}
+
+} // namespace cluon
+
+#endif
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CLUON_ENVELOPEREADER_HPP
+#define CLUON_ENVELOPEREADER_HPP
+
+//#include "cluon/cluon.hpp"
+//#include "cluon/cluonDataStructures.hpp"
+//#include "cluon/FromProtoVisitor.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+namespace cluon {
+/**
+ * This class is a non-owning view of an Envelope: instead of copying the
+ * payload into a std::string, serializedData() points into the bytes that
+ * the view was decoded from. Thus, a view is only valid as long as these
+ * bytes are; envelope() creates an owning copy on request.
+ *
+ * @code
+ * cluon::EnvelopeView view;
+ * if (view.decode(data, size) && (opendlv::proxy::GroundSteeringRequest::ID() == view.dataType())) {
+ *     auto msg = cluon::extractMessage<opendlv::proxy::GroundSteeringRequest>(view);
+ * }
+ * @endcode
+ */
+class LIBCLUON_API EnvelopeView {
+   public:
+    /**
+     * This method decodes a Proto-encoded Envelope without OD4 header.
+     *
+     * @param data Bytes to decode; they must outlive the view.
+     * @param size Number of bytes.
+     * @return true if the bytes hold a well-formed Envelope.
+     */
+    bool decode(const char *data, std::size_t size) noexcept;
+
+    int32_t dataType() const noexcept;
+    /**
+     * @return Pointer to the payload inside the decoded bytes.
+     */
+    const char *serializedData() const noexcept;
+    std::size_t serializedDataSize() const noexcept;
+    cluon::data::TimeStamp sent() const noexcept;
+    cluon::data::TimeStamp received() const noexcept;
+    cluon::data::TimeStamp sampleTimeStamp() const noexcept;
+    uint32_t senderStamp() const noexcept;
+
+    /**
+     * @return Owning copy of the viewed Envelope.
+     */
+    cluon::data::Envelope envelope() const noexcept;
+
+   private:
+    static bool readVarInt(const char *&position, const char *end, uint64_t &value) noexcept;
+    static bool decodeTimeStamp(const char *data, std::size_t size, cluon::data::TimeStamp &timeStamp) noexcept;
+
+   private:
+    int32_t m_dataType{0};
+    const char *m_serializedData{nullptr};
+    std::size_t m_serializedDataSize{0};
+    cluon::data::TimeStamp m_sent{};
+    cluon::data::TimeStamp m_received{};
+    cluon::data::TimeStamp m_sampleTimeStamp{};
+    uint32_t m_senderStamp{0};
+};
+
+/**
+ * This class extracts Envelopes in the format of extractEnvelope, i.e.,
+ *
+ *    0x0D 0xA4 LEN0 LEN1 LEN2 Proto-encoded cluon::data::Envelope
+ *
+ * as EnvelopeViews without allocating per Envelope. It reads from
+ *
+ * - a stream, e.g., a .rec file: the stream is read in chunks into a buffer
+ *   that is reused and only grows for Envelopes larger than the buffer,
+ * - memory, e.g., a memory-mapped .rec file: the views point into the memory,
+ * - bytes handed over with append(), e.g., the chunks of a TCP stream: an
+ *   incomplete Envelope is kept until the rest of it was appended.
+ *
+ * Views into the buffer are valid until the next call to next() or append();
+ * views into memory are valid as long as the memory is. Bytes that do not
+ * start with an OD4 header are skipped.
+ *
+ * @code
+ * std::fstream recFile("recording.rec", std::ios::in | std::ios::binary);
+ * cluon::EnvelopeReader reader(recFile);
+ * cluon::EnvelopeView view;
+ * while (reader.next(view)) {
+ *     std::cout << view.dataType() << ": " << view.serializedDataSize() << " bytes" << std::endl;
+ * }
+ * @endcode
+ */
+class LIBCLUON_API EnvelopeReader {
+   private:
+    EnvelopeReader(const EnvelopeReader &) = delete;
+    EnvelopeReader(EnvelopeReader &&)      = delete;
+    EnvelopeReader &operator=(const EnvelopeReader &) = delete;
+    EnvelopeReader &operator=(EnvelopeReader &&) = delete;
+
+   public:
+    /**
+     * Constructor to read from bytes handed over with append().
+     */
+    EnvelopeReader() noexcept;
+
+    /**
+     * Constructor to read from a stream.
+     *
+     * @param in Stream to read from; it must outlive the reader.
+     * @param bufferSize Initial size of the reused buffer.
+     */
+    explicit EnvelopeReader(std::istream &in, std::size_t bufferSize = 64 * 1024) noexcept;
+
+    /**
+     * Constructor to read from memory.
+     *
+     * @param data Bytes to read from; they must outlive the views.
+     * @param size Number of bytes.
+     */
+    EnvelopeReader(const char *data, std::size_t size) noexcept;
+
+    /**
+     * This method appends bytes to the buffer of a reader without stream.
+     *
+     * @param data Bytes to append.
+     * @param size Number of bytes.
+     */
+    void append(const char *data, std::size_t size) noexcept;
+
+    /**
+     * This method extracts the next Envelope.
+     *
+     * @param view View to receive the next Envelope.
+     * @return true if there was a next Envelope; false at the end of the
+     *         input or if only an incomplete Envelope is left.
+     */
+    bool next(EnvelopeView &view) noexcept;
+
+    /**
+     * @return Offset of the Envelope last returned by next() from the beginning of the input.
+     */
+    uint64_t offset() const noexcept;
+
+    /**
+     * @return Offset behind the Envelope last returned by next() from the beginning of the input.
+     */
+    uint64_t position() const noexcept;
+
+    /**
+     * @return Number of bytes skipped as they did not start with an OD4 header.
+     */
+    uint64_t skippedBytes() const noexcept;
+
+   private:
+    // Makes sure that the given number of bytes behind m_begin are available.
+    bool require(std::size_t bytes) noexcept;
+    // Moves the unread bytes to the front of the buffer.
+    void compact() noexcept;
+
+   private:
+    std::istream *m_in{nullptr};
+    bool m_ownsBuffer{true};
+    std::vector<char> m_buffer{};
+    const char *m_data{nullptr};
+    std::size_t m_size{0};
+    std::size_t m_begin{0};
+    uint64_t m_offset{0};
+    uint64_t m_position{0};
+    uint64_t m_skippedBytes{0};
+};
 
-    std::stringstream sstr(envelope.serializedData());
-    decoder.decodeFrom(sstr);
+/**
+ * This class presents memory as read-only input to a std::istream without copying.
+ */
+class LIBCLUON_API MemoryStreamBuffer : public std::streambuf {
+   public:
+    MemoryStreamBuffer(const char *data, std::size_t size) noexcept {
+        char *begin = const_cast<char *>(data);
+        setg(begin, begin, begin + size);
+    }
+};
 
+/**
+ * @return Extract the payload of a given EnvelopeView into the desired type
+ *         without copying the payload.
+ */
+template <typename T>
+inline T extractMessage(const EnvelopeView &view) noexcept {
     T msg;
-    msg.accept(decoder);
+    if (!decodeWithFixedLayout(view.serializedData(), view.serializedDataSize(), msg, 0)) {
+        MemoryStreamBuffer buffer(view.serializedData(), view.serializedDataSize());
+        std::istream in(&buffer);
 
+        cluon::FromProtoVisitor decoder;
+        decoder.decodeFrom(in, msg);
+    }
     return msg;
 }
 
@@ -8858,21 +9335,39 @@ class LIBCLUON_API LCMToGenericMessage {
 
 //#include "cluon/Time.hpp"
 //#include "cluon/ToProtoVisitor.hpp"
+//#include "cluon/NotifyingPipeline.hpp"
 //#include "cluon/UDPReceiver.hpp"
 //#include "cluon/UDPSender.hpp"
 //#include "cluon/cluon.hpp"
 //#include "cluon/cluonDataStructures.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
-#include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace cluon {
+#ifdef __linux__
+/**
+ * This function generates a classic BPF program for UDPReceiver::setSocketFilter
+ * that drops OD4 Envelopes with a dataType other than the given ones. The
+ * dataType is the first field of an Envelope; the program compares its
+ * VarInt encoding with the encodings of the given message identifiers.
+ * Datagrams that are too short or do not start like an OD4 Envelope pass.
+ *
+ * @param dataTypes Message identifiers to pass.
+ * @return Instructions of the program.
+ */
+inline std::vector<struct sock_filter> dataTypeSocketFilter(const std::vector<int32_t> &dataTypes) noexcept;
+#endif
+
 /**
 This class provides an interface to an OpenDaVINCI v4 session. An OpenDaVINCI
 v4 session allows the automatic exchange of time-stamped Envelopes carrying
@@ -8899,6 +9394,7 @@ cluon::OD4Session od4{111};
 
 od4.dataTrigger(cluon::data::TimeStamp::ID(), [](cluon::data::Envelope &&envelope){ std::cout << "Received cluon::data::TimeStamp" << std::endl;});
 od4.dataTrigger(MyMessage::ID(), [](cluon::data::Envelope &&envelope){ std::cout << "Received MyMessage" << std::endl;});
+od4.dataTrigger(MyMessage::ID(), 3, [](cluon::data::Envelope &&envelope){ std::cout << "Received MyMessage from sender 3" << std::endl;});
 
 // Do something in parallel.
 
@@ -8938,6 +9434,7 @@ class LIBCLUON_API OD4Session {
      *        to have both: a delegate for "catch-all" and the data-triggered ones.
      */
     OD4Session(uint16_t CID, std::function<void(cluon::data::Envelope &&envelope)> delegate = nullptr) noexcept;
+    ~OD4Session() noexcept;
 
     /**
      * This method will send a given Envelope to this OpenDaVINCI v4 session.
@@ -8957,16 +9454,79 @@ class LIBCLUON_API OD4Session {
     bool dataTrigger(int32_t messageIdentifier, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept;
 
     /**
-     * This method sets a delegate to be called time-triggered using the
-     * specified frequency until the delegate returns false. This method
-     * blocks until the delegate has returned false or threw an exception.
-     * Thus, this method is typically called as last statement in a main
-     * function of a program.
+     * This method sets a delegate to be called data-triggered on arrival
+     * of a new Envelope for a given message identifier from a given sender.
+     * It takes precedence over a delegate for the message identifier from
+     * any sender. Envelopes without delegate are dropped before their payload
+     * is decoded.
      *
-     * @param freq Frequency in Hertz to run the given delegate.
-     * @param delegate Function to call according to the given frequency.
-     */
-    void timeTrigger(float freq, std::function<bool()> delegate) noexcept;
+     * @param messageIdentifier Message identifier to assign a delegate.
+     * @param senderStamp Sender stamp to assign a delegate.
+     * @param delegate Function to call on newly arriving Envelopes; setting it to nullptr will erase it.
+     * @return true if the given delegate could be successfully set or unset.
+     */
+    bool dataTrigger(int32_t messageIdentifier, uint32_t senderStamp, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept;
+
+    /**
+     * This method lets the kernel drop the Envelopes without data-triggered
+     * delegate before they are copied to user space (Linux only). The socket
+     * filter (cf. dataTypeSocketFilter) is regenerated whenever a data-triggered
+     * delegate is set or unset. It is not available with a "catch-all" delegate.
+     *
+     * @param enable true to filter in the kernel; false to remove the filter.
+     * @return true if the filter was set or removed.
+     */
+    bool filterInKernel(bool enable) noexcept;
+
+    /**
+     * This method lets the receiving thread read up to the given number of
+     * datagrams per system call (Linux only; cf. UDPReceiver::receiveInBatches).
+     *
+     * @param numberOfDatagrams Maximum number of datagrams per batch; 1 reads datagram by datagram.
+     * @return true if the batch size was set.
+     */
+    bool receiveInBatches(uint32_t numberOfDatagrams) noexcept;
+
+    /**
+     * This method lets the receiving thread decode the Envelopes itself instead
+     * of handing the datagrams over to a separate thread (cf.
+     * UDPReceiver::dispatchInline). The delegates are looked up without locking
+     * in either mode. No Envelope is received while a delegate runs, so only the
+     * data-triggered delegates of the message identifiers selected with
+     * runInline, and a "catch-all" delegate, are called on the receiving thread;
+     * the Envelopes for all other delegates are handed over to a separate thread.
+     *
+     * @param enable true to decode the Envelopes on the receiving thread.
+     */
+    void dispatchInline(bool enable) noexcept;
+
+    /**
+     * This method selects the data-triggered delegates of a message identifier
+     * to be called on the receiving thread while dispatchInline is enabled; they
+     * must return quickly.
+     *
+     * @param messageIdentifier Message identifier whose delegates return quickly.
+     * @param enable true to call its delegates on the receiving thread.
+     * @return true if the selection was changed.
+     */
+    bool runInline(int32_t messageIdentifier, bool enable) noexcept;
+
+    /**
+     * @return Handles of the threads receiving and dispatching the Envelopes (cf. UDPReceiver::threads).
+     */
+    std::vector<std::thread::native_handle_type> receivingThreads() noexcept;
+
+    /**
+     * This method sets a delegate to be called time-triggered using the
+     * specified frequency until the delegate returns false. This method
+     * blocks until the delegate has returned false or threw an exception.
+     * Thus, this method is typically called as last statement in a main
+     * function of a program.
+     *
+     * @param freq Frequency in Hertz to run the given delegate.
+     * @param delegate Function to call according to the given frequency.
+     */
+    void timeTrigger(float freq, std::function<bool()> delegate) noexcept;
 
     /**
      * This method will send a given message to this OpenDaVINCI v4 session.
@@ -8979,13 +9539,17 @@ class LIBCLUON_API OD4Session {
     void send(T &message, const cluon::data::TimeStamp &sampleTimeStamp = cluon::data::TimeStamp(), uint32_t senderStamp = 0) noexcept {
         try {
             std::lock_guard<std::mutex> lck(m_senderMutex);
-            cluon::ToProtoVisitor protoEncoder;
 
             cluon::data::Envelope envelope;
             {
                 envelope.dataType(static_cast<int32_t>(message.ID()));
-                message.accept(protoEncoder);
-                envelope.serializedData(protoEncoder.encodedData());
+                std::string data;
+                if (!encodeWithFixedLayout(message, data, 0)) {
+                    cluon::ToProtoVisitor protoEncoder;
+                    message.accept(protoEncoder);
+                    data = protoEncoder.encodedData();
+                }
+                envelope.serializedData(data);
                 envelope.sent(cluon::time::now());
                 envelope.sampleTimeStamp((0 == (sampleTimeStamp.seconds() + sampleTimeStamp.microseconds())) ? envelope.sent() : sampleTimeStamp);
                 envelope.senderStamp(senderStamp);
@@ -9001,6 +9565,55 @@ class LIBCLUON_API OD4Session {
    private:
     void callback(std::string &&data, std::string &&from, std::chrono::system_clock::time_point &&timepoint) noexcept;
     void sendInternal(std::string &&dataToSend) noexcept;
+    // Regenerates the socket filter; m_mapOfDataTriggeredDelegatesMutex must be held.
+    bool updateKernelFilter() noexcept;
+    // Publishes a copy of m_mapOfDataTriggeredDelegates for callback(); m_mapOfDataTriggeredDelegatesMutex must be held.
+    void publishDataTriggers();
+    // Calls the data-triggered delegate for an Envelope handed over by callback().
+    void dispatchDeferred(cluon::data::Envelope &&envelope) noexcept;
+    bool setDataTrigger(int32_t messageIdentifier, int64_t senderStamp, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept;
+
+   public:
+    using Delegate = std::function<void(cluon::data::Envelope &&envelope)>;
+    // Sender stamp of the delegates for any sender.
+    static constexpr int64_t ANY_SENDER{-1};
+
+    /**
+     * Immutable hash table with open addressing that maps message identifier
+     * and sender stamp to a delegate; callback() looks the delegates up in the
+     * latest one without locking.
+     */
+    class DataTriggerTable {
+       public:
+        struct Slot {
+            int32_t m_dataType{0};
+            int64_t m_senderStamp{0};
+            Delegate m_delegate{nullptr};
+            // true if the delegate may be called on the receiving thread.
+            bool m_inline{false};
+        };
+
+        DataTriggerTable(const std::map<std::pair<int32_t, int64_t>, Delegate> &delegates, const std::set<int32_t> &inlineDataTypes);
+
+        /**
+         * @return Slot for the sender, else the one for any sender, else nullptr.
+         */
+        const Slot *find(int32_t dataType, uint32_t senderStamp) const noexcept;
+        bool empty() const noexcept;
+        /**
+         * @return Number of slots, a power of two; a key is probed from hash() masked with capacity() - 1 on.
+         */
+        std::size_t capacity() const noexcept;
+        static std::size_t hash(int32_t dataType, int64_t senderStamp) noexcept;
+
+       private:
+        const Slot *lookup(int32_t dataType, int64_t senderStamp) const noexcept;
+
+       private:
+        std::vector<Slot> m_slots{};
+        std::size_t m_mask{0};
+        std::size_t m_size{0};
+    };
 
    private:
     std::unique_ptr<cluon::UDPReceiver> m_receiver;
@@ -9011,7 +9624,18 @@ class LIBCLUON_API OD4Session {
     std::function<void(cluon::data::Envelope &&envelope)> m_delegate{nullptr};
 
     std::mutex m_mapOfDataTriggeredDelegatesMutex{};
-    std::unordered_map<int32_t, std::function<void(cluon::data::Envelope &&envelope)>, UseUInt32ValueAsHashKey> m_mapOfDataTriggeredDelegates{};
+    std::map<std::pair<int32_t, int64_t>, Delegate> m_mapOfDataTriggeredDelegates{};
+    std::set<int32_t> m_inlineDataTypes{};
+    bool m_filterInKernel{false};
+
+    // Calls the delegates that are not run inline; created when dispatchInline is enabled first.
+    std::unique_ptr<cluon::NotifyingPipeline<cluon::data::Envelope>> m_deferredDelegates{};
+    std::atomic<bool> m_dispatchInline{false};
+
+    // Immutable copies of m_mapOfDataTriggeredDelegates; callback() reads the latest one.
+    // Replaced copies are kept until destruction as callback() might still use them.
+    std::atomic<const DataTriggerTable *> m_dataTriggers{nullptr};
+    std::vector<std::unique_ptr<const DataTriggerTable>> m_publishedDataTriggers{};
 };
 
 } // namespace cluon
@@ -9253,6 +9877,7 @@ class LIBCLUON_API Player {
 #include <cstddef>
 #include <cstdint>
 #include <atomic>
+#include <chrono>
 #include <string>
 #include <utility>
 
@@ -9323,6 +9948,152 @@ class LIBCLUON_API SharedMemory {
      */
     std::pair<bool, cluon::data::TimeStamp> getTimeStamp() noexcept;
 
+   public:
+    /**
+     * Shared memory areas with a sequence counter (cf. hasSequence()) carry a
+     * versioned header behind the user data that describes the samples: the
+     * sample time stamp, number and publish time of the current sample as
+     * well as the width, height and pixel format of the images. setTimeStamp() and
+     * getTimeStamp() then use plain atomic stores and loads instead of the
+     * modification time of the file for timestamping; the writer still
+     * updates that file for readers that do not know about the header.
+     *
+     * This method is only allowed for the creator of the shared memory area.
+     *
+     * @param width Width of the images in pixels.
+     * @param height Height of the images in pixels.
+     * @param pixelFormat FourCC code of the pixel format, e.g., 'B' | 'G' << 8 | 'R' << 16 | 'A' << 24.
+     * @return true if the format was stored; false without a header or for readers.
+     */
+    bool setFormat(uint32_t width, uint32_t height, uint32_t pixelFormat) noexcept;
+
+    /**
+     * @param width Width of the images in pixels.
+     * @param height Height of the images in pixels.
+     * @param pixelFormat FourCC code of the pixel format.
+     * @return true if the writer announced the format of its images.
+     */
+    bool getFormat(uint32_t &width, uint32_t &height, uint32_t &pixelFormat) const noexcept;
+
+    /**
+     * This method returns the number of the current sample, i.e., the sample
+     * borrowed with borrowSlot() or the sample of the latest setTimeStamp().
+     * The writer counts every sample from 1 on; a gap means missed samples.
+     *
+     * @return Number of the current sample or 0 without a header.
+     */
+    uint32_t sampleNumber() const noexcept;
+
+    /**
+     * This method returns when the writer published the current sample, i.e.,
+     * the sample borrowed with borrowSlot() or the sample made consistent by
+     * the latest unlock(), on CLOCK_MONOTONIC. Unlike the sample time stamp,
+     * which is the recording time when a recording is replayed, it can be
+     * compared with the time a reader woke up.
+     *
+     * @return Microseconds on CLOCK_MONOTONIC or 0 without a header.
+     */
+    int64_t publishedAt() const noexcept;
+
+   public:
+    /**
+     * When the environment variable CLUON_SHAREDMEMORY_SEQUENCE is set to 1
+     * while creating a shared memory area, a sequence counter is appended
+     * behind the user data. The creating process then acts as writer: lock()
+     * makes the counter odd and unlock() makes it even again and wakes all
+     * readers waiting in waitForSequence(). Thus, readers can wait for new
+     * samples and copy them without taking the lock (seqlock):
+     *
+     * uint32_t s = sharedMemory.waitForSequence(lastSequence, timeout);
+     * // copy data() and read getTimeStamp()
+     * if (sharedMemory.sequenceUnchanged(s)) { lastSequence = s; // use copy }
+     *
+     * Readers that do not know about the sequence counter continue to use
+     * lock() and wait() as the counter lives outside of the announced size.
+     *
+     * @return true when the creator of this shared memory area maintains a sequence counter.
+     */
+    bool hasSequence() const noexcept;
+
+    /**
+     * This method waits until the sequence counter is even and differs from
+     * lastSequence, i.e., until a new sample was completely written. Without
+     * a sequence counter, this method falls back to wait() and returns
+     * lastSequence + 2.
+     *
+     * @param lastSequence Sequence counter of the last sample seen by the caller.
+     * @param timeout Maximum time to wait.
+     * @return New sequence counter or lastSequence in case of a timeout.
+     */
+    uint32_t waitForSequence(uint32_t lastSequence, std::chrono::microseconds timeout) noexcept;
+
+    /**
+     * @param sequence Sequence counter returned by waitForSequence before reading the data.
+     * @return true when the writer has not touched the data since sequence was returned.
+     */
+    bool sequenceUnchanged(uint32_t sequence) const noexcept;
+
+   public:
+    /**
+     * When the environment variable CLUON_SHAREDMEMORY_SLOTS is set to 3 or 4
+     * while creating a shared memory area, the area holds that
+     * many samples of size() bytes (the first slot is data()) next to a
+     * sequence counter. The writer fills the slot returned by beginSlot() and
+     * publishes it with commitSlot(); it never touches the newest slot or a
+     * slot borrowed by a reader and thus, never waits for readers. Readers
+     * borrow the newest slot without copying:
+     *
+     * uint32_t s = sharedMemory.waitForSequence(lastSequence, timeout);
+     * cluon::data::TimeStamp ts;
+     * const char *sample = sharedMemory.borrowSlot(ts);
+     * if (nullptr != sample) { lastSequence = s; // use sample; sharedMemory.returnSlot(); }
+     *
+     * With n slots, n - 2 readers can borrow slots at the same time; other
+     * values than 3 and 4 are ignored and create an area without slots.
+     * Readers must know about the slots as data() only refers to the first
+     * slot.
+     *
+     * A borrowed slot is counted in the shared memory area. Destroying the
+     * SharedMemory returns it, but a reader that crashes or is killed while
+     * holding a slot never does: the slot stays pinned until the writer
+     * creates the area anew, and one reader less can borrow a slot at the
+     * same time. With 3 slots, beginSlot() then returns nullptr while any
+     * other reader holds a slot.
+     *
+     * @return Number of sample slots in this shared memory area.
+     */
+    uint32_t slots() const noexcept;
+
+    /**
+     * This method returns a slot for the writer to fill.
+     *
+     * @return Pointer to a slot of size() bytes or nullptr if all slots are in use.
+     */
+    char *beginSlot() noexcept;
+
+    /**
+     * This method publishes the slot returned by beginSlot() as the newest
+     * sample and wakes readers waiting in waitForSequence().
+     *
+     * @param ts Sample time stamp of the slot.
+     */
+    void commitSlot(const cluon::data::TimeStamp &ts) noexcept;
+
+    /**
+     * This method borrows the newest published slot; the writer will not
+     * change it until returnSlot() is called. Only one slot can be borrowed
+     * at a time per instance.
+     *
+     * @param ts Sample time stamp of the borrowed slot.
+     * @return Pointer to the borrowed slot or nullptr if there is none.
+     */
+    const char *borrowSlot(cluon::data::TimeStamp &ts) noexcept;
+
+    /**
+     * This method hands the slot borrowed by borrowSlot() back to the writer.
+     */
+    void returnSlot() noexcept;
+
    public:
     /**
      * @return True if the shared memory area is existing and usable.
@@ -9354,6 +10125,12 @@ class LIBCLUON_API SharedMemory {
     void notifyAllWIN32() noexcept;
 #else
    private:
+    static uint32_t slotStride(uint32_t size) noexcept;
+    static uint32_t sequenceSize(uint32_t size, uint32_t slots) noexcept;
+    static int64_t monotonicMicroseconds() noexcept;
+    void initSequence() noexcept;
+    void wakeSequenceWaiters() noexcept;
+
     void initPOSIX() noexcept;
     void deinitPOSIX() noexcept;
     void lockPOSIX() noexcept;
@@ -9391,6 +10168,44 @@ class LIBCLUON_API SharedMemory {
 
     bool m_usePOSIX{true};
 
+    // Sequence counter, sample header and slot table appended behind the user data (cf. hasSequence(), setFormat() and slots()).
+    static constexpr uint32_t MAX_SLOTS{4};
+    struct SharedMemorySample {
+        int32_t __seconds;
+        int32_t __microseconds;
+        uint32_t __number;
+        uint32_t __reserved;
+        int64_t __published;
+    };
+    struct SharedMemorySlot {
+        uint32_t __sequence;
+        uint32_t __readers;
+        SharedMemorySample __sample;
+    };
+    struct SharedMemorySequence {
+        uint32_t __magic;
+        uint32_t __version;
+        uint32_t __size;
+        uint32_t __sequence;
+        uint32_t __waiters;
+        uint32_t __slots;
+        uint32_t __newest;
+        uint32_t __width;
+        uint32_t __height;
+        uint32_t __pixelFormat;
+        SharedMemorySample __sample;
+        SharedMemorySlot __slot[MAX_SLOTS];
+    };
+    static constexpr uint32_t SEQUENCE_MAGIC{0x434C5351}; // 'CLSQ'
+    // Version 2 added the version and the sample header, version 3 the publish time; areas of older versions are attached like areas without sequence counter.
+    static constexpr uint32_t SEQUENCE_VERSION{3};
+    bool m_createSequence{false};
+    uint32_t m_createSlots{1};
+    uint32_t m_sequenceSize{0};
+    SharedMemorySequence *m_sharedMemorySequence{nullptr};
+    uint32_t m_writingSlot{MAX_SLOTS};
+    uint32_t m_borrowedSlot{MAX_SLOTS};
+
     // Member fields for POSIX-based shared memory.
 #if !defined(__NetBSD__) && !defined(__OpenBSD__)
     int32_t m_fd{-1};
@@ -10463,6 +11278,63 @@ inline bool UDPReceiver::isRunning() const noexcept {
     return (m_readFromSocketThreadRunning.load() && !TerminateHandler::instance().isTerminated.load());
 }
 
+inline uint64_t UDPReceiver::overflows() const noexcept {
+    return (m_pipeline ? m_pipeline->overflows() : 0);
+}
+
+inline void UDPReceiver::dispatchInline(bool enable) noexcept {
+    m_dispatchInline.store(enable);
+}
+
+inline std::vector<std::thread::native_handle_type> UDPReceiver::threads() noexcept {
+    std::vector<std::thread::native_handle_type> handles;
+    if (m_readFromSocketThread.joinable()) {
+        handles.push_back(m_readFromSocketThread.native_handle());
+    }
+    if (m_pipeline) {
+        handles.push_back(m_pipeline->nativeHandle());
+    }
+    return handles;
+}
+
+#ifdef __linux__
+inline bool UDPReceiver::setSocketFilter(const std::vector<struct sock_filter> &program) noexcept {
+    bool retVal{false};
+    if (!(m_socket < 0)) {
+        if (program.empty()) {
+            int unused{0};
+            // Detaching without attached filter fails with ENOENT.
+            retVal = (0 == ::setsockopt(m_socket, SOL_SOCKET, SO_DETACH_FILTER, &unused, sizeof(unused))) || (ENOENT == errno);
+        } else if (BPF_MAXINSNS >= program.size()) {
+            struct sock_fprog filter {};
+            filter.len    = static_cast<unsigned short>(program.size());
+            filter.filter = const_cast<struct sock_filter *>(program.data()); // NOLINT
+            retVal        = (0 == ::setsockopt(m_socket, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)));
+        }
+    }
+    return retVal;
+}
+
+inline bool UDPReceiver::receiveInBatches(uint32_t numberOfDatagrams) noexcept {
+    bool retVal{false};
+    if (!(m_socket < 0) && (0 < numberOfDatagrams) && (MAX_BATCH_SIZE >= numberOfDatagrams)) {
+        // SIOCGSTAMP only returns the time stamp of the last datagram; in batches, every datagram carries its own.
+        int enable{(1 < numberOfDatagrams) ? 1 : 0};
+        retVal = (0 == ::setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMP, &enable, sizeof(enable)));
+        if (retVal) {
+            m_batchSize.store(numberOfDatagrams);
+        }
+    }
+    return retVal;
+}
+#endif
+
+inline bool UDPReceiver::isSentFromUs(unsigned long sendFromIP, uint16_t sendFromPort) const noexcept {
+    auto pos                   = m_listOfLocalIPAddresses.find(sendFromIP);
+    const bool sentFromLocalIP = (pos != m_listOfLocalIPAddresses.end() && (*pos == sendFromIP));
+    return sentFromLocalIP && (m_localSendFromPort == sendFromPort);
+}
+
 inline void UDPReceiver::readFromSocket() noexcept {
     // Create buffer to store data from socket.
     constexpr uint16_t MAX_LENGTH = static_cast<uint16_t>(UDPPacketSizeConstraints::MAX_SIZE_UDP_PACKET)
@@ -10482,6 +11354,17 @@ inline void UDPReceiver::readFromSocket() noexcept {
     struct sockaddr_storage remote {};
     socklen_t addrLength{sizeof(remote)};
 
+#ifdef __linux__
+    // Slab of buffers, sender addresses and control messages for batches; allocated on first use.
+    constexpr std::size_t CONTROL_SIZE{CMSG_SPACE(sizeof(struct timeval))};
+    std::vector<char> slab;
+    std::vector<char> controls;
+    std::vector<struct sockaddr_storage> addresses;
+    std::vector<struct iovec> vectors;
+    std::vector<struct mmsghdr> headers;
+    std::vector<PipelineEntry> batch;
+#endif
+
     // Indicate to main thread that we are ready.
     m_readFromSocketThreadRunning.store(true);
 
@@ -10496,8 +11379,75 @@ inline void UDPReceiver::readFromSocket() noexcept {
         FD_SET(m_socket, &setOfFiledescriptorsToReadFrom); // NOLINT
         ::select(m_socket + 1, &setOfFiledescriptorsToReadFrom, nullptr, nullptr, &timeout);
 
-        ssize_t totalBytesRead{0};
-        if (FD_ISSET(m_socket, &setOfFiledescriptorsToReadFrom)) { // NOLINT
+        bool readInBatches{false};
+#ifdef __linux__
+        const uint32_t BATCH_SIZE{m_batchSize.load()};
+        readInBatches = (1 < BATCH_SIZE);
+        if (readInBatches && FD_ISSET(m_socket, &setOfFiledescriptorsToReadFrom)) { // NOLINT
+            if (headers.size() < BATCH_SIZE) {
+                try {
+                    slab.resize(BATCH_SIZE * MAX_LENGTH);
+                    controls.resize(BATCH_SIZE * CONTROL_SIZE);
+                    addresses.resize(BATCH_SIZE);
+                    vectors.resize(BATCH_SIZE);
+                    headers.resize(BATCH_SIZE);
+                    batch.reserve(BATCH_SIZE);
+                } catch (...) {           // LCOV_EXCL_LINE
+                    m_batchSize.store(1); // LCOV_EXCL_LINE
+                    continue;             // LCOV_EXCL_LINE
+                }
+            }
+
+            int received{0};
+            do {
+                for (uint32_t i{0}; i < BATCH_SIZE; i++) {
+                    vectors[i].iov_base = &slab[i * MAX_LENGTH];
+                    vectors[i].iov_len  = MAX_LENGTH;
+                    std::memset(&headers[i], 0, sizeof(struct mmsghdr));
+                    headers[i].msg_hdr.msg_name       = &addresses[i];
+                    headers[i].msg_hdr.msg_namelen    = sizeof(struct sockaddr_storage);
+                    headers[i].msg_hdr.msg_iov        = &vectors[i];
+                    headers[i].msg_hdr.msg_iovlen     = 1;
+                    headers[i].msg_hdr.msg_control    = &controls[i * CONTROL_SIZE];
+                    headers[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+                }
+                received = ::recvmmsg(m_socket, headers.data(), BATCH_SIZE, MSG_DONTWAIT, nullptr);
+
+                for (int i{0}; (i < received) && (nullptr != m_delegate); i++) {
+                    std::chrono::system_clock::time_point timestamp{std::chrono::system_clock::now()};
+                    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&headers[i].msg_hdr); nullptr != cmsg; cmsg = CMSG_NXTHDR(&headers[i].msg_hdr, cmsg)) {
+                        if ((SOL_SOCKET == cmsg->cmsg_level) && (SCM_TIMESTAMP == cmsg->cmsg_type)) {
+                            struct timeval receivedTimeStamp {};
+                            std::memcpy(&receivedTimeStamp, CMSG_DATA(cmsg), sizeof(receivedTimeStamp)); /* Flawfinder: ignore */ // NOLINT
+                            std::chrono::time_point<std::chrono::system_clock, std::chrono::microseconds> transformedTimePoint(
+                                std::chrono::microseconds(receivedTimeStamp.tv_sec * 1000000L + receivedTimeStamp.tv_usec));
+                            timestamp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(transformedTimePoint);
+                        }
+                    }
+
+                    struct sockaddr_in *sender = reinterpret_cast<struct sockaddr_in *>(&addresses[i]); // NOLINT
+                    ::inet_ntop(addresses[i].ss_family, &(sender->sin_addr), remoteAddress.data(), remoteAddress.max_size());
+                    const uint16_t RECVFROM_PORT{ntohs(sender->sin_port)};
+                    if (!isSentFromUs(sender->sin_addr.s_addr, RECVFROM_PORT)) {
+                        PipelineEntry pe;
+                        pe.m_data       = std::string(&slab[static_cast<std::size_t>(i) * MAX_LENGTH], headers[i].msg_len);
+                        pe.m_from       = std::string(remoteAddress.data()) + ':' + std::to_string(RECVFROM_PORT);
+                        pe.m_sampleTime = timestamp;
+                        batch.push_back(std::move(pe));
+                    }
+                }
+
+                if (m_dispatchInline.load()) {
+                    for (auto &pe : batch) { m_delegate(std::move(pe.m_data), std::move(pe.m_from), std::move(pe.m_sampleTime)); }
+                } else if (m_pipeline && !batch.empty()) {
+                    // Hand over the whole batch at once.
+                    m_pipeline->add(batch);
+                }
+                batch.clear();
+            } while (static_cast<uint32_t>(received) == BATCH_SIZE);
+        }
+#endif
+        if (!readInBatches && FD_ISSET(m_socket, &setOfFiledescriptorsToReadFrom)) { // NOLINT
             ssize_t bytesRead{0};
             do {
                 bytesRead = ::recvfrom(m_socket,
@@ -10533,12 +11483,7 @@ inline void UDPReceiver::readFromSocket() noexcept {
                     const uint16_t RECVFROM_PORT{ntohs(reinterpret_cast<struct sockaddr_in *>(&remote)->sin_port)};    // NOLINT
 
                     // Check if the bytes actually came from us.
-                    bool sentFromUs{false};
-                    {
-                        auto pos                   = m_listOfLocalIPAddresses.find(RECVFROM_IP);
-                        const bool sentFromLocalIP = (pos != m_listOfLocalIPAddresses.end() && (*pos == RECVFROM_IP));
-                        sentFromUs                 = sentFromLocalIP && (m_localSendFromPort == RECVFROM_PORT);
-                    }
+                    const bool sentFromUs{isSentFromUs(RECVFROM_IP, RECVFROM_PORT)};
 
                     // Create a pipeline entry to be processed concurrently.
                     if (!sentFromUs) {
@@ -10547,21 +11492,17 @@ inline void UDPReceiver::readFromSocket() noexcept {
                         pe.m_from       = std::string(remoteAddress.data()) + ':' + std::to_string(RECVFROM_PORT);
                         pe.m_sampleTime = timestamp;
 
-                        // Store entry in queue.
-                        if (m_pipeline) {
+                        if (m_dispatchInline.load()) {
+                            m_delegate(std::move(pe.m_data), std::move(pe.m_from), std::move(pe.m_sampleTime));
+                        } else if (m_pipeline) {
+                            // Store entry in queue; adding wakes the pipeline's thread.
                             m_pipeline->add(std::move(pe));
                         }
                     }
-                    totalBytesRead += bytesRead;
                 }
             } while (!m_isBlockingSocket && (bytesRead > 0));
         }
 
-        if (static_cast<int32_t>(totalBytesRead) > 0) {
-            if (m_pipeline) {
-                m_pipeline->notifyAll();
-            }
-        }
     }
 }
 } // namespace cluon
@@ -10724,8 +11665,11 @@ inline void TCPConnection::startReadingFromSocket() noexcept {
     }
 
     try {
+        // Bytes of a stream must not get lost: reading waits when the delegate falls behind.
         m_pipeline = std::make_shared<cluon::NotifyingPipeline<PipelineEntry>>(
-            [this](PipelineEntry &&entry) { this->m_newDataDelegate(std::move(entry.m_data), std::move(entry.m_sampleTime)); });
+            [this](PipelineEntry &&entry) { this->m_newDataDelegate(std::move(entry.m_data), std::move(entry.m_sampleTime)); },
+            cluon::NotifyingPipeline<PipelineEntry>::DEFAULT_CAPACITY,
+            true);
         if (m_pipeline) {
             // Let the operating system spawn the thread.
             using namespace std::literals::chrono_literals; // NOLINT
@@ -10748,6 +11692,10 @@ inline bool TCPConnection::isRunning() const noexcept {
     return (m_readFromSocketThreadRunning.load() && !TerminateHandler::instance().isTerminated.load());
 }
 
+inline uint64_t TCPConnection::overflows() const noexcept {
+    return (m_pipeline ? m_pipeline->overflows() : 0);
+}
+
 inline std::pair<ssize_t, int32_t> TCPConnection::send(std::string &&data) const noexcept {
     if (-1 == m_socket) {
         return {-1, EBADF};
@@ -10833,15 +11781,11 @@ inline void TCPConnection::readFromSocket() noexcept {
                         pe.m_data       = std::string(buffer.data(), static_cast<size_t>(bytesRead));
                         pe.m_sampleTime = timestamp;
 
-                        // Store entry in queue.
+                        // Store entry in queue; adding wakes the pipeline's thread.
                         if (m_pipeline) {
                             m_pipeline->add(std::move(pe));
                         }
                     }
-
-                    if (m_pipeline) {
-                        m_pipeline->notifyAll();
-                    }
                 }
             }
         }
@@ -13940,6 +14884,52 @@ inline void ToMsgPackVisitor::visit(uint32_t id, std::string &&typeName, std::st
 
 namespace cluon {
 
+#ifdef __linux__
+inline std::vector<struct sock_filter> dataTypeSocketFilter(const std::vector<int32_t> &dataTypes) noexcept {
+    std::vector<struct sock_filter> program;
+    try {
+        constexpr uint32_t ACCEPT{0xFFFFFFFF};
+        constexpr uint32_t DROP{0};
+        // The program sees the datagram from the UDP header on.
+        constexpr uint32_t OD4_HEADER{8};
+        // Key of field 1 (dataType) with wire type VarInt, which follows the 5 bytes of the OD4 header.
+        constexpr uint32_t DATATYPE_KEY{OD4_HEADER + 5};
+        constexpr uint32_t DATATYPE{DATATYPE_KEY + 1};
+        // Longest VarInt of a zig-zag encoded int32_t.
+        constexpr uint32_t MAX_VARINT_SIZE{5};
+
+        // Loads beyond the end of the datagram would drop it; short datagrams are left to user space.
+        program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0));
+        program.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, DATATYPE + MAX_VARINT_SIZE, 1, 0));
+        program.push_back(BPF_STMT(BPF_RET | BPF_K, ACCEPT));
+
+        const std::pair<uint32_t, uint8_t> EXPECTED_BYTES[]{{OD4_HEADER, 0x0D}, {OD4_HEADER + 1, 0xA4}, {DATATYPE_KEY, (1 << 3) | 0}};
+        for (const auto &expected : EXPECTED_BYTES) {
+            program.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, expected.first));
+            program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, expected.second, 1, 0));
+            program.push_back(BPF_STMT(BPF_RET | BPF_K, ACCEPT));
+        }
+
+        for (const int32_t dataType : dataTypes) {
+            std::vector<uint8_t> varInt;
+            uint32_t zigZag{(static_cast<uint32_t>(dataType) << 1) ^ static_cast<uint32_t>(dataType >> 31)};
+            for (; 0x80 <= zigZag; zigZag >>= 7) { varInt.push_back(static_cast<uint8_t>((zigZag & 0x7F) | 0x80)); }
+            varInt.push_back(static_cast<uint8_t>(zigZag));
+
+            // A mismatching byte skips the remaining comparisons and the return of this dataType.
+            const uint32_t SIZE{static_cast<uint32_t>(varInt.size())};
+            for (uint32_t i{0}; i < SIZE; i++) {
+                program.push_back(BPF_STMT(BPF_LD | BPF_B | BPF_ABS, DATATYPE + i));
+                program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, varInt[i], 0, static_cast<uint8_t>(2 * (SIZE - 1 - i) + 1)));
+            }
+            program.push_back(BPF_STMT(BPF_RET | BPF_K, ACCEPT));
+        }
+        program.push_back(BPF_STMT(BPF_RET | BPF_K, DROP));
+    } catch (...) { program.clear(); } // LCOV_EXCL_LINE
+    return program;
+}
+#endif
+
 inline OD4Session::OD4Session(uint16_t CID, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept
     : m_receiver{nullptr}
     , m_sender{"225.0.0." + std::to_string(CID), 12175}
@@ -13955,6 +14945,12 @@ inline OD4Session::OD4Session(uint16_t CID, std::function<void(cluon::data::Enve
         m_sender.getSendFromPort() /* passing our local send from port to the UDPReceiver to filter out our own bytes */);
 }
 
+inline OD4Session::~OD4Session() noexcept {
+    // Stop receiving before the delegates are gone.
+    m_receiver.reset();
+    m_deferredDelegates.reset();
+}
+
 inline void OD4Session::timeTrigger(float freq, std::function<bool()> delegate) noexcept {
     if (nullptr != delegate) {
         bool delegateIsRunning{true};
@@ -13985,81 +14981,230 @@ inline void OD4Session::timeTrigger(float freq, std::function<bool()> delegate)
 }
 
 inline bool OD4Session::dataTrigger(int32_t messageIdentifier, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept {
+    return setDataTrigger(messageIdentifier, ANY_SENDER, std::move(delegate));
+}
+
+inline bool OD4Session::dataTrigger(int32_t messageIdentifier, uint32_t senderStamp, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept {
+    return setDataTrigger(messageIdentifier, senderStamp, std::move(delegate));
+}
+
+inline bool OD4Session::setDataTrigger(int32_t messageIdentifier, int64_t senderStamp, std::function<void(cluon::data::Envelope &&envelope)> delegate) noexcept {
     bool retVal{false};
     if (nullptr == m_delegate) {
         try {
             std::lock_guard<std::mutex> lck{m_mapOfDataTriggeredDelegatesMutex};
-            if ((nullptr == delegate) && (m_mapOfDataTriggeredDelegates.count(messageIdentifier) > 0)) {
-                auto element = m_mapOfDataTriggeredDelegates.find(messageIdentifier);
-                if (element != m_mapOfDataTriggeredDelegates.end()) {
-                    m_mapOfDataTriggeredDelegates.erase(element);
-                }
+            const std::pair<int32_t, int64_t> KEY{messageIdentifier, senderStamp};
+            if (nullptr == delegate) {
+                m_mapOfDataTriggeredDelegates.erase(KEY);
             } else {
-                m_mapOfDataTriggeredDelegates[messageIdentifier] = delegate;
+                m_mapOfDataTriggeredDelegates[KEY] = delegate;
             }
+            publishDataTriggers();
             retVal = true;
+
+            if (m_filterInKernel && !updateKernelFilter()) {
+                // Without filter, the Envelopes are sorted out in user space again.
+                std::cerr << "[cluon::OD4Session]: Failed to update the socket filter." << std::endl; // LCOV_EXCL_LINE
+            }
         } catch (...) {} // LCOV_EXCL_LINE
     }
     return retVal;
 }
 
-inline void OD4Session::callback(std::string &&data, std::string && /*from*/, std::chrono::system_clock::time_point &&timepoint) noexcept {
-    size_t numberOfDataTriggeredDelegates{0};
-    {
+inline bool OD4Session::filterInKernel(bool enable) noexcept {
+    bool retVal{false};
+    if (nullptr == m_delegate) {
         try {
             std::lock_guard<std::mutex> lck{m_mapOfDataTriggeredDelegatesMutex};
-            numberOfDataTriggeredDelegates = m_mapOfDataTriggeredDelegates.size();
+            m_filterInKernel = enable;
+            retVal           = updateKernelFilter();
+            m_filterInKernel = (m_filterInKernel && retVal);
         } catch (...) {} // LCOV_EXCL_LINE
     }
-    // Only unpack the envelope when it needs to be post-processed.
-    if ((nullptr != m_delegate) || (0 < numberOfDataTriggeredDelegates)) {
-        std::stringstream sstr(data);
-        auto retVal = extractEnvelope(sstr);
+    return retVal;
+}
+
+inline bool OD4Session::receiveInBatches(uint32_t numberOfDatagrams) noexcept {
+    bool retVal{false};
+#ifdef __linux__
+    retVal = m_receiver && m_receiver->receiveInBatches(numberOfDatagrams);
+#else
+    (void)numberOfDatagrams;
+#endif
+    return retVal;
+}
 
-        if (retVal.first) {
-            cluon::data::Envelope env{retVal.second};
-            env.received(cluon::time::convert(timepoint));
+inline void OD4Session::dispatchInline(bool enable) noexcept {
+    try {
+        std::lock_guard<std::mutex> lck{m_mapOfDataTriggeredDelegatesMutex};
+        if (enable && !m_deferredDelegates) {
+            // Setting up dataTriggers does not happen at high rates.
+            constexpr uint32_t CAPACITY{256};
+            m_deferredDelegates = std::make_unique<cluon::NotifyingPipeline<cluon::data::Envelope>>(
+                [this](cluon::data::Envelope &&envelope) { this->dispatchDeferred(std::move(envelope)); }, CAPACITY);
+        }
+        // The pipeline exists before callback() can see the flag.
+        m_dispatchInline.store(enable && m_deferredDelegates);
+        if (m_receiver) {
+            m_receiver->dispatchInline(m_dispatchInline.load());
+        }
+    } catch (...) {} // LCOV_EXCL_LINE
+}
 
-            // "Catch all"-delegate.
-            if (nullptr != m_delegate) {
-                m_delegate(std::move(env));
+inline bool OD4Session::runInline(int32_t messageIdentifier, bool enable) noexcept {
+    bool retVal{false};
+    if (nullptr == m_delegate) {
+        try {
+            std::lock_guard<std::mutex> lck{m_mapOfDataTriggeredDelegatesMutex};
+            if (enable) {
+                m_inlineDataTypes.insert(messageIdentifier);
             } else {
-                try {
-                    // Data triggered-delegates.
-                    std::lock_guard<std::mutex> lck{m_mapOfDataTriggeredDelegatesMutex};
-                    if (m_mapOfDataTriggeredDelegates.count(env.dataType()) > 0) {
-                        m_mapOfDataTriggeredDelegates[env.dataType()](std::move(env));
-                    }
-                } catch (...) {} // LCOV_EXCL_LINE
+                m_inlineDataTypes.erase(messageIdentifier);
             }
-        }
+            publishDataTriggers();
+            retVal = true;
+        } catch (...) {} // LCOV_EXCL_LINE
     }
+    return retVal;
 }
 
-inline void OD4Session::send(cluon::data::Envelope &&envelope) noexcept {
-    sendInternal(cluon::serializeEnvelope(std::move(envelope)));
+inline std::vector<std::thread::native_handle_type> OD4Session::receivingThreads() noexcept {
+    return (m_receiver ? m_receiver->threads() : std::vector<std::thread::native_handle_type>{});
 }
 
-inline void OD4Session::sendInternal(std::string &&dataToSend) noexcept {
-    m_sender.send(std::move(dataToSend));
+inline void OD4Session::publishDataTriggers() {
+    m_publishedDataTriggers.emplace_back(new DataTriggerTable(m_mapOfDataTriggeredDelegates, m_inlineDataTypes));
+    m_dataTriggers.store(m_publishedDataTriggers.back().get(), std::memory_order_release);
 }
 
-inline bool OD4Session::isRunning() noexcept {
-    return m_receiver->isRunning();
+inline bool OD4Session::updateKernelFilter() noexcept {
+    bool retVal{false};
+#ifdef __linux__
+    try {
+        std::vector<struct sock_filter> program;
+        if (m_filterInKernel) {
+            // The delegates are sorted by message identifier.
+            std::vector<int32_t> dataTypes;
+            for (const auto &e : m_mapOfDataTriggeredDelegates) {
+                if (dataTypes.empty() || (dataTypes.back() != e.first.first)) {
+                    dataTypes.push_back(e.first.first);
+                }
+            }
+            program = dataTypeSocketFilter(dataTypes);
+        }
+        retVal = m_receiver && m_receiver->setSocketFilter(program);
+    } catch (...) {} // LCOV_EXCL_LINE
+#endif
+    return retVal;
 }
 
-} // namespace cluon
-/*
- * Copyright (C) 2017-2018  Christian Berger
- *
- * This Source Code Form is subject to the terms of the Mozilla Public
- * License, v. 2.0. If a copy of the MPL was not distributed with this
- * file, You can obtain one at http://mozilla.org/MPL/2.0/.
- */
+inline void OD4Session::callback(std::string &&data, std::string && /*from*/, std::chrono::system_clock::time_point &&timepoint) noexcept {
+    const DataTriggerTable *dataTriggers{m_dataTriggers.load(std::memory_order_acquire)};
+    // Only unpack the envelope when it needs to be post-processed.
+    if ((nullptr != m_delegate) || ((nullptr != dataTriggers) && !dataTriggers->empty())) {
+        // Look at dataType and senderStamp first; the payload is only decoded for a delegate.
+        cluon::EnvelopeReader reader(data.data(), data.size());
+        cluon::EnvelopeView view;
+        if (reader.next(view)) {
+            const DataTriggerTable::Slot *slot{(nullptr != m_delegate) ? nullptr : dataTriggers->find(view.dataType(), view.senderStamp())};
+            const Delegate *delegate{(nullptr != m_delegate) ? &m_delegate : ((nullptr != slot) ? &slot->m_delegate : nullptr)};
+            if (nullptr != delegate) {
+                cluon::data::Envelope env{view.envelope()};
+                env.received(cluon::time::convert(timepoint));
+                if ((nullptr != slot) && !slot->m_inline && m_dispatchInline.load()) {
+                    // Keep the receiving thread from waiting for a slow delegate.
+                    m_deferredDelegates->add(std::move(env));
+                } else {
+                    try {
+                        (*delegate)(std::move(env));
+                    } catch (...) {} // LCOV_EXCL_LINE
+                }
+            }
+        }
+    }
+}
 
-//#include "cluon/ToODVDVisitor.hpp"
+inline void OD4Session::dispatchDeferred(cluon::data::Envelope &&envelope) noexcept {
+    // The delegate is looked up again as it might have been replaced meanwhile.
+    const DataTriggerTable *dataTriggers{m_dataTriggers.load(std::memory_order_acquire)};
+    const DataTriggerTable::Slot *slot{(nullptr != dataTriggers) ? dataTriggers->find(envelope.dataType(), envelope.senderStamp()) : nullptr};
+    if (nullptr != slot) {
+        try {
+            slot->m_delegate(std::move(envelope));
+        } catch (...) {} // LCOV_EXCL_LINE
+    }
+}
 
-#include <sstream>
+inline OD4Session::DataTriggerTable::DataTriggerTable(const std::map<std::pair<int32_t, int64_t>, Delegate> &delegates,
+                                                      const std::set<int32_t> &inlineDataTypes) {
+    // At most half of the slots are used to keep the probe sequences short.
+    std::size_t capacity{8};
+    while (capacity < 2 * delegates.size()) { capacity <<= 1; }
+    m_slots.resize(capacity);
+    m_mask = capacity - 1;
+    for (const auto &e : delegates) {
+        std::size_t i{hash(e.first.first, e.first.second) & m_mask};
+        while (nullptr != m_slots[i].m_delegate) { i = (i + 1) & m_mask; }
+        m_slots[i].m_dataType    = e.first.first;
+        m_slots[i].m_senderStamp = e.first.second;
+        m_slots[i].m_delegate    = e.second;
+        m_slots[i].m_inline      = (0 != inlineDataTypes.count(e.first.first));
+    }
+    m_size = delegates.size();
+}
+
+inline const OD4Session::DataTriggerTable::Slot *OD4Session::DataTriggerTable::find(int32_t dataType, uint32_t senderStamp) const noexcept {
+    const Slot *slot{lookup(dataType, senderStamp)};
+    return (nullptr != slot) ? slot : lookup(dataType, ANY_SENDER);
+}
+
+inline bool OD4Session::DataTriggerTable::empty() const noexcept {
+    return (0 == m_size);
+}
+
+inline std::size_t OD4Session::DataTriggerTable::capacity() const noexcept {
+    return m_slots.size();
+}
+
+inline const OD4Session::DataTriggerTable::Slot *OD4Session::DataTriggerTable::lookup(int32_t dataType, int64_t senderStamp) const noexcept {
+    for (std::size_t i{hash(dataType, senderStamp) & m_mask}; nullptr != m_slots[i].m_delegate; i = (i + 1) & m_mask) {
+        if ((dataType == m_slots[i].m_dataType) && (senderStamp == m_slots[i].m_senderStamp)) {
+            return &m_slots[i];
+        }
+    }
+    return nullptr;
+}
+
+inline std::size_t OD4Session::DataTriggerTable::hash(int32_t dataType, int64_t senderStamp) noexcept {
+    const uint64_t KEY{(static_cast<uint64_t>(static_cast<uint32_t>(dataType)) << 32) ^ static_cast<uint64_t>(senderStamp)};
+    // Fibonacci hashing: the upper bits of the product depend on all bits of the key.
+    return static_cast<std::size_t>((KEY * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+inline void OD4Session::send(cluon::data::Envelope &&envelope) noexcept {
+    sendInternal(cluon::serializeEnvelope(std::move(envelope)));
+}
+
+inline void OD4Session::sendInternal(std::string &&dataToSend) noexcept {
+    m_sender.send(std::move(dataToSend));
+}
+
+inline bool OD4Session::isRunning() noexcept {
+    return m_receiver->isRunning();
+}
+
+} // namespace cluon
+/*
+ * Copyright (C) 2017-2018  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+//#include "cluon/ToODVDVisitor.hpp"
+
+#include <sstream>
 
 namespace cluon {
 
@@ -14440,28 +15585,28 @@ inline void Player::initializeIndex() noexcept {
         m_recFile.seekg(0, m_recFile.beg);
 
         // Read complete file and store file positions to envelopes to create
-        // index of available data. The actual reading of Envelopes is deferred.
+        // index of available data. The actual reading of Envelopes is deferred;
+        // the index only needs the sample time stamps, which are read from
+        // views into a reused buffer without decoding the payloads.
         uint64_t totalBytesRead = 0;
         const cluon::data::TimeStamp BEFORE{cluon::time::now()};
         {
             int32_t oldPercentage = -1;
-            while (m_recFile.good()) {
-                const uint64_t POS_BEFORE = static_cast<uint64_t>(m_recFile.tellg());
-                auto retVal               = extractEnvelope(m_recFile);
-                const uint64_t POS_AFTER  = static_cast<uint64_t>(m_recFile.tellg());
-
-                if (!m_recFile.eof() && retVal.first) {
-                    totalBytesRead += (POS_AFTER - POS_BEFORE);
-
-                    // Store mapping .rec file position --> index entry.
-                    const int64_t microseconds = cluon::time::toMicroseconds(retVal.second.sampleTimeStamp());
-                    m_index.emplace(std::make_pair(microseconds, IndexEntry(microseconds, POS_BEFORE)));
-
-                    const int32_t percentage = static_cast<int32_t>((static_cast<float>(m_recFile.tellg()) * 100.0f) / static_cast<float>(fileLength));
-                    if ((percentage % 5 == 0) && (percentage != oldPercentage)) {
-                        std::clog << "[cluon::Player]: Indexed " << percentage << "% from " << m_file << "." << std::endl;
-                        oldPercentage = percentage;
-                    }
+            cluon::EnvelopeReader reader(m_recFile);
+            cluon::EnvelopeView envelope;
+            while (reader.next(envelope)) {
+                const uint64_t POS_BEFORE = reader.offset();
+                const uint64_t POS_AFTER  = reader.position();
+                totalBytesRead += (POS_AFTER - POS_BEFORE);
+
+                // Store mapping .rec file position --> index entry.
+                const int64_t microseconds = cluon::time::toMicroseconds(envelope.sampleTimeStamp());
+                m_index.emplace(std::make_pair(microseconds, IndexEntry(microseconds, POS_BEFORE)));
+
+                const int32_t percentage = static_cast<int32_t>((static_cast<float>(POS_AFTER) * 100.0f) / static_cast<float>(fileLength));
+                if ((percentage % 5 == 0) && (percentage != oldPercentage)) {
+                    std::clog << "[cluon::Player]: Indexed " << percentage << "% from " << m_file << "." << std::endl;
+                    oldPercentage = percentage;
                 }
             }
         }
@@ -14781,6 +15926,264 @@ inline float Player::checkRefillingCache(const uint32_t &numberOfEntries, float
     return refillMultiplicator;
 }
 
+} // namespace cluon
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+//#include "cluon/EnvelopeReader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cluon {
+
+inline bool EnvelopeView::decode(const char *data, std::size_t size) noexcept {
+    *this = EnvelopeView();
+
+    // Wire types of the Proto encoding.
+    constexpr uint64_t VARINT{0};
+    constexpr uint64_t EIGHT_BYTES{1};
+    constexpr uint64_t LENGTH_DELIMITED{2};
+    constexpr uint64_t FOUR_BYTES{5};
+
+    const char *position{data};
+    const char *end{data + size};
+    while (position < end) {
+        uint64_t key{0};
+        if (!readVarInt(position, end, key)) {
+            return false;
+        }
+        const uint64_t fieldId{key >> 3};
+        const uint64_t wireType{key & 0x7};
+        if (VARINT == wireType) {
+            uint64_t value{0};
+            if (!readVarInt(position, end, value)) {
+                return false;
+            }
+            if (1 == fieldId) {
+                const uint32_t zigZag{static_cast<uint32_t>(value)};
+                m_dataType = static_cast<int32_t>((zigZag >> 1) ^ -(zigZag & 1));
+            } else if (6 == fieldId) {
+                m_senderStamp = static_cast<uint32_t>(value);
+            }
+        } else if (LENGTH_DELIMITED == wireType) {
+            uint64_t length{0};
+            if (!readVarInt(position, end, length) || (static_cast<uint64_t>(end - position) < length)) {
+                return false;
+            }
+            const std::size_t LENGTH{static_cast<std::size_t>(length)};
+            bool retVal{true};
+            if (2 == fieldId) {
+                m_serializedData     = position;
+                m_serializedDataSize = LENGTH;
+            } else if (3 == fieldId) {
+                retVal = decodeTimeStamp(position, LENGTH, m_sent);
+            } else if (4 == fieldId) {
+                retVal = decodeTimeStamp(position, LENGTH, m_received);
+            } else if (5 == fieldId) {
+                retVal = decodeTimeStamp(position, LENGTH, m_sampleTimeStamp);
+            }
+            if (!retVal) {
+                return false;
+            }
+            position += LENGTH;
+        } else if ((EIGHT_BYTES == wireType) && (8 <= end - position)) {
+            position += 8;
+        } else if ((FOUR_BYTES == wireType) && (4 <= end - position)) {
+            position += 4;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline int32_t EnvelopeView::dataType() const noexcept {
+    return m_dataType;
+}
+
+inline const char *EnvelopeView::serializedData() const noexcept {
+    return m_serializedData;
+}
+
+inline std::size_t EnvelopeView::serializedDataSize() const noexcept {
+    return m_serializedDataSize;
+}
+
+inline cluon::data::TimeStamp EnvelopeView::sent() const noexcept {
+    return m_sent;
+}
+
+inline cluon::data::TimeStamp EnvelopeView::received() const noexcept {
+    return m_received;
+}
+
+inline cluon::data::TimeStamp EnvelopeView::sampleTimeStamp() const noexcept {
+    return m_sampleTimeStamp;
+}
+
+inline uint32_t EnvelopeView::senderStamp() const noexcept {
+    return m_senderStamp;
+}
+
+inline cluon::data::Envelope EnvelopeView::envelope() const noexcept {
+    cluon::data::Envelope env;
+    env.dataType(m_dataType)
+        .serializedData((nullptr != m_serializedData) ? std::string(m_serializedData, m_serializedDataSize) : std::string())
+        .sent(m_sent)
+        .received(m_received)
+        .sampleTimeStamp(m_sampleTimeStamp)
+        .senderStamp(m_senderStamp);
+    return env;
+}
+
+inline bool EnvelopeView::readVarInt(const char *&position, const char *end, uint64_t &value) noexcept {
+    constexpr uint64_t MASK{0x7f};
+    constexpr uint64_t SHIFT{0x7};
+    constexpr uint64_t MSB{0x80};
+    // A VarInt encodes 64 bits in at most 10 bytes.
+    constexpr uint64_t MAX_BYTES{10};
+
+    value = 0;
+    for (uint64_t i{0}; (i < MAX_BYTES) && (position < end); i++) {
+        const uint64_t C{static_cast<uint8_t>(*position++)};
+        value |= (C & MASK) << (SHIFT * i);
+        if (!(C & MSB)) { // NOLINT
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool EnvelopeView::decodeTimeStamp(const char *data, std::size_t size, cluon::data::TimeStamp &timeStamp) noexcept {
+    const char *position{data};
+    const char *end{data + size};
+    while (position < end) {
+        uint64_t key{0};
+        uint64_t value{0};
+        // TimeStamp only holds VarInts.
+        if (!readVarInt(position, end, key) || (0 != (key & 0x7)) || !readVarInt(position, end, value)) {
+            return false;
+        }
+        const uint32_t zigZag{static_cast<uint32_t>(value)};
+        const int32_t v{static_cast<int32_t>((zigZag >> 1) ^ -(zigZag & 1))};
+        if (1 == (key >> 3)) {
+            timeStamp.seconds(v);
+        } else if (2 == (key >> 3)) {
+            timeStamp.microseconds(v);
+        }
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+inline EnvelopeReader::EnvelopeReader() noexcept {}
+
+inline EnvelopeReader::EnvelopeReader(std::istream &in, std::size_t bufferSize) noexcept
+    : m_in(&in) {
+    try {
+        m_buffer.resize(bufferSize);
+    } catch (...) {} // LCOV_EXCL_LINE
+    m_data = m_buffer.data();
+}
+
+inline EnvelopeReader::EnvelopeReader(const char *data, std::size_t size) noexcept
+    : m_ownsBuffer(false)
+    , m_data(data)
+    , m_size(size) {}
+
+inline void EnvelopeReader::append(const char *data, std::size_t size) noexcept {
+    if (m_ownsBuffer && (nullptr == m_in)) {
+        compact();
+        try {
+            if (m_buffer.size() < m_size + size) {
+                m_buffer.resize(m_size + size);
+            }
+            std::memcpy(m_buffer.data() + m_size, data, size);
+            m_size += size;
+        } catch (...) {} // LCOV_EXCL_LINE
+        m_data = m_buffer.data();
+    }
+}
+
+inline bool EnvelopeReader::next(EnvelopeView &view) noexcept {
+    constexpr std::size_t OD4_HEADER_SIZE{5};
+    while (require(OD4_HEADER_SIZE)) {
+        const uint8_t *header = reinterpret_cast<const uint8_t *>(m_data + m_begin);
+        if ((0x0D != header[0]) || (0xA4 != header[1])) {
+            m_begin++;
+            m_position++;
+            m_skippedBytes++;
+            continue;
+        }
+
+        // LEN0 LEN1 LEN2 are little Endian.
+        const std::size_t LENGTH{static_cast<std::size_t>(header[2]) | (static_cast<std::size_t>(header[3]) << 8)
+                                 | (static_cast<std::size_t>(header[4]) << 16)};
+        if (!require(OD4_HEADER_SIZE + LENGTH)) {
+            return false;
+        }
+        const char *envelope{m_data + m_begin + OD4_HEADER_SIZE};
+        m_begin += OD4_HEADER_SIZE + LENGTH;
+        m_offset = m_position;
+        m_position += OD4_HEADER_SIZE + LENGTH;
+        if (view.decode(envelope, LENGTH)) {
+            return true;
+        }
+        m_skippedBytes += OD4_HEADER_SIZE + LENGTH;
+    }
+    return false;
+}
+
+inline uint64_t EnvelopeReader::offset() const noexcept {
+    return m_offset;
+}
+
+inline uint64_t EnvelopeReader::position() const noexcept {
+    return m_position;
+}
+
+inline uint64_t EnvelopeReader::skippedBytes() const noexcept {
+    return m_skippedBytes;
+}
+
+inline bool EnvelopeReader::require(std::size_t bytes) noexcept {
+    if ((m_size - m_begin >= bytes) || (nullptr == m_in)) {
+        return (m_size - m_begin >= bytes);
+    }
+
+    compact();
+    try {
+        if (m_buffer.size() < bytes) {
+            m_buffer.resize((std::max)(bytes, 2 * m_buffer.size()));
+        }
+    } catch (...) { // LCOV_EXCL_LINE
+        return false; // LCOV_EXCL_LINE
+    }
+    m_data = m_buffer.data();
+
+    // Read whole chunks to keep the number of calls into the stream low.
+    while ((m_size < bytes) && m_in->good()) {
+        m_in->read(m_buffer.data() + m_size, static_cast<std::streamsize>(m_buffer.size() - m_size));
+        m_size += static_cast<std::size_t>(m_in->gcount());
+    }
+    return (m_size >= bytes);
+}
+
+inline void EnvelopeReader::compact() noexcept {
+    if (m_ownsBuffer && (0 < m_begin)) {
+        std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_size - m_begin);
+        m_size -= m_begin;
+        m_begin = 0;
+    }
+}
+
 } // namespace cluon
 /*
  * Copyright (C) 2017-2018  Christian Berger
@@ -14806,6 +16209,10 @@ inline float Player::checkRefillingCache(const uint32_t &numberOfEntries, float
     #include <sys/time.h>
     #include <sys/types.h>
     #include <unistd.h>
+    #ifdef __linux__
+        #include <linux/futex.h>
+        #include <sys/syscall.h>
+    #endif
 #endif
 // clang-format on
 
@@ -14813,6 +16220,8 @@ inline float Player::checkRefillingCache(const uint32_t &numberOfEntries, float
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <thread>
 
 #if !defined(__APPLE__) && !defined(__OpenBSD__) && (defined(_SEM_SEMUN_UNDEFINED) || !defined(__FreeBSD__))
 union semun {
@@ -14846,6 +16255,21 @@ inline SharedMemory::SharedMemory(const std::string &name, uint32_t size) noexce
         m_usePOSIX                           = ((nullptr != CLUON_SHAREDMEMORY_POSIX) && (CLUON_SHAREDMEMORY_POSIX[0] == '1'));
         std::clog << "[cluon::SharedMemory] Using " << (m_usePOSIX ? "POSIX" : "SysV") << " implementation." << std::endl;
 #endif
+        // Only the creator decides whether a sequence counter and slots are appended; readers detect them.
+        const char *CLUON_SHAREDMEMORY_SEQUENCE = getenv("CLUON_SHAREDMEMORY_SEQUENCE");
+        const char *CLUON_SHAREDMEMORY_SLOTS    = getenv("CLUON_SHAREDMEMORY_SLOTS");
+        if (nullptr != CLUON_SHAREDMEMORY_SLOTS) {
+            // With two slots, the writer would always find the other one borrowed or the newest; 1 means no slots.
+            const std::string slots{CLUON_SHAREDMEMORY_SLOTS};
+            m_createSlots = ((1 == slots.size()) && ('3' <= slots[0]) && (static_cast<char>('0' + MAX_SLOTS) >= slots[0])) ? static_cast<uint32_t>(slots[0] - '0') : 1;
+            if ((1 == m_createSlots) && ("1" != slots)) {
+                std::cerr << "[cluon::SharedMemory] Ignoring CLUON_SHAREDMEMORY_SLOTS=" << slots << "; expected 3 to " << MAX_SLOTS << " slots." << std::endl;
+            }
+        }
+        m_createSequence = (0 < m_size) && ((1 < m_createSlots) || ((nullptr != CLUON_SHAREDMEMORY_SEQUENCE) && (CLUON_SHAREDMEMORY_SEQUENCE[0] == '1')));
+        if (m_createSequence) {
+            m_sequenceSize = sequenceSize(m_size, m_createSlots);
+        }
         // Define filename for timestamping.
         if (0 != n.find("/tmp")) {
             m_nameForTimeStamping = "/tmp" + m_name;
@@ -14886,6 +16310,8 @@ inline SharedMemory::SharedMemory(const std::string &name, uint32_t size) noexce
 }
 
 inline SharedMemory::~SharedMemory() noexcept {
+    // A slot still borrowed would be kept from the writer for the lifetime of the area.
+    returnSlot();
 #ifdef WIN32
     deinitWIN32();
 #else
@@ -14912,17 +16338,33 @@ inline void SharedMemory::lock() noexcept {
     }
 #endif
     m_isLocked.store(true);
+#ifndef WIN32
+    if (m_createSequence && (nullptr != m_sharedMemorySequence) && (1 == m_sharedMemorySequence->__slots)) {
+        // An odd sequence tells readers that the data is being changed.
+        __atomic_store_n(&(m_sharedMemorySequence->__sequence), m_sharedMemorySequence->__sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+#endif
 }
 
 inline void SharedMemory::unlock() noexcept {
 #ifdef WIN32
     unlockWIN32();
 #else
+    const bool updateSequence{m_createSequence && (nullptr != m_sharedMemorySequence) && (1 == m_sharedMemorySequence->__slots)};
+    if (updateSequence) {
+        __atomic_store_n(&(m_sharedMemorySequence->__sample.__published), monotonicMicroseconds(), __ATOMIC_RELAXED);
+        // An even sequence tells readers that the data is consistent again.
+        __atomic_store_n(&(m_sharedMemorySequence->__sequence), m_sharedMemorySequence->__sequence + 1, __ATOMIC_SEQ_CST);
+    }
     if (m_usePOSIX) {
         unlockPOSIX();
     } else {
         unlockSysV();
     }
+    if (updateSequence) {
+        wakeSequenceWaiters();
+    }
 #endif
     m_isLocked.store(false);
 }
@@ -14958,6 +16400,13 @@ inline bool SharedMemory::setTimeStamp(const cluon::data::TimeStamp &ts) noexcep
     (void)ts;
 #else
     if ((retVal = isLocked())) {
+        if (m_createSequence && (nullptr != m_sharedMemorySequence)) {
+            // Readers copy the sample header under the lock or within the odd/even window of the sequence counter.
+            SharedMemorySample &sample = m_sharedMemorySequence->__sample;
+            __atomic_store_n(&(sample.__seconds), ts.seconds(), __ATOMIC_RELAXED);
+            __atomic_store_n(&(sample.__microseconds), ts.microseconds(), __ATOMIC_RELAXED);
+            __atomic_store_n(&(sample.__number), sample.__number + 1, __ATOMIC_RELAXED);
+        }
 #ifdef __APPLE__
         struct timeval accessedTime;
         accessedTime.tv_sec = 0;
@@ -14998,7 +16447,13 @@ inline std::pair<bool, cluon::data::TimeStamp> SharedMemory::getTimeStamp() noex
     cluon::data::TimeStamp sampleTimeStamp;
 
 #ifndef WIN32
-    if ((retVal = isLocked())) {
+    if ((nullptr != m_sharedMemorySequence) && (1 == m_sharedMemorySequence->__slots)) {
+        const SharedMemorySample &sample = m_sharedMemorySequence->__sample;
+        sampleTimeStamp.seconds(__atomic_load_n(&(sample.__seconds), __ATOMIC_RELAXED))
+                       .microseconds(__atomic_load_n(&(sample.__microseconds), __ATOMIC_RELAXED));
+        retVal = true;
+    } else if ((retVal = (isLocked() || (nullptr != m_sharedMemorySequence)))) {
+        // Writers without sample header encode the sample time in the modification time of the file.
         struct stat fileStatus;
         auto r = fstat(m_fdForTimeStamping, &fileStatus);
         if (0 == r) {
@@ -15016,6 +16471,218 @@ inline std::pair<bool, cluon::data::TimeStamp> SharedMemory::getTimeStamp() noex
     return std::make_pair(retVal, sampleTimeStamp);
 }
 
+inline bool SharedMemory::setFormat(uint32_t width, uint32_t height, uint32_t pixelFormat) noexcept {
+    bool retVal{false};
+#ifdef WIN32
+    (void)width;
+    (void)height;
+    (void)pixelFormat;
+#else
+    if ((retVal = (m_createSequence && (nullptr != m_sharedMemorySequence)))) {
+        __atomic_store_n(&(m_sharedMemorySequence->__width), width, __ATOMIC_RELAXED);
+        __atomic_store_n(&(m_sharedMemorySequence->__height), height, __ATOMIC_RELAXED);
+        __atomic_store_n(&(m_sharedMemorySequence->__pixelFormat), pixelFormat, __ATOMIC_RELEASE);
+    }
+#endif
+    return retVal;
+}
+
+inline bool SharedMemory::getFormat(uint32_t &width, uint32_t &height, uint32_t &pixelFormat) const noexcept {
+    bool retVal{false};
+#ifndef WIN32
+    if (nullptr != m_sharedMemorySequence) {
+        pixelFormat = __atomic_load_n(&(m_sharedMemorySequence->__pixelFormat), __ATOMIC_ACQUIRE);
+        width       = __atomic_load_n(&(m_sharedMemorySequence->__width), __ATOMIC_RELAXED);
+        height      = __atomic_load_n(&(m_sharedMemorySequence->__height), __ATOMIC_RELAXED);
+        retVal      = (0 != pixelFormat);
+    }
+#else
+    (void)width;
+    (void)height;
+    (void)pixelFormat;
+#endif
+    return retVal;
+}
+
+inline uint32_t SharedMemory::sampleNumber() const noexcept {
+    uint32_t retVal{0};
+#ifndef WIN32
+    if (nullptr != m_sharedMemorySequence) {
+        const SharedMemorySample &sample = (MAX_SLOTS > m_borrowedSlot) ? m_sharedMemorySequence->__slot[m_borrowedSlot].__sample : m_sharedMemorySequence->__sample;
+        retVal = __atomic_load_n(&(sample.__number), __ATOMIC_RELAXED);
+    }
+#endif
+    return retVal;
+}
+
+inline int64_t SharedMemory::publishedAt() const noexcept {
+    int64_t retVal{0};
+#ifndef WIN32
+    if (nullptr != m_sharedMemorySequence) {
+        const SharedMemorySample &sample = (MAX_SLOTS > m_borrowedSlot) ? m_sharedMemorySequence->__slot[m_borrowedSlot].__sample : m_sharedMemorySequence->__sample;
+        retVal = __atomic_load_n(&(sample.__published), __ATOMIC_RELAXED);
+    }
+#endif
+    return retVal;
+}
+
+inline bool SharedMemory::hasSequence() const noexcept {
+#ifdef WIN32
+    return false;
+#else
+    return (nullptr != m_sharedMemorySequence);
+#endif
+}
+
+inline uint32_t SharedMemory::waitForSequence(uint32_t lastSequence, std::chrono::microseconds timeout) noexcept {
+#ifndef WIN32
+    if (nullptr != m_sharedMemorySequence) {
+        uint32_t *sequence = &(m_sharedMemorySequence->__sequence);
+        const auto deadline{std::chrono::steady_clock::now() + timeout};
+        uint32_t currentSequence{__atomic_load_n(sequence, __ATOMIC_ACQUIRE)};
+        while (((currentSequence == lastSequence) || (0 != (currentSequence & 1))) && !m_broken.load()) {
+            const auto remaining{std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now())};
+            if (remaining.count() <= 0) {
+                return lastSequence;
+            }
+#ifdef __linux__
+            struct timespec relativeTimeout;
+            relativeTimeout.tv_sec  = static_cast<time_t>(remaining.count() / 1000000);
+            relativeTimeout.tv_nsec = static_cast<long>((remaining.count() % 1000000) * 1000);
+
+            // The writer checks for waiters after changing the sequence; FUTEX_WAIT returns right away if the sequence is not currentSequence anymore.
+            __atomic_add_fetch(&(m_sharedMemorySequence->__waiters), 1, __ATOMIC_SEQ_CST);
+            ::syscall(SYS_futex, sequence, FUTEX_WAIT, currentSequence, &relativeTimeout, nullptr, 0);
+            __atomic_sub_fetch(&(m_sharedMemorySequence->__waiters), 1, __ATOMIC_SEQ_CST);
+#else
+            std::this_thread::sleep_for((remaining < std::chrono::microseconds(1000)) ? remaining : std::chrono::microseconds(1000));
+#endif
+            currentSequence = __atomic_load_n(sequence, __ATOMIC_ACQUIRE);
+        }
+        return currentSequence;
+    }
+#endif
+    (void)timeout;
+    wait();
+    return lastSequence + 2;
+}
+
+inline bool SharedMemory::sequenceUnchanged(uint32_t sequence) const noexcept {
+    bool retVal{false};
+#ifdef WIN32
+    (void)sequence;
+#else
+    if (nullptr != m_sharedMemorySequence) {
+        // Keep the reads of the data before the second read of the sequence.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        retVal = (sequence == __atomic_load_n(&(m_sharedMemorySequence->__sequence), __ATOMIC_RELAXED));
+    }
+#endif
+    return retVal;
+}
+
+inline uint32_t SharedMemory::slots() const noexcept {
+#ifdef WIN32
+    return 1;
+#else
+    return (nullptr != m_sharedMemorySequence) ? m_sharedMemorySequence->__slots : 1;
+#endif
+}
+
+inline char *SharedMemory::beginSlot() noexcept {
+    char *retVal{nullptr};
+#ifndef WIN32
+    if (m_createSequence && (nullptr != m_sharedMemorySequence) && (1 < m_sharedMemorySequence->__slots)) {
+        const uint32_t slots{m_sharedMemorySequence->__slots};
+        const uint32_t newest{__atomic_load_n(&(m_sharedMemorySequence->__newest), __ATOMIC_RELAXED)};
+        for (uint32_t i{1}; (nullptr == retVal) && (i < slots); i++) {
+            const uint32_t candidate{(newest + i) % slots};
+            SharedMemorySlot &slot = m_sharedMemorySequence->__slot[candidate];
+            if (0 == __atomic_load_n(&(slot.__readers), __ATOMIC_SEQ_CST)) {
+                // Mark the slot first and check for readers again: either the reader sees the odd sequence or we see the reader.
+                const uint32_t sequence{slot.__sequence};
+                __atomic_store_n(&(slot.__sequence), sequence | 1, __ATOMIC_SEQ_CST);
+                if (0 == __atomic_load_n(&(slot.__readers), __ATOMIC_SEQ_CST)) {
+                    m_writingSlot = candidate;
+                    retVal        = m_userAccessibleSharedMemory + candidate * slotStride(m_size);
+                } else {
+                    __atomic_store_n(&(slot.__sequence), sequence, __ATOMIC_SEQ_CST);
+                }
+            }
+        }
+    }
+#endif
+    return retVal;
+}
+
+inline void SharedMemory::commitSlot(const cluon::data::TimeStamp &ts) noexcept {
+#ifdef WIN32
+    (void)ts;
+#else
+    if ((nullptr != m_sharedMemorySequence) && (MAX_SLOTS > m_writingSlot)) {
+        SharedMemorySlot &slot = m_sharedMemorySequence->__slot[m_writingSlot];
+        slot.__sample.__seconds      = ts.seconds();
+        slot.__sample.__microseconds = ts.microseconds();
+        slot.__sample.__number       = m_sharedMemorySequence->__sample.__number + 1;
+        slot.__sample.__published    = monotonicMicroseconds();
+        // The header describes the newest slot, too.
+        SharedMemorySample &newest = m_sharedMemorySequence->__sample;
+        __atomic_store_n(&(newest.__seconds), slot.__sample.__seconds, __ATOMIC_RELAXED);
+        __atomic_store_n(&(newest.__microseconds), slot.__sample.__microseconds, __ATOMIC_RELAXED);
+        __atomic_store_n(&(newest.__number), slot.__sample.__number, __ATOMIC_RELAXED);
+        __atomic_store_n(&(newest.__published), slot.__sample.__published, __ATOMIC_RELAXED);
+
+        const uint32_t sequence{m_sharedMemorySequence->__sequence + 2};
+        __atomic_store_n(&(slot.__sequence), sequence, __ATOMIC_RELEASE);
+        __atomic_store_n(&(m_sharedMemorySequence->__newest), m_writingSlot, __ATOMIC_RELEASE);
+        __atomic_store_n(&(m_sharedMemorySequence->__sequence), sequence, __ATOMIC_SEQ_CST);
+        m_writingSlot = MAX_SLOTS;
+        wakeSequenceWaiters();
+    }
+#endif
+}
+
+inline const char *SharedMemory::borrowSlot(cluon::data::TimeStamp &ts) noexcept {
+    const char *retVal{nullptr};
+#ifndef WIN32
+    if ((nullptr != m_sharedMemorySequence) && (1 < m_sharedMemorySequence->__slots) && (MAX_SLOTS == m_borrowedSlot)) {
+        // Retry when the writer published another slot in the meantime.
+        constexpr uint32_t ATTEMPTS{4};
+        for (uint32_t attempt{0}; (nullptr == retVal) && (attempt < ATTEMPTS); attempt++) {
+            const uint32_t newest{__atomic_load_n(&(m_sharedMemorySequence->__newest), __ATOMIC_ACQUIRE)};
+            if (m_sharedMemorySequence->__slots <= newest) {
+                break;
+            }
+            SharedMemorySlot &slot = m_sharedMemorySequence->__slot[newest];
+            const uint32_t sequence{__atomic_load_n(&(slot.__sequence), __ATOMIC_ACQUIRE)};
+            if ((0 == sequence) || (0 != (sequence & 1))) {
+                continue;
+            }
+            __atomic_add_fetch(&(slot.__readers), 1, __ATOMIC_SEQ_CST);
+            if (sequence == __atomic_load_n(&(slot.__sequence), __ATOMIC_SEQ_CST)) {
+                ts.seconds(slot.__sample.__seconds).microseconds(slot.__sample.__microseconds);
+                m_borrowedSlot = newest;
+                retVal         = m_userAccessibleSharedMemory + newest * slotStride(m_size);
+            } else {
+                __atomic_sub_fetch(&(slot.__readers), 1, __ATOMIC_SEQ_CST);
+            }
+        }
+    }
+#else
+    (void)ts;
+#endif
+    return retVal;
+}
+
+inline void SharedMemory::returnSlot() noexcept {
+#ifndef WIN32
+    if ((nullptr != m_sharedMemorySequence) && (MAX_SLOTS > m_borrowedSlot)) {
+        __atomic_sub_fetch(&(m_sharedMemorySequence->__slot[m_borrowedSlot].__readers), 1, __ATOMIC_SEQ_CST);
+        m_borrowedSlot = MAX_SLOTS;
+    }
+#endif
+}
+
 inline bool SharedMemory::valid() noexcept {
     bool valid{!m_broken.load()};
     valid &= (nullptr != m_sharedMemory);
@@ -15237,6 +16904,51 @@ inline void SharedMemory::notifyAllWIN32() noexcept {
 
 #else /* POSIX and SysV */
 
+inline uint32_t SharedMemory::slotStride(uint32_t size) noexcept {
+    // Slots start on cache line boundaries.
+    return (size + 63) & ~static_cast<uint32_t>(63);
+}
+
+inline uint32_t SharedMemory::sequenceSize(uint32_t size, uint32_t slots) noexcept {
+    // Further slots and the sequence counter follow the first slot, i.e., the user data.
+    return slots * slotStride(size) - size + static_cast<uint32_t>(sizeof(SharedMemorySequence));
+}
+
+inline int64_t SharedMemory::monotonicMicroseconds() noexcept {
+    struct timespec now {};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+inline void SharedMemory::initSequence() noexcept {
+    if ((0 < m_sequenceSize) && (nullptr != m_userAccessibleSharedMemory)) {
+        SharedMemorySequence *sequence
+            = reinterpret_cast<SharedMemorySequence *>(m_userAccessibleSharedMemory + m_size + m_sequenceSize - sizeof(SharedMemorySequence));
+        if (m_createSequence) {
+            ::memset(sequence, 0, sizeof(SharedMemorySequence));
+            sequence->__magic      = SEQUENCE_MAGIC;
+            sequence->__version    = SEQUENCE_VERSION;
+            sequence->__size       = m_size;
+            sequence->__slots      = m_createSlots;
+            m_sharedMemorySequence = sequence;
+        } else if ((SEQUENCE_MAGIC == sequence->__magic) && (SEQUENCE_VERSION == sequence->__version) && (m_size == sequence->__size) && (0 < sequence->__slots) && (MAX_SLOTS >= sequence->__slots)
+                   && (sequenceSize(m_size, sequence->__slots) == m_sequenceSize)) {
+            m_sharedMemorySequence = sequence;
+        }
+    }
+    if (nullptr != m_sharedMemorySequence) {
+        std::clog << "[cluon::SharedMemory] Using sequence counter and " << m_sharedMemorySequence->__slots << " slot(s) for '" << m_name << "'." << std::endl;
+    }
+}
+
+inline void SharedMemory::wakeSequenceWaiters() noexcept {
+#ifdef __linux__
+    if ((nullptr != m_sharedMemorySequence) && (0 < __atomic_load_n(&(m_sharedMemorySequence->__waiters), __ATOMIC_SEQ_CST))) {
+        ::syscall(SYS_futex, &(m_sharedMemorySequence->__sequence), FUTEX_WAKE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+    }
+#endif
+}
+
 inline void SharedMemory::initPOSIX() noexcept {
 #if !defined(__NetBSD__) && !defined(__OpenBSD__)
     // If size is greater than 0, the caller wants to create a new shared
@@ -15271,7 +16983,7 @@ inline void SharedMemory::initPOSIX() noexcept {
 
         // When creating a shared memory segment, truncate it.
         if (0 < m_size) {
-            retVal = (0 == ::ftruncate(m_fd, static_cast<off_t>(sizeof(SharedMemoryHeader) + m_size)));
+            retVal = (0 == ::ftruncate(m_fd, static_cast<off_t>(sizeof(SharedMemoryHeader) + m_size + m_sequenceSize)));
             if (!retVal) {
 // clang-format off // LCOV_EXCL_LINE
                 std::cerr << "[cluon::SharedMemory (POSIX)] Failed to truncate '" << m_name << "': " << ::strerror(errno) << " (" << errno << ")" << std::endl; // LCOV_EXCL_LINE
@@ -15282,7 +16994,7 @@ inline void SharedMemory::initPOSIX() noexcept {
         // Accessing shared memory segment.
         if (retVal) {
             // On opening (i.e., NOT creating) a shared memory segment, m_size is still 0 and we need to figure out the size first.
-            m_sharedMemory = static_cast<char *>(::mmap(0, sizeof(SharedMemoryHeader) + m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0));
+            m_sharedMemory = static_cast<char *>(::mmap(0, sizeof(SharedMemoryHeader) + m_size + m_sequenceSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0));
             if (MAP_FAILED != m_sharedMemory) {
                 m_sharedMemoryHeader = reinterpret_cast<SharedMemoryHeader *>(m_sharedMemory);
 
@@ -15330,8 +17042,15 @@ inline void SharedMemory::initPOSIX() noexcept {
                     m_sharedMemory = nullptr;
                     m_sharedMemoryHeader = nullptr;
 
+                    // A segment larger than announced might carry slots and a sequence counter behind the user data.
+                    struct stat fileStatus;
+                    if ((0 == ::fstat(m_fd, &fileStatus))
+                        && (static_cast<off_t>(sizeof(SharedMemoryHeader) + m_size + sizeof(SharedMemorySequence)) <= fileStatus.st_size)) {
+                        m_sequenceSize = static_cast<uint32_t>(fileStatus.st_size - static_cast<off_t>(sizeof(SharedMemoryHeader) + m_size));
+                    }
+
                     // Re-map with the correct size parameter.
-                    m_sharedMemory = static_cast<char *>(::mmap(0, sizeof(SharedMemoryHeader) + m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0));
+                    m_sharedMemory = static_cast<char *>(::mmap(0, sizeof(SharedMemoryHeader) + m_size + m_sequenceSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0));
                     if (MAP_FAILED != m_sharedMemory) {
                         m_sharedMemoryHeader = reinterpret_cast<SharedMemoryHeader *>(m_sharedMemory);
                     }
@@ -15345,9 +17064,10 @@ inline void SharedMemory::initPOSIX() noexcept {
             // If the shared memory segment is correctly available, store the pointer for the user data.
             if (MAP_FAILED != m_sharedMemory) {
                 m_userAccessibleSharedMemory = m_sharedMemory + sizeof(SharedMemoryHeader);
+                initSequence();
 
                 // Lock the shared memory into RAM for performance reasons.
-                if (-1 == ::mlock(m_sharedMemory, sizeof(SharedMemoryHeader) + m_size)) {
+                if (-1 == ::mlock(m_sharedMemory, sizeof(SharedMemoryHeader) + m_size + m_sequenceSize)) {
                     std::cerr << "[cluon::SharedMemory (POSIX)] Failed to mlock shared memory: " // LCOV_EXCL_LINE
                               << ::strerror(errno) << " (" << errno << ")" << std::endl;         // LCOV_EXCL_LINE
                 }
@@ -15386,11 +17106,12 @@ inline void SharedMemory::deinitPOSIX() noexcept {
 #if !defined(__NetBSD__) && !defined(__OpenBSD__)
     if ((nullptr != m_sharedMemoryHeader) && (!m_hasOnlyAttachedToSharedMemory)) {
         // Wake any waiting threads as we are going to end the shared memory session.
+        wakeSequenceWaiters();
         ::pthread_cond_broadcast(&(m_sharedMemoryHeader->__condition));
         ::pthread_cond_destroy(&(m_sharedMemoryHeader->__condition));
         ::pthread_mutex_destroy(&(m_sharedMemoryHeader->__mutex));
     }
-    if ((nullptr != m_sharedMemory) && ::munmap(m_sharedMemory, sizeof(SharedMemoryHeader) + m_size)) {
+    if ((nullptr != m_sharedMemory) && ::munmap(m_sharedMemory, sizeof(SharedMemoryHeader) + m_size + m_sequenceSize)) {
 // clang-format off // LCOV_EXCL_LINE
         std::cerr << "[cluon::SharedMemory (POSIX)] Failed to unmap shared memory: " << ::strerror(errno) << " (" << errno << ")" << std::endl; // LCOV_EXCL_LINE
 // clang-format on // LCOV_EXCL_LINE
@@ -15533,13 +17254,14 @@ inline void SharedMemory::initSysV() noexcept {
                 }
 
                 // Now, create the shared memory segment.
-                m_sharedMemoryIDSysV = ::shmget(m_shmKeySysV, m_size, IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+                m_sharedMemoryIDSysV = ::shmget(m_shmKeySysV, m_size + m_sequenceSize, IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
                 if (-1 != m_sharedMemoryIDSysV) {
                     m_sharedMemory = reinterpret_cast<char *>(::shmat(m_sharedMemoryIDSysV, nullptr, 0));
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
                     if ((void *)-1 != m_sharedMemory) {
                         m_userAccessibleSharedMemory = m_sharedMemory;
+                        initSequence();
                     } else { // LCOV_EXCL_LINE
 // clang-format off // LCOV_EXCL_LINE
                         std::cerr << "[cluon::SharedMemory (SysV)] Failed to attach to shared memory (0x" << std::hex << m_shmKeySysV << std::dec << "): " << ::strerror(errno) << " (" << errno << ")" << std::endl; // LCOV_EXCL_LINE
@@ -15563,6 +17285,18 @@ inline void SharedMemory::initSysV() noexcept {
 #pragma GCC diagnostic ignored "-Wold-style-cast"
                         if ((void *)-1 != m_sharedMemory) {
                             m_userAccessibleSharedMemory = m_sharedMemory;
+
+                            // SysV segments do not announce the size of the user data; a valid sequence counter at the end tells it.
+                            if ((sizeof(SharedMemorySequence) < m_size) && (0 == (m_size % 8))) {
+                                const SharedMemorySequence *sequence
+                                    = reinterpret_cast<const SharedMemorySequence *>(m_sharedMemory + m_size - sizeof(SharedMemorySequence));
+                                if ((SEQUENCE_MAGIC == sequence->__magic) && (SEQUENCE_VERSION == sequence->__version) && (0 < sequence->__slots) && (MAX_SLOTS >= sequence->__slots)
+                                    && (sequence->__size + sequenceSize(sequence->__size, sequence->__slots) == m_size)) {
+                                    m_sequenceSize = sequenceSize(sequence->__size, sequence->__slots);
+                                    m_size         = sequence->__size;
+                                    initSequence();
+                                }
+                            }
                         } else { // LCOV_EXCL_LINE
 // clang-format off // LCOV_EXCL_LINE
                             std::cerr << "[cluon::SharedMemory (SysV)] Failed to attach to shared memory (0x" << std::hex << m_shmKeySysV << std::dec << "): " << ::strerror(errno) << " (" << errno << ")" << std::endl; // LCOV_EXCL_LINE
@@ -15708,6 +17442,9 @@ inline void SharedMemory::initSysV() noexcept {
 }
 
 inline void SharedMemory::deinitSysV() noexcept {
+    if (!m_hasOnlyAttachedToSharedMemory) {
+        wakeSequenceWaiters();
+    }
     if (nullptr != m_sharedMemory) {
         // Close token file.
         ::close(m_fdForTimeStamping);
@@ -17235,6 +18972,137 @@ void doTripletForwardVisit(uint32_t fieldIdentifier, std::string &&typeName, std
 }
 #endif
 
+#ifndef SCALAR_PROTO_CODEC
+#define SCALAR_PROTO_CODEC
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Encodes and decodes scalar fields in the same Proto format as cluon::ToProtoVisitor
+// and cluon::FromProtoVisitor, but on caller-provided buffers.
+struct scalarProtoCodec {
+    static constexpr uint8_t VARINT{0};
+    static constexpr uint8_t EIGHT_BYTES{1};
+    static constexpr uint8_t LENGTH_DELIMITED{2};
+    static constexpr uint8_t FOUR_BYTES{5};
+
+    static inline char *putVarInt(char *p, uint64_t v) noexcept {
+        while (0x7f < v) {
+            *p++ = static_cast<char>((v & 0x7f) | 0x80);
+            v >>= 7;
+        }
+        *p++ = static_cast<char>(v);
+        return p;
+    }
+
+    static inline char *putKey(char *p, uint32_t fieldIdentifier, uint8_t wireType) noexcept {
+        return putVarInt(p, (fieldIdentifier << 0x3) | wireType);
+    }
+
+    static inline uint64_t toWire(bool v) noexcept { return (v ? 1u : 0u); }
+    static inline uint64_t toWire(char v) noexcept { return static_cast<uint8_t>(v); }
+    static inline uint64_t toWire(int8_t v) noexcept { return static_cast<uint8_t>((static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 7)); }
+    static inline uint64_t toWire(uint8_t v) noexcept { return v; }
+    static inline uint64_t toWire(int16_t v) noexcept { return static_cast<uint16_t>((static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 15)); }
+    static inline uint64_t toWire(uint16_t v) noexcept { return v; }
+    static inline uint64_t toWire(int32_t v) noexcept { return static_cast<uint32_t>((static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31)); }
+    static inline uint64_t toWire(uint32_t v) noexcept { return v; }
+    static inline uint64_t toWire(int64_t v) noexcept { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+    static inline uint64_t toWire(uint64_t v) noexcept { return v; }
+
+    static inline void fromWire(uint64_t w, bool &v) noexcept { v = (0 != w); }
+    static inline void fromWire(uint64_t w, char &v) noexcept { v = static_cast<char>(w); }
+    static inline void fromWire(uint64_t w, int8_t &v) noexcept { const uint8_t u{static_cast<uint8_t>(w)}; v = static_cast<int8_t>((u >> 1) ^ -(u & 1)); }
+    static inline void fromWire(uint64_t w, uint8_t &v) noexcept { v = static_cast<uint8_t>(w); }
+    static inline void fromWire(uint64_t w, int16_t &v) noexcept { const uint16_t u{static_cast<uint16_t>(w)}; v = static_cast<int16_t>((u >> 1) ^ -(u & 1)); }
+    static inline void fromWire(uint64_t w, uint16_t &v) noexcept { v = static_cast<uint16_t>(w); }
+    static inline void fromWire(uint64_t w, int32_t &v) noexcept { const uint32_t u{static_cast<uint32_t>(w)}; v = static_cast<int32_t>((u >> 1) ^ -(u & 1)); }
+    static inline void fromWire(uint64_t w, uint32_t &v) noexcept { v = static_cast<uint32_t>(w); }
+    static inline void fromWire(uint64_t w, int64_t &v) noexcept { v = static_cast<int64_t>((w >> 1) ^ -(w & 1)); }
+    static inline void fromWire(uint64_t w, uint64_t &v) noexcept { v = w; }
+
+    template<typename T>
+    static inline char *put(char *p, uint32_t fieldIdentifier, T v) noexcept {
+        return putVarInt(putKey(p, fieldIdentifier, VARINT), toWire(v));
+    }
+
+    static inline char *put(char *p, uint32_t fieldIdentifier, float v) noexcept {
+        uint32_t w{0};
+        std::memcpy(&w, &v, sizeof(float));
+        p = putKey(p, fieldIdentifier, FOUR_BYTES);
+        for (std::size_t i{0}; i < sizeof(float); i++, w >>= 8) { *p++ = static_cast<char>(w & 0xff); }
+        return p;
+    }
+
+    static inline char *put(char *p, uint32_t fieldIdentifier, double v) noexcept {
+        uint64_t w{0};
+        std::memcpy(&w, &v, sizeof(double));
+        p = putKey(p, fieldIdentifier, EIGHT_BYTES);
+        for (std::size_t i{0}; i < sizeof(double); i++, w >>= 8) { *p++ = static_cast<char>(w & 0xff); }
+        return p;
+    }
+
+    // The following methods return nullptr when the data ends in the middle of a value.
+    static inline const char *getVarInt(const char *p, const char *end, uint64_t &v) noexcept {
+        v = 0;
+        for (uint32_t shift{0}; (p < end) && (shift < 64); shift += 7) {
+            const uint8_t b{static_cast<uint8_t>(*p++)};
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (0 == (b & 0x80)) {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    static inline const char *skip(const char *p, const char *end, uint8_t wireType) noexcept {
+        uint64_t length{0};
+        switch (wireType) {
+            case VARINT: return getVarInt(p, end, length);
+            case EIGHT_BYTES: length = sizeof(double); break;
+            case FOUR_BYTES: length = sizeof(float); break;
+            case LENGTH_DELIMITED: p = getVarInt(p, end, length); break;
+            default: return nullptr;
+        }
+        return ((nullptr == p) || (static_cast<uint64_t>(end - p) < length)) ? nullptr : p + length;
+    }
+
+    // A value of another wire type than the field's is skipped, as FromProtoVisitor ignores it.
+    template<typename T>
+    static inline const char *get(const char *p, const char *end, uint8_t wireType, T &v) noexcept {
+        if (VARINT != wireType) {
+            return skip(p, end, wireType);
+        }
+        uint64_t w{0};
+        p = getVarInt(p, end, w);
+        if (nullptr != p) {
+            fromWire(w, v);
+        }
+        return p;
+    }
+
+    static inline const char *get(const char *p, const char *end, uint8_t wireType, float &v) noexcept {
+        if ((FOUR_BYTES != wireType) || (static_cast<std::size_t>(end - p) < sizeof(float))) {
+            return skip(p, end, wireType);
+        }
+        uint32_t w{0};
+        for (std::size_t i{0}; i < sizeof(float); i++) { w |= static_cast<uint32_t>(static_cast<uint8_t>(p[i])) << (8 * i); }
+        std::memcpy(&v, &w, sizeof(float));
+        return p + sizeof(float);
+    }
+
+    static inline const char *get(const char *p, const char *end, uint8_t wireType, double &v) noexcept {
+        if ((EIGHT_BYTES != wireType) || (static_cast<std::size_t>(end - p) < sizeof(double))) {
+            return skip(p, end, wireType);
+        }
+        uint64_t w{0};
+        for (std::size_t i{0}; i < sizeof(double); i++) { w |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8 * i); }
+        std::memcpy(&v, &w, sizeof(double));
+        return p + sizeof(double);
+    }
+};
+#endif
+
 
 #ifndef {{%HEADER_GUARD%}}_HPP
 #define {{%HEADER_GUARD%}}_HPP
@@ -17328,6 +19196,61 @@ class LIB_API {{%MESSAGE%}} {
             {{/%FIELDS%}}
             std::forward<PostVisitor>(postVisit)();
         }
+{{#%SCALAR_ONLY%}}
+
+    public:
+        // Largest number of bytes that encodeTo writes.
+        static constexpr std::size_t MAX_ENCODED_SIZE = {{%MAX_ENCODED_SIZE%}};
+
+        /**
+         * Encodes this message into the given buffer without allocating memory;
+         * the bytes are the same as the ones of cluon::ToProtoVisitor.
+         *
+         * @param buffer Buffer to write to.
+         * @param size Size of the buffer; at least MAX_ENCODED_SIZE.
+         * @return Number of bytes written; 0 if the buffer is too small.
+         */
+        inline std::size_t encodeTo(char *buffer, std::size_t size) const noexcept {
+            if ((nullptr == buffer) || (size < MAX_ENCODED_SIZE)) {
+                return 0;
+            }
+            char *p{buffer};
+            {{#%FIELDS%}}
+            p = scalarProtoCodec::put(p, {{%FIELDIDENTIFIER%}}, m_{{%NAME%}});
+            {{/%FIELDS%}}
+            return static_cast<std::size_t>(p - buffer);
+        }
+
+        /**
+         * Decodes the fields from data in Proto format without allocating memory;
+         * fields that are not contained keep their values.
+         *
+         * @param data Data to decode.
+         * @param size Size of the data.
+         * @return true if the data was decoded completely.
+         */
+        inline bool decodeFrom(const char *data, std::size_t size) noexcept {
+            if (nullptr == data) {
+                return (0 == size);
+            }
+            const char *p{data};
+            const char *end{data + size};
+            while ((nullptr != p) && (p < end)) {
+                uint64_t key{0};
+                p = scalarProtoCodec::getVarInt(p, end, key);
+                if (nullptr != p) {
+                    const uint8_t wireType{static_cast<uint8_t>(key & 0x7)};
+                    switch (key >> 3) {
+                        {{#%FIELDS%}}
+                        case {{%FIELDIDENTIFIER%}}: p = scalarProtoCodec::get(p, end, wireType, m_{{%NAME%}}); break;
+                        {{/%FIELDS%}}
+                        default: p = scalarProtoCodec::skip(p, end, wireType); break;
+                    }
+                }
+            }
+            return (nullptr != p);
+        }
+{{/%SCALAR_ONLY%}}
 
     private:
         {{#%FIELDS%}}
@@ -17424,6 +19347,36 @@ void MetaMessageToCPPTransformator::visit(const MetaMessage &mm) noexcept {
         dataToBeRendered.set("%NAMESPACE_CLOSING%", namespaceFooter);
         dataToBeRendered.set("%IDENTIFIER%", std::to_string(mm.messageIdentifier()));
 
+        // Messages of scalars only get fixed-layout codecs; the largest encoding has every field's key and longest value.
+        std::map<MetaMessage::MetaField::MetaFieldDataTypes, std::pair<uint32_t, std::size_t>> typeToWireTypeAndMaxSizeMap = {
+            {MetaMessage::MetaField::BOOL_T, {0, 1}},
+            {MetaMessage::MetaField::CHAR_T, {0, 2}},
+            {MetaMessage::MetaField::UINT8_T, {0, 2}},
+            {MetaMessage::MetaField::INT8_T, {0, 2}},
+            {MetaMessage::MetaField::UINT16_T, {0, 3}},
+            {MetaMessage::MetaField::INT16_T, {0, 3}},
+            {MetaMessage::MetaField::UINT32_T, {0, 5}},
+            {MetaMessage::MetaField::INT32_T, {0, 5}},
+            {MetaMessage::MetaField::UINT64_T, {0, 10}},
+            {MetaMessage::MetaField::INT64_T, {0, 10}},
+            {MetaMessage::MetaField::FLOAT_T, {5, 4}},
+            {MetaMessage::MetaField::DOUBLE_T, {1, 8}},
+        };
+        bool scalarOnly{!mm.listOfMetaFields().empty()};
+        std::size_t maxEncodedSize{0};
+        for (const auto &e : mm.listOfMetaFields()) {
+            if (0 == typeToWireTypeAndMaxSizeMap.count(e.fieldDataType())) {
+                scalarOnly = false;
+                break;
+            }
+            const auto wireTypeAndMaxSize = typeToWireTypeAndMaxSizeMap[e.fieldDataType()];
+            for (uint64_t key{(static_cast<uint64_t>(e.fieldIdentifier()) << 0x3) | wireTypeAndMaxSize.first}; 0x7f < key; key >>= 7) { maxEncodedSize++; }
+            maxEncodedSize += 1 + wireTypeAndMaxSize.second;
+        }
+        dataToBeRendered.set("%SCALAR_ONLY%",
+                             kainjow::mustache::data{scalarOnly ? kainjow::mustache::data::type::bool_true : kainjow::mustache::data::type::bool_false});
+        dataToBeRendered.set("%MAX_ENCODED_SIZE%", std::to_string(maxEncodedSize));
+
         for (const auto &e : mm.listOfMetaFields()) {
             std::string fieldName{std::regex_replace(e.fieldName(), std::regex("\\."), "_")}; // NOLINT
             kainjow::mustache::data fieldEntry;
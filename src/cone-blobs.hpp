@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONE_BLOBS_HPP
+#define CONE_BLOBS_HPP
+
+#include "cone-runs.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Connected region of cone pixels: bounding box (as returned by cv::boundingRect) and number of pixels.
+struct ConeBlob
+{
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    uint32_t pixels;
+    ConeColour colour;
+
+    int32_t area() const { return width * height; }
+};
+
+using BlobList = ArenaVector<ConeBlob>;
+
+namespace detail
+{
+inline uint32_t findRoot(ArenaVector<uint32_t> &parent, uint32_t label)
+{
+    while (parent[label] != label)
+    {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+// The smaller label becomes the root, so a root is the first run of its blob.
+inline void unite(ArenaVector<uint32_t> &parent, uint32_t a, uint32_t b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b)
+    {
+        parent[b] = a;
+    }
+    else if (b < a)
+    {
+        parent[a] = b;
+    }
+}
+} // namespace detail
+
+// Labels the runs of a frame with union-find: runs of the same colour in
+// neighbouring rows are 8-connected when they overlap or touch diagonally.
+// The work scales with the number of runs, i.e. with the cone pixels. The
+// scratch space and the result live on the arena of runs.
+// Returns the blobs of both colours in scan order (by their first run).
+// With a rowStep above 1, every run stands for rowStep rows as only every rowStep-th row was segmented.
+inline BlobList labelRuns(const RunList &runs, uint32_t rowStep = 1)
+{
+    ArenaVector<uint32_t> parent(runs.size(), 0, runs.get_allocator());
+    BlobList boxes(runs.size(), ConeBlob{}, runs.get_allocator());
+
+    // Index ranges of the current and the previous row within runs.
+    size_t previousFirst{0};
+    size_t previousLast{0};
+    size_t i{0};
+    while (i < runs.size())
+    {
+        const uint16_t row{runs[i].row};
+        const size_t rowFirst{i};
+        if ((previousLast == previousFirst) || (runs[previousFirst].row + rowStep != row))
+        {
+            previousFirst = previousLast = rowFirst;
+        }
+
+        size_t p{previousFirst};
+        for (; (i < runs.size()) && (runs[i].row == row); i++)
+        {
+            const ConeRun &run = runs[i];
+            const uint32_t label{static_cast<uint32_t>(i)};
+            parent[label] = label;
+            boxes[label] = ConeBlob{run.start, run.row, run.end, static_cast<int32_t>(run.row + rowStep), static_cast<uint32_t>(run.end - run.start) * rowStep, run.colour};
+
+            // Both rows are ordered by colour, then start: skip runs that cannot touch [start - 1, end].
+            while ((p < previousLast) && ((runs[p].colour < run.colour) || ((runs[p].colour == run.colour) && (runs[p].end < run.start))))
+            {
+                p++;
+            }
+            for (size_t q = p; (q < previousLast) && (runs[q].colour == run.colour) && (runs[q].start <= run.end); q++)
+            {
+                detail::unite(parent, label, static_cast<uint32_t>(q));
+            }
+        }
+        previousFirst = rowFirst;
+        previousLast = i;
+    }
+
+    // Fold every run's box into its root; the boxes hold exclusive right/bottom corners until here.
+    size_t roots{0};
+    for (uint32_t label = 0; label < runs.size(); label++)
+    {
+        const uint32_t root{detail::findRoot(parent, label)};
+        if (root != label)
+        {
+            ConeBlob &r = boxes[root];
+            const ConeBlob &b = boxes[label];
+            r.x = (b.x < r.x) ? b.x : r.x;
+            r.width = (b.width > r.width) ? b.width : r.width;
+            r.height = (b.height > r.height) ? b.height : r.height;
+            r.pixels += b.pixels;
+        }
+        else
+        {
+            roots++;
+        }
+    }
+
+    BlobList blobs(runs.get_allocator());
+    blobs.reserve(roots);
+    for (uint32_t label = 0; label < runs.size(); label++)
+    {
+        if (parent[label] == label)
+        {
+            ConeBlob b = boxes[label];
+            b.width -= b.x;
+            b.height -= b.y;
+            blobs.push_back(b);
+        }
+    }
+    return blobs;
+}
+
+#endif
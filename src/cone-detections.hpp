@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONE_DETECTIONS_HPP
+#define CONE_DETECTIONS_HPP
+
+#include "cone-blobs.hpp"
+
+#include <cstdint>
+
+// Blobs with a bounding box area above MIN_BLOB_AREA are drawn and considered
+// for the largest box; those above MIN_CONE_AREA are counted as cones. Both are
+// the defaults of the steering parameters.
+constexpr int32_t MIN_BLOB_AREA{80};
+constexpr int32_t MIN_CONE_AREA{120};
+
+// Summary of the cones seen in one frame of one camera.
+struct ConeDetections
+{
+    int64_t sampleTimeStamp{0};
+    int amountOfYellowCones{0};
+    int amountOfBlueCones{0};
+    ConeBlob largestYellow{};
+    ConeBlob largestBlue{};
+};
+
+inline ConeDetections summariseBlobs(const BlobList &blobs, int64_t sampleTimeStamp, int32_t minBlobArea = MIN_BLOB_AREA, int32_t minConeArea = MIN_CONE_AREA)
+{
+    ConeDetections detections;
+    detections.sampleTimeStamp = sampleTimeStamp;
+
+    int largestAreaYellow = 0;
+    int largestAreaBlue = 0;
+    for (const ConeBlob &blob : blobs)
+    {
+        const bool isYellow{ConeColour::Yellow == blob.colour};
+        if (blob.area() > minBlobArea)
+        {
+            int &largestArea = isYellow ? largestAreaYellow : largestAreaBlue;
+            if (blob.area() > largestArea)
+            {
+                largestArea = blob.area();
+                (isYellow ? detections.largestYellow : detections.largestBlue) = blob;
+            }
+
+            if (blob.area() > minConeArea)
+            {
+                (isYellow ? detections.amountOfYellowCones : detections.amountOfBlueCones) += 1;
+            }
+        }
+    }
+    return detections;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONE_RUNS_HPP
+#define CONE_RUNS_HPP
+
+#include "frame-arena.hpp"
+
+#include <cstdint>
+
+enum class ConeColour : uint8_t
+{
+    Yellow,
+    Blue
+};
+
+// Horizontal run of cone pixels [start, end) in one row.
+struct ConeRun
+{
+    uint16_t row;
+    uint16_t start;
+    uint16_t end;
+    ConeColour colour;
+};
+
+// The segmentation emits the runs of a frame ordered by row, then colour, then start.
+using RunList = ArenaVector<ConeRun>;
+
+constexpr uint32_t BITS_PER_WORD{64};
+
+// Mask with the bits [first, last) of a word set; 0 <= first <= last <= 64.
+inline uint64_t bitRange(uint32_t first, uint32_t last)
+{
+    const uint64_t upTo = (last >= BITS_PER_WORD) ? ~uint64_t{0} : ((uint64_t{1} << last) - 1);
+    const uint64_t below = (first >= BITS_PER_WORD) ? ~uint64_t{0} : ((uint64_t{1} << first) - 1);
+    return upTo & ~below;
+}
+
+// Turns the mask words of one row, fed from left to right, into runs; the
+// boundaries are found with count-trailing-zeros so empty words cost a single compare.
+class RunScanner
+{
+  public:
+    // Feeds the word holding the pixels [x, x + 64); f(start, end) is called for every run closed in it.
+    template <typename F>
+    void feed(uint64_t word, uint32_t x, F &&f)
+    {
+        uint32_t pos{0};
+        while (pos < BITS_PER_WORD)
+        {
+            const uint64_t rest{(m_open ? ~word : word) >> pos};
+            if (0 == rest)
+            {
+                break;
+            }
+            pos += static_cast<uint32_t>(__builtin_ctzll(rest));
+            if (m_open)
+            {
+                f(m_start, x + pos);
+            }
+            else
+            {
+                m_start = x + pos;
+            }
+            m_open = !m_open;
+        }
+    }
+
+    // Closes a run reaching the end of the row.
+    template <typename F>
+    void finish(uint32_t width, F &&f)
+    {
+        if (m_open)
+        {
+            f(m_start, width);
+        }
+        m_open = false;
+    }
+
+  private:
+    bool m_open{false};
+    uint32_t m_start{0};
+};
+
+#endif
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONE_SEGMENTATION_HPP
+#define CONE_SEGMENTATION_HPP
+
+#include "cone-runs.hpp"
+#include "cpu-features.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Byte order of the pixels in the frame; the shared memory from the h264decoder holds BGRA.
+enum class ChannelLayout
+{
+    BGRA,
+    BGR
+};
+
+template <ChannelLayout Layout>
+struct ChannelLayoutTraits;
+
+template <>
+struct ChannelLayoutTraits<ChannelLayout::BGRA>
+{
+    static constexpr uint32_t BYTES_PER_PIXEL{4};
+    static constexpr const char *NAME{"BGRA"};
+};
+
+template <>
+struct ChannelLayoutTraits<ChannelLayout::BGR>
+{
+    static constexpr uint32_t BYTES_PER_PIXEL{3};
+    static constexpr const char *NAME{"BGR"};
+};
+
+// Inclusive HSV bounds in OpenCV's 8 bit convention (H in [0, 180), S and V in [0, 255]).
+struct HsvRange
+{
+    uint8_t hLow;
+    uint8_t sLow;
+    uint8_t vLow;
+    uint8_t hHigh;
+    uint8_t sHigh;
+    uint8_t vHigh;
+};
+
+// Yellow cones are matched by two ranges as the lower hues need a separate band.
+struct ThresholdTable
+{
+    HsvRange yellow;
+    HsvRange yellowLow;
+    HsvRange blue;
+};
+
+constexpr ThresholdTable DEFAULT_THRESHOLDS{
+    {12, 20, 20, 70, 100, 250}, // Yellow(low, high) - Yellow cones
+    {8, 20, 20, 11, 100, 250},  // Yellow(low, high) - Yellow cones copy for lower ranges
+    {80, 125, 8, 135, 255, 210} // Blue(low, high) - Blue cones
+};
+
+inline bool operator==(const HsvRange &a, const HsvRange &b)
+{
+    return (a.hLow == b.hLow) && (a.sLow == b.sLow) && (a.vLow == b.vLow) &&
+           (a.hHigh == b.hHigh) && (a.sHigh == b.sHigh) && (a.vHigh == b.vHigh);
+}
+
+inline bool operator==(const ThresholdTable &a, const ThresholdTable &b)
+{
+    return (a.yellow == b.yellow) && (a.yellowLow == b.yellowLow) && (a.blue == b.blue);
+}
+
+// Threshold policies: the kernel reads the table through table(), which is a
+// compile-time constant for the static policy and a member for the runtime one.
+struct DefaultThresholds
+{
+    static constexpr ThresholdTable table() { return DEFAULT_THRESHOLDS; }
+};
+
+struct RuntimeThresholds
+{
+    ThresholdTable m_table;
+    const ThresholdTable &table() const { return m_table; }
+};
+
+// Geometry policies, same idea as the thresholds.
+template <uint32_t Width, uint32_t Height>
+struct FixedGeometry
+{
+    static constexpr uint32_t width() { return Width; }
+    static constexpr uint32_t height() { return Height; }
+};
+
+struct RuntimeGeometry
+{
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+};
+
+// Parts of the frame that never contain relevant cones: everything above the
+// horizon and the hood of the car. Both rectangles are inclusive pixel corners.
+struct BlankedRegion
+{
+    uint32_t left;
+    uint32_t top;
+    uint32_t right;
+    uint32_t bottom;
+};
+
+constexpr BlankedRegion HORIZON_REGION{0, 0, 650, 250};
+constexpr BlankedRegion HOOD_REGION{150, 385, 500, 500};
+
+// Reciprocal tables used by OpenCV's 8 bit BGR2HSV conversion; reproducing them
+// keeps the masks bit-identical to cvtColor + inRange.
+struct HsvDivisionTables
+{
+    static constexpr int HSV_SHIFT{12};
+    int sdiv[256];
+    int hdiv[256];
+
+    constexpr HsvDivisionTables() : sdiv{}, hdiv{}
+    {
+        for (int i = 1; i < 256; i++)
+        {
+            // Rounded divisions; the numerators are never exactly halfway.
+            sdiv[i] = ((255 << HSV_SHIFT) * 2 + i) / (2 * i);
+            hdiv[i] = ((180 << HSV_SHIFT) * 2 + 6 * i) / (12 * i);
+        }
+    }
+};
+
+constexpr HsvDivisionTables HSV_DIVISION_TABLES{};
+
+inline bool inHsvRange(const HsvRange &r, int h, int s, int v)
+{
+    return (h >= r.hLow) & (h <= r.hHigh) & (s >= r.sLow) & (s <= r.sHigh) & (v >= r.vLow) & (v <= r.vHigh);
+}
+
+// Packs 64 flags (0 or 1 per byte) into a word with bit i taken from flags[i];
+// the multiplication gathers the lowest bit of eight little-endian bytes at once.
+inline uint64_t packFlags(const uint8_t *flags)
+{
+    uint64_t word{0};
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        uint64_t eight;
+        std::memcpy(&eight, flags + 8 * i, sizeof(eight));
+        word |= ((eight * 0x0102040810204080ULL) >> 56) << (8 * i);
+    }
+    return word;
+}
+
+// Classifies up to 64 pixels into one yellow and one blue mask word; bit i belongs to pixel i.
+template <ChannelLayout Layout, typename Thresholds>
+__attribute__((always_inline)) inline void classifyWord(const Thresholds &thresholds, const uint8_t *src, uint32_t count, uint64_t &yellowWord, uint64_t &blueWord)
+{
+    constexpr uint32_t BPP{ChannelLayoutTraits<Layout>::BYTES_PER_PIXEL};
+    constexpr int ROUND{1 << (HsvDivisionTables::HSV_SHIFT - 1)};
+    const ThresholdTable &t = thresholds.table();
+
+    uint8_t yellow[BITS_PER_WORD]{};
+    uint8_t blue[BITS_PER_WORD]{};
+    for (uint32_t x = 0; x < count; x++)
+    {
+        const int b = src[x * BPP + 0];
+        const int g = src[x * BPP + 1];
+        const int r = src[x * BPP + 2];
+
+        int v = b > g ? b : g;
+        v = v > r ? v : r;
+        int vmin = b < g ? b : g;
+        vmin = vmin < r ? vmin : r;
+        const int diff = v - vmin;
+        const int vr = (v == r) ? -1 : 0;
+        const int vg = (v == g) ? -1 : 0;
+
+        const int s = (diff * HSV_DIVISION_TABLES.sdiv[v] + ROUND) >> HsvDivisionTables::HSV_SHIFT;
+        int h = (vr & (g - b)) + (~vr & ((vg & (b - r + 2 * diff)) + ((~vg) & (r - g + 4 * diff))));
+        h = (h * HSV_DIVISION_TABLES.hdiv[diff] + ROUND) >> HsvDivisionTables::HSV_SHIFT;
+        h += (h < 0) ? 180 : 0;
+
+        yellow[x] = static_cast<uint8_t>(inHsvRange(t.yellow, h, s, v) | inHsvRange(t.yellowLow, h, s, v));
+        blue[x] = static_cast<uint8_t>(inHsvRange(t.blue, h, s, v));
+    }
+    yellowWord = packFlags(yellow);
+    blueWord = packFlags(blue);
+}
+
+// Position of pixel x relative to a word starting at pixel first, clamped to [0, 64].
+inline uint32_t clampToWord(uint32_t x, uint32_t first)
+{
+    return (x <= first) ? 0 : ((x - first < BITS_PER_WORD) ? x - first : BITS_PER_WORD);
+}
+
+// Segments every rowStep-th row of a frame into runs of cone pixels. Every row
+// is classified a word at a time and scanned for runs straight away, so no mask
+// is stored; words inside the blanked regions are skipped without being classified.
+template <ChannelLayout Layout, typename Geometry, typename Thresholds>
+__attribute__((always_inline)) inline void segmentFrame(const Geometry &geometry, const Thresholds &thresholds, const uint8_t *src, uint32_t rowStep, RunList &runs, RunList &rowScratch)
+{
+    constexpr uint32_t BPP{ChannelLayoutTraits<Layout>::BYTES_PER_PIXEL};
+    const uint32_t width{geometry.width()};
+    const uint32_t height{geometry.height()};
+
+    runs.clear();
+    for (uint32_t y = 0; y < height; y += rowStep)
+    {
+        const uint8_t *srcRow = src + static_cast<size_t>(y) * width * BPP;
+        const uint16_t row{static_cast<uint16_t>(y)};
+
+        uint32_t first{0};
+        uint32_t hoodFirst{width};
+        uint32_t hoodLast{width};
+        if (y <= HORIZON_REGION.bottom)
+        {
+            first = (HORIZON_REGION.right + 1 < width) ? HORIZON_REGION.right + 1 : width;
+        }
+        if ((y >= HOOD_REGION.top) && (y <= HOOD_REGION.bottom) && (HOOD_REGION.left < width))
+        {
+            hoodFirst = HOOD_REGION.left;
+            hoodLast = (HOOD_REGION.right + 1 < width) ? HOOD_REGION.right + 1 : width;
+        }
+
+        // Blue runs of the row are held back to keep the list ordered by colour within a row.
+        rowScratch.clear();
+        RunScanner yellowScanner;
+        RunScanner blueScanner;
+        auto emitYellow = [&runs, row](uint32_t start, uint32_t end) {
+            runs.push_back(ConeRun{row, static_cast<uint16_t>(start), static_cast<uint16_t>(end), ConeColour::Yellow});
+        };
+        auto emitBlue = [&rowScratch, row](uint32_t start, uint32_t end) {
+            rowScratch.push_back(ConeRun{row, static_cast<uint16_t>(start), static_cast<uint16_t>(end), ConeColour::Blue});
+        };
+
+        for (uint32_t x = first - (first % BITS_PER_WORD); x < width; x += BITS_PER_WORD)
+        {
+            const uint32_t count{(width - x < BITS_PER_WORD) ? width - x : BITS_PER_WORD};
+            const uint64_t valid{bitRange(clampToWord(first, x), count) & ~bitRange(clampToWord(hoodFirst, x), clampToWord(hoodLast, x))};
+
+            uint64_t yellowWord{0};
+            uint64_t blueWord{0};
+            if (0 != valid)
+            {
+                classifyWord<Layout>(thresholds, srcRow + x * BPP, count, yellowWord, blueWord);
+            }
+            yellowScanner.feed(yellowWord & valid, x, emitYellow);
+            blueScanner.feed(blueWord & valid, x, emitBlue);
+        }
+        yellowScanner.finish(width, emitYellow);
+        blueScanner.finish(width, emitBlue);
+        runs.insert(runs.end(), rowScratch.begin(), rowScratch.end());
+    }
+}
+
+// Signature shared by all kernels; the prebuilt specialisations ignore geometry and thresholds.
+using SegmentationKernel = void (*)(const RuntimeGeometry &geometry, const RuntimeThresholds &thresholds, const uint8_t *src, uint32_t rowStep, RunList &runs, RunList &rowScratch);
+
+// All kernels compiled for one instruction set.
+struct SegmentationKernels
+{
+    SegmentationKernel bgra640x480;
+    SegmentationKernel bgra1280x720;
+    SegmentationKernel genericBGRA;
+    SegmentationKernel genericBGR;
+};
+
+// Instantiates the kernel family with the given target attribute; the
+// always_inline kernel body is then vectorised for that instruction set.
+#define DEFINE_SEGMENTATION_KERNELS(SUFFIX, TARGET)                                                                          \
+    template <uint32_t Width, uint32_t Height, ChannelLayout Layout, typename Thresholds>                                    \
+    TARGET void segmentSpecialised##SUFFIX(const RuntimeGeometry &, const RuntimeThresholds &, const uint8_t *src,          \
+                                           uint32_t rowStep, RunList &runs, RunList &rowScratch)                             \
+    {                                                                                                                        \
+        segmentFrame<Layout>(FixedGeometry<Width, Height>{}, Thresholds{}, src, rowStep, runs, rowScratch);                  \
+    }                                                                                                                        \
+    template <ChannelLayout Layout>                                                                                          \
+    TARGET void segmentGeneric##SUFFIX(const RuntimeGeometry &geometry, const RuntimeThresholds &thresholds,                \
+                                       const uint8_t *src, uint32_t rowStep, RunList &runs, RunList &rowScratch)             \
+    {                                                                                                                        \
+        segmentFrame<Layout>(geometry, thresholds, src, rowStep, runs, rowScratch);                                          \
+    }                                                                                                                        \
+    inline SegmentationKernels segmentationKernels##SUFFIX()                                                                 \
+    {                                                                                                                        \
+        return {&segmentSpecialised##SUFFIX<640, 480, ChannelLayout::BGRA, DefaultThresholds>,                               \
+                &segmentSpecialised##SUFFIX<1280, 720, ChannelLayout::BGRA, DefaultThresholds>,                              \
+                &segmentGeneric##SUFFIX<ChannelLayout::BGRA>,                                                                \
+                &segmentGeneric##SUFFIX<ChannelLayout::BGR>};                                                                \
+    }
+
+DEFINE_SEGMENTATION_KERNELS(Baseline, )
+#ifdef CPU_TARGET_SSE42
+DEFINE_SEGMENTATION_KERNELS(SSE42, CPU_TARGET_SSE42)
+DEFINE_SEGMENTATION_KERNELS(AVX2, CPU_TARGET_AVX2)
+DEFINE_SEGMENTATION_KERNELS(AVX512, CPU_TARGET_AVX512)
+#endif
+#ifdef CPU_TARGET_NEON
+DEFINE_SEGMENTATION_KERNELS(NEON, CPU_TARGET_NEON)
+#endif
+
+// Returns the kernels for the instruction set and the instruction set actually used.
+inline SegmentationKernels selectSegmentationKernels(CpuIsa &isa)
+{
+    switch (isa)
+    {
+#ifdef CPU_TARGET_SSE42
+    case CpuIsa::SSE42:
+        return segmentationKernelsSSE42();
+    case CpuIsa::AVX2:
+        return segmentationKernelsAVX2();
+    case CpuIsa::AVX512:
+        return segmentationKernelsAVX512();
+#endif
+#ifdef CPU_TARGET_NEON
+    case CpuIsa::NEON:
+        return segmentationKernelsNEON();
+#endif
+    default:
+        isa = CpuIsa::Generic;
+        return segmentationKernelsBaseline();
+    }
+}
+
+// Picks a prebuilt specialisation for the frame format and falls back to the
+// generic, runtime-parameterised kernel for everything else; both are taken
+// from the variant matching the instruction set of the CPU.
+class ConeSegmenter
+{
+  public:
+    ConeSegmenter(uint32_t width, uint32_t height, ChannelLayout layout, const ThresholdTable &thresholds, CpuIsa isa = detectCpuIsa())
+        : m_geometry{width, height}, m_thresholds{thresholds}, m_kernel{nullptr}, m_description{}, m_rowScratch{}
+    {
+        const SegmentationKernels kernels{selectSegmentationKernels(isa)};
+        if ((ChannelLayout::BGRA == layout) && (DEFAULT_THRESHOLDS == thresholds))
+        {
+            if ((640 == width) && (480 == height))
+            {
+                m_kernel = kernels.bgra640x480;
+            }
+            else if ((1280 == width) && (720 == height))
+            {
+                m_kernel = kernels.bgra1280x720;
+            }
+        }
+
+        m_description = std::string{(nullptr != m_kernel) ? "specialised " : "generic "} +
+                        std::to_string(width) + "x" + std::to_string(height) + " " +
+                        ((ChannelLayout::BGRA == layout) ? ChannelLayoutTraits<ChannelLayout::BGRA>::NAME : ChannelLayoutTraits<ChannelLayout::BGR>::NAME) +
+                        " (" + cpuIsaName(isa) + ")";
+
+        if (nullptr == m_kernel)
+        {
+            m_kernel = (ChannelLayout::BGRA == layout) ? kernels.genericBGRA : kernels.genericBGR;
+        }
+    }
+
+    // Replaces runs with the cone runs of a continuous frame; a rowStep above 1 only segments every rowStep-th row.
+    void segment(const uint8_t *src, RunList &runs, uint32_t rowStep = 1)
+    {
+        m_kernel(m_geometry, m_thresholds, src, rowStep, runs, m_rowScratch);
+    }
+
+    const std::string &description() const
+    {
+        return m_description;
+    }
+
+    const ThresholdTable &thresholds() const
+    {
+        return m_thresholds.table();
+    }
+
+  private:
+    RuntimeGeometry m_geometry;
+    RuntimeThresholds m_thresholds;
+    SegmentationKernel m_kernel;
+    std::string m_description;
+    RunList m_rowScratch;
+};
+
+#endif
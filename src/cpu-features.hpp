@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+#if defined(__arm__) || defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
+// Instruction set variants the pixel kernels are compiled for; the same
+// binary runs on the x86 replay servers and on the ARM vehicle computers.
+enum class CpuIsa
+{
+    Generic,
+    SSE42,
+    AVX2,
+    AVX512,
+    NEON
+};
+
+inline const char *cpuIsaName(CpuIsa isa)
+{
+    switch (isa)
+    {
+    case CpuIsa::SSE42:
+        return "SSE4.2";
+    case CpuIsa::AVX2:
+        return "AVX2";
+    case CpuIsa::AVX512:
+        return "AVX-512";
+    case CpuIsa::NEON:
+        return "NEON";
+    default:
+        return "generic";
+    }
+}
+
+// Returns the best instruction set supported by the running CPU (cpuid on x86, AT_HWCAP on ARM).
+inline CpuIsa detectCpuIsa()
+{
+    CpuIsa isa{CpuIsa::Generic};
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+        isa = CpuIsa::AVX512;
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        isa = CpuIsa::AVX2;
+    }
+    else if (__builtin_cpu_supports("sse4.2"))
+    {
+        isa = CpuIsa::SSE42;
+    }
+#elif defined(__aarch64__)
+    // Advanced SIMD is mandatory on ARMv8, but the kernel still reports it.
+    if (0 != (getauxval(AT_HWCAP) & HWCAP_ASIMD))
+    {
+        isa = CpuIsa::NEON;
+    }
+#elif defined(__arm__)
+    if (0 != (getauxval(AT_HWCAP) & HWCAP_NEON))
+    {
+        isa = CpuIsa::NEON;
+    }
+#endif
+    return isa;
+}
+
+// Function attributes for the kernel variants; an empty attribute means the variant is the baseline build.
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#define CPU_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#elif defined(__arm__) && !defined(__ARM_NEON)
+#define CPU_TARGET_NEON __attribute__((target("fpu=neon")))
+#elif defined(__arm__) || defined(__aarch64__)
+#define CPU_TARGET_NEON
+#endif
+
+#endif
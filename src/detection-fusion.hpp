@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DETECTION_FUSION_HPP
+#define DETECTION_FUSION_HPP
+
+#include "cone-detections.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Collects the cone detections of all cameras. The primary camera (index 0)
+// drives the output cadence; the other cameras add the cones they have seen
+// close to the primary sample time. Box positions stay those of the primary
+// camera as image coordinates of different cameras cannot be compared.
+class DetectionFusion
+{
+  public:
+    // Detections of secondary cameras further apart from the primary frame are ignored.
+    static constexpr int64_t FUSION_WINDOW_US{100000};
+
+    explicit DetectionFusion(size_t cameras)
+        : m_mutex{}, m_condition{}, m_latest(cameras), m_valid(cameras, false), m_primaryPending{false}
+    {
+    }
+
+    // Called by the waiter thread of a camera after each frame.
+    void submit(size_t camera, const ConeDetections &detections)
+    {
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_latest[camera] = detections;
+            m_valid[camera] = true;
+            m_primaryPending = m_primaryPending || (0 == camera);
+        }
+        if (0 == camera)
+        {
+            m_condition.notify_one();
+        }
+    }
+
+    // Waits for the next frame of the primary camera; returns false on timeout.
+    bool waitForPrimary(std::chrono::microseconds timeout, ConeDetections &fused)
+    {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if (!m_condition.wait_for(lck, timeout, [this]() { return m_primaryPending; }))
+        {
+            return false;
+        }
+        m_primaryPending = false;
+
+        fused = m_latest[0];
+        for (size_t camera = 1; camera < m_latest.size(); camera++)
+        {
+            const ConeDetections &other = m_latest[camera];
+            const int64_t distance{other.sampleTimeStamp - fused.sampleTimeStamp};
+            if (m_valid[camera] && (distance < FUSION_WINDOW_US) && (distance > -FUSION_WINDOW_US))
+            {
+                fused.amountOfYellowCones += other.amountOfYellowCones;
+                fused.amountOfBlueCones += other.amountOfBlueCones;
+            }
+        }
+        return true;
+    }
+
+  private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::vector<ConeDetections> m_latest;
+    std::vector<bool> m_valid;
+    bool m_primaryPending;
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Monotonic arena for everything that lives for one frame: allocation bumps a
+// pointer, deallocation does nothing and reset() frees it all at once. When a
+// frame needed more than the first block, reset() replaces the blocks by one
+// block of the total size, so that from then on a frame fits into one block.
+class FrameArena
+{
+  private:
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+  public:
+    explicit FrameArena(size_t initialBytes = 64 * 1024)
+        : m_blocks{}, m_current{nullptr}, m_end{nullptr}, m_used{0}, m_highWater{0}
+    {
+        addBlock(initialBytes);
+    }
+
+    void *allocate(size_t bytes, size_t alignment)
+    {
+        uintptr_t p{(reinterpret_cast<uintptr_t>(m_current) + alignment - 1) & ~(alignment - 1)};
+        if (p + bytes > reinterpret_cast<uintptr_t>(m_end))
+        {
+            addBlock((bytes + alignment > m_blocks.back().size * 2) ? bytes + alignment : m_blocks.back().size * 2);
+            p = (reinterpret_cast<uintptr_t>(m_current) + alignment - 1) & ~(alignment - 1);
+        }
+        m_current = reinterpret_cast<uint8_t *>(p + bytes);
+        m_used += bytes;
+        return reinterpret_cast<void *>(p);
+    }
+
+    // Releases all allocations of the frame; nothing allocated before may be used afterwards.
+    void reset()
+    {
+        m_highWater = (m_used > m_highWater) ? m_used : m_highWater;
+        if (1 < m_blocks.size())
+        {
+            size_t total{0};
+            for (const Block &block : m_blocks)
+            {
+                total += block.size;
+            }
+            m_blocks.clear();
+            addBlock(total);
+        }
+        m_current = m_blocks.back().data.get();
+        m_end = m_current + m_blocks.back().size;
+        m_used = 0;
+    }
+
+    // Largest number of bytes handed out in one frame so far.
+    size_t highWater() const { return (m_used > m_highWater) ? m_used : m_highWater; }
+
+  private:
+    struct Block
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    void addBlock(size_t bytes)
+    {
+        m_blocks.push_back(Block{std::unique_ptr<uint8_t[]>(new uint8_t[bytes]), bytes});
+        m_current = m_blocks.back().data.get();
+        m_end = m_current + bytes;
+    }
+
+  private:
+    std::vector<Block> m_blocks;
+    uint8_t *m_current;
+    uint8_t *m_end;
+    size_t m_used;
+    size_t m_highWater;
+};
+
+// Allocator for standard containers living on a FrameArena; without an arena
+// it falls back to the global heap, so that containers keep working outside of
+// the frame loop.
+template <typename T>
+class ArenaAllocator
+{
+  public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept : m_arena{nullptr}
+    {
+    }
+
+    explicit ArenaAllocator(FrameArena *arena) noexcept : m_arena{arena}
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : m_arena{other.arena()}
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        if (nullptr == m_arena)
+        {
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, size_t) noexcept
+    {
+        if (nullptr == m_arena)
+        {
+            ::operator delete(p);
+        }
+    }
+
+    FrameArena *arena() const noexcept { return m_arena; }
+
+  private:
+    FrameArena *m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) noexcept
+{
+    return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) noexcept
+{
+    return a.arena() != b.arena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif
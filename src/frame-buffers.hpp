@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_BUFFERS_HPP
+#define FRAME_BUFFERS_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Frame sized buffer taken directly from the kernel: backed by 2 MB pages when
+// possible, placed on the NUMA node of the allocating thread and pre-faulted so
+// that the pixel loops neither page-fault nor miss the TLB on every 4 KB.
+class FrameBuffer
+{
+  private:
+    FrameBuffer(const FrameBuffer &) = delete;
+    FrameBuffer &operator=(const FrameBuffer &) = delete;
+
+  public:
+    static constexpr size_t HUGE_PAGE_SIZE{2 * 1024 * 1024};
+
+    FrameBuffer(size_t bytes, bool hugePages)
+        : m_data{MAP_FAILED}, m_size{roundUp(bytes, hugePages ? HUGE_PAGE_SIZE : pageSize())}, m_backing{"4 KB pages"}, m_node{-1}
+    {
+        if (hugePages)
+        {
+            m_data = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            m_backing = "2 MB huge pages";
+        }
+        if (MAP_FAILED == m_data)
+        {
+            // No huge pages reserved (vm.nr_hugepages); ask for transparent huge pages instead.
+            m_data = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (MAP_FAILED == m_data)
+            {
+                throw std::bad_alloc();
+            }
+            m_backing = (hugePages && (0 == ::madvise(m_data, m_size, MADV_HUGEPAGE))) ? "transparent huge pages" : "4 KB pages";
+        }
+
+        // Prefer the node of the calling thread; fails harmlessly on kernels without NUMA support.
+        unsigned int cpu{0};
+        unsigned int node{0};
+        if (0 == ::syscall(SYS_getcpu, &cpu, &node, nullptr))
+        {
+            const unsigned long nodeMask{1UL << node};
+            if (0 == ::syscall(SYS_mbind, m_data, m_size, MPOL_PREFERRED, &nodeMask, sizeof(nodeMask) * 8, 0))
+            {
+                m_node = static_cast<int>(node);
+            }
+        }
+
+        // Touch every page now instead of in the first frames.
+        uint8_t *bytesToTouch = static_cast<uint8_t *>(m_data);
+        for (size_t offset = 0; offset < m_size; offset += pageSize())
+        {
+            bytesToTouch[offset] = 0;
+        }
+    }
+
+    ~FrameBuffer()
+    {
+        ::munmap(m_data, m_size);
+    }
+
+    uint8_t *data() const { return static_cast<uint8_t *>(m_data); }
+
+    std::string description() const
+    {
+        return m_backing + ((0 <= m_node) ? " on NUMA node " + std::to_string(m_node) : std::string{});
+    }
+
+  private:
+    static size_t pageSize()
+    {
+        static const size_t PAGE_SIZE{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+        return PAGE_SIZE;
+    }
+
+    static size_t roundUp(size_t bytes, size_t alignment)
+    {
+        return (bytes + alignment - 1) / alignment * alignment;
+    }
+
+  private:
+    void *m_data;
+    const size_t m_size;
+    std::string m_backing;
+    int m_node;
+};
+
+// Owns the frame buffers of one camera; the images handed out refer to buffers
+// that live as long as the pool. A disabled pool leaves allocation to OpenCV.
+class FrameBufferPool
+{
+  public:
+    explicit FrameBufferPool(bool hugePages)
+        : m_hugePages{hugePages}, m_buffers{}
+    {
+    }
+
+    bool enabled() const { return m_hugePages; }
+
+    // Returns a BGRA image backed by a new buffer; call it from the thread that will process the image.
+    cv::Mat allocate(uint32_t width, uint32_t height)
+    {
+        if (!m_hugePages)
+        {
+            return cv::Mat(static_cast<int>(height), static_cast<int>(width), CV_8UC4);
+        }
+        m_buffers.emplace_back(new FrameBuffer{static_cast<size_t>(width) * height * 4, true});
+        return cv::Mat(static_cast<int>(height), static_cast<int>(width), CV_8UC4, m_buffers.back()->data());
+    }
+
+    std::string description() const
+    {
+        return m_buffers.empty() ? std::string{"heap"} : std::to_string(m_buffers.size()) + " buffers in " + m_buffers.back()->description();
+    }
+
+  private:
+    const bool m_hugePages;
+    std::vector<std::unique_ptr<FrameBuffer>> m_buffers;
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_CONTEXT_HPP
+#define FRAME_CONTEXT_HPP
+
+#include "cluon-complete.hpp"
+#include "cone-blobs.hpp"
+#include "cone-segmentation.hpp"
+#include "frame-arena.hpp"
+#include "frame-buffers.hpp"
+#include "frame-pacing.hpp"
+#include "realtime.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Everything one camera needs to turn frames from its shared memory area into
+// cone detections; each context is only used by the threads of its camera,
+// except for the statistics and the wake lag, which are exported from the main thread.
+struct FrameContext
+{
+    FrameContext(size_t cameraIndex, const std::string &name, uint32_t frameWidth, uint32_t frameHeight, FramePolicy framePolicy, size_t queueCapacity,
+                 bool hugePages)
+        : index{cameraIndex}, width{frameWidth}, height{frameHeight}, policy{framePolicy}, sharedMemory{new cluon::SharedMemory{name}},
+          segmenter{frameWidth, frameHeight, ChannelLayout::BGRA, DEFAULT_THRESHOLDS}, arena{}, runCount{0}, frameBuffers{hugePages}, img{},
+          sequence{0}, staging{}, statistics{}, wakeLag{}, queue{(FramePolicy::Queue == framePolicy) ? new FrameQueue{queueCapacity} : nullptr},
+          governor{}, displayMutex{}, display{}
+    {
+    }
+
+    const size_t index;
+    const uint32_t width;
+    const uint32_t height;
+    const FramePolicy policy;
+    std::unique_ptr<cluon::SharedMemory> sharedMemory;
+    ConeSegmenter segmenter;
+    // Holds the runs and blobs of the frame being processed; runCount of the previous frame sizes the run list.
+    FrameArena arena;
+    size_t runCount;
+    // Backs img, staging, display and the queued frames when enabled; must outlive them.
+    FrameBufferPool frameBuffers;
+    cv::Mat img;
+
+    // Last sequence of the shared memory seen and, when queueing, the frame copied
+    // out without the lock (only used if the producer maintains a sequence counter).
+    uint32_t sequence;
+    cv::Mat staging;
+
+    // Frame drop accounting and the state of the catch-up policy.
+    FrameStatistics statistics;
+    WakeLagStatistics wakeLag;
+    std::unique_ptr<FrameQueue> queue;
+    QualityGovernor governor;
+
+    // Annotated copy of the last frame for the main thread to show in verbose mode.
+    std::mutex displayMutex;
+    cv::Mat display;
+};
+
+#endif
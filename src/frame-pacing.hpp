@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_PACING_HPP
+#define FRAME_PACING_HPP
+
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// How a camera keeps up when processing a frame takes longer than the frame interval.
+enum class FramePolicy
+{
+    // Process the frame in the shared memory when done with the previous one; frames in between are dropped.
+    Latest,
+    // Copy every frame into a bounded queue and process them in order; the oldest frame is dropped when full.
+    Queue,
+    // Like Latest, but segment fewer rows while processing is slower than the frame rate.
+    Adaptive
+};
+
+inline bool parseFramePolicy(const std::string &name, FramePolicy &policy)
+{
+    if ("latest" == name)
+    {
+        policy = FramePolicy::Latest;
+    }
+    else if ("queue" == name)
+    {
+        policy = FramePolicy::Queue;
+    }
+    else if ("adaptive" == name)
+    {
+        policy = FramePolicy::Adaptive;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Longest queue --queue accepts; every queued frame is a copy of the whole image.
+constexpr size_t MAX_QUEUE_LENGTH{64};
+
+// Parses the number of frames a FrameQueue buffers, from 1 to MAX_QUEUE_LENGTH.
+inline bool parseQueueLength(const std::string &text, size_t &length)
+{
+    if (text.empty() || (std::string::npos != text.find_first_not_of("0123456789")) || (text.size() > 4))
+    {
+        return false;
+    }
+    const size_t parsed{static_cast<size_t>(std::stoul(text))};
+    if ((1 > parsed) || (MAX_QUEUE_LENGTH < parsed))
+    {
+        return false;
+    }
+    length = parsed;
+    return true;
+}
+
+// Follows the sample time stamps of a camera to count dropped and duplicate
+// frames; the counters are read from other threads to export them.
+class FrameStatistics
+{
+  public:
+    FrameStatistics()
+        : m_processed{0}, m_dropped{0}, m_duplicates{0}, m_overflows{0}, m_torn{0}, m_period{0}, m_lastSampleTimeStamp{0}, m_lastSampleNumber{0}
+    {
+    }
+
+    // Returns false if the frame carries the same sample time (or number) as the previous one.
+    // Producers that number their samples (cf. cluon::SharedMemory::sampleNumber()) tell the
+    // dropped frames exactly; otherwise they are estimated from gaps in the sample times.
+    bool observe(int64_t sampleTimeStamp, uint32_t sampleNumber = 0)
+    {
+        const int64_t delta{sampleTimeStamp - m_lastSampleTimeStamp};
+        const bool numbered{(0 != sampleNumber) && (0 != m_lastSampleNumber)};
+        if ((numbered && (sampleNumber == m_lastSampleNumber)) || (!numbered && (0 == delta) && (0 != m_lastSampleTimeStamp)))
+        {
+            m_duplicates++;
+            return false;
+        }
+
+        const int64_t period{m_period.load()};
+        const bool gap{(0 != period) && (2 * delta > 3 * period)};
+        if (numbered && (sampleNumber > m_lastSampleNumber))
+        {
+            m_dropped += sampleNumber - m_lastSampleNumber - 1;
+        }
+        else if (!numbered && gap && (0 != m_lastSampleTimeStamp))
+        {
+            // Gaps of more than 1.5 frame intervals hide frames we never saw.
+            m_dropped += static_cast<uint64_t>((delta + period / 2) / period - 1);
+        }
+
+        if ((0 == m_lastSampleTimeStamp) || (delta < 0))
+        {
+            // First frame or the recording was restarted; the period stays as it was.
+        }
+        else if (0 == period)
+        {
+            m_period.store(delta);
+        }
+        else if (!gap)
+        {
+            m_period.store(period + (delta - period) / 8);
+        }
+        m_lastSampleTimeStamp = sampleTimeStamp;
+        m_lastSampleNumber = sampleNumber;
+        return true;
+    }
+
+    void countProcessed() { m_processed++; }
+    void countOverflow() { m_overflows++; }
+    // Frames the producer changed while they were copied without the lock.
+    void countTorn() { m_torn++; }
+
+    // Estimated frame interval in microseconds; 0 until two frames were seen.
+    int64_t period() const { return m_period.load(); }
+
+    std::string summary() const
+    {
+        return "processed=" + std::to_string(m_processed.load()) + ";dropped=" + std::to_string(m_dropped.load()) +
+               ";duplicates=" + std::to_string(m_duplicates.load()) + ";overflows=" + std::to_string(m_overflows.load()) +
+               ";torn=" + std::to_string(m_torn.load()) + ";period=" + std::to_string(m_period.load());
+    }
+
+  private:
+    std::atomic<uint64_t> m_processed;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_duplicates;
+    std::atomic<uint64_t> m_overflows;
+    std::atomic<uint64_t> m_torn;
+    std::atomic<int64_t> m_period;
+    int64_t m_lastSampleTimeStamp;
+    uint32_t m_lastSampleNumber;
+};
+
+// Bounded queue of frame copies for FramePolicy::Queue; the images are recycled
+// so that the steady state does not allocate.
+class FrameQueue
+{
+  public:
+    explicit FrameQueue(size_t capacity)
+        : m_mutex{}, m_condition{}, m_capacity{capacity > 0 ? capacity : 1}, m_frames{}, m_free{}
+    {
+    }
+
+    // Copies the frame into the queue; returns false if the oldest frame had to be dropped for it.
+    bool push(const cv::Mat &frame, int64_t sampleTimeStamp)
+    {
+        bool overflow{false};
+        QueuedFrame slot;
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            if (m_frames.size() >= m_capacity)
+            {
+                m_free.push_back(std::move(m_frames.front().img));
+                m_frames.pop_front();
+                overflow = true;
+            }
+            if (!m_free.empty())
+            {
+                slot.img = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+        frame.copyTo(slot.img);
+        slot.sampleTimeStamp = sampleTimeStamp;
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_frames.push_back(std::move(slot));
+        }
+        m_condition.notify_one();
+        return !overflow;
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+    // Adds an image to reuse for the copies, e.g. one backed by a FrameBuffer.
+    void recycle(cv::Mat &&img)
+    {
+        std::lock_guard<std::mutex> lck(m_mutex);
+        m_free.push_back(std::move(img));
+    }
+
+    // Takes the oldest frame; the image previously held by img is recycled. Returns false on timeout.
+    bool pop(cv::Mat &img, int64_t &sampleTimeStamp, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lck(m_mutex);
+        if (!m_condition.wait_for(lck, timeout, [this]() { return !m_frames.empty(); }))
+        {
+            return false;
+        }
+        m_free.push_back(std::move(img));
+        img = std::move(m_frames.front().img);
+        sampleTimeStamp = m_frames.front().sampleTimeStamp;
+        m_frames.pop_front();
+        return true;
+    }
+
+  private:
+    struct QueuedFrame
+    {
+        cv::Mat img{};
+        int64_t sampleTimeStamp{0};
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    const size_t m_capacity;
+    std::deque<QueuedFrame> m_frames;
+    std::vector<cv::Mat> m_free;
+};
+
+// Chooses the row step of the segmentation for FramePolicy::Adaptive: every
+// second or fourth row is segmented while a frame takes longer than the frame
+// interval, and full quality returns once processing is comfortably fast again.
+class QualityGovernor
+{
+  public:
+    static constexpr uint32_t MAX_ROW_STEP{4};
+
+    uint32_t rowStep() const { return m_rowStep; }
+
+    void update(std::chrono::microseconds processingTime, int64_t period)
+    {
+        m_processingTime += (processingTime.count() - m_processingTime) / 4;
+        if (0 >= period)
+        {
+            return;
+        }
+        if ((10 * m_processingTime > 9 * period) && (m_rowStep < MAX_ROW_STEP))
+        {
+            m_rowStep *= 2;
+            m_processingTime /= 2;
+        }
+        else if ((10 * m_processingTime < 4 * period) && (m_rowStep > 1))
+        {
+            m_rowStep /= 2;
+            m_processingTime *= 2;
+        }
+    }
+
+  private:
+    uint32_t m_rowStep{1};
+    int64_t m_processingTime{0};
+};
+
+#endif
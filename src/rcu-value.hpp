@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RCU_VALUE_HPP
+#define RCU_VALUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// Value that is read without locks and replaced as a whole (read-copy-update
+// with quiescent-state based reclamation). Every reading thread holds a Reader
+// while it reads and calls its quiescent() between two units of work, e.g.
+// frames; a reference returned by read() stays valid until the reader's next
+// quiescent(). Replaced values are freed once every reader has passed a
+// quiescent state. The number of readers at a time is fixed on construction.
+template <typename T>
+class RcuValue
+{
+  private:
+    RcuValue(const RcuValue &) = delete;
+    RcuValue &operator=(const RcuValue &) = delete;
+
+  public:
+    // Registration of the calling thread as reader for as long as it exists.
+    class Reader
+    {
+      private:
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+      public:
+        explicit Reader(RcuValue &value)
+            : m_value(value), m_slot{value.registerReader()}
+        {
+        }
+
+        ~Reader() { m_value.unregisterReader(m_slot); }
+
+        // The reader holds no reference from read() anymore.
+        void quiescent() { m_value.quiescent(m_slot); }
+
+      private:
+        RcuValue &m_value;
+        const size_t m_slot;
+    };
+
+    RcuValue(const T &initial, size_t maxReaders)
+        : m_current{new T(initial)}, m_epoch{1}, m_maxReaders{maxReaders}, m_readers{new ReaderSlot[maxReaders]}, m_writerMutex{}, m_retired{}
+    {
+    }
+
+    ~RcuValue()
+    {
+        delete m_current.load();
+        for (const Retired &retired : m_retired)
+        {
+            delete retired.value;
+        }
+    }
+
+    const T &read() const { return *m_current.load(); }
+
+    // Replaces the value; the previous one is freed after a grace period.
+    void publish(std::unique_ptr<T> value)
+    {
+        std::lock_guard<std::mutex> lck(m_writerMutex);
+        publishLocked(std::move(value));
+    }
+
+    // Publishes a copy of the current value modified by f(T &) unless f returns false.
+    template <typename F>
+    bool update(F &&f)
+    {
+        std::lock_guard<std::mutex> lck(m_writerMutex);
+        std::unique_ptr<T> value{new T(*m_current.load())};
+        if (!f(*value))
+        {
+            return false;
+        }
+        publishLocked(std::move(value));
+        return true;
+    }
+
+    // Frees the replaced values that no reader can see anymore.
+    void reclaim()
+    {
+        std::lock_guard<std::mutex> lck(m_writerMutex);
+        reclaimLocked();
+    }
+
+  private:
+    // Slots of threads that are not reading hold back nothing.
+    static constexpr uint64_t FREE{UINT64_MAX};
+
+    // Claims a free slot; throws std::length_error if more threads read at a time than the value was constructed for.
+    size_t registerReader()
+    {
+        for (size_t reader = 0; reader < m_maxReaders; reader++)
+        {
+            uint64_t expected{FREE};
+            if (m_readers[reader].epoch.compare_exchange_strong(expected, m_epoch.load()))
+            {
+                return reader;
+            }
+        }
+        throw std::length_error("RcuValue: too many readers");
+    }
+
+    void unregisterReader(size_t reader) { m_readers[reader].epoch.store(FREE); }
+
+    void quiescent(size_t reader) { m_readers[reader].epoch.store(m_epoch.load()); }
+
+    struct Retired
+    {
+        const T *value;
+        uint64_t epoch;
+    };
+
+    // One cache line per reader so that quiescent() does not bounce between cores.
+    struct ReaderSlot
+    {
+        std::atomic<uint64_t> epoch{FREE};
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    void publishLocked(std::unique_ptr<T> value)
+    {
+        const T *previous{m_current.exchange(value.release())};
+        const uint64_t epoch{m_epoch.fetch_add(1) + 1};
+        m_retired.push_back(Retired{previous, epoch});
+        reclaimLocked();
+    }
+
+    void reclaimLocked()
+    {
+        uint64_t oldest{m_epoch.load()};
+        for (size_t reader = 0; reader < m_maxReaders; reader++)
+        {
+            const uint64_t epoch{m_readers[reader].epoch.load()};
+            oldest = (epoch < oldest) ? epoch : oldest;
+        }
+
+        size_t kept{0};
+        for (const Retired &retired : m_retired)
+        {
+            if (retired.epoch <= oldest)
+            {
+                delete retired.value;
+            }
+            else
+            {
+                m_retired[kept++] = retired;
+            }
+        }
+        m_retired.resize(kept);
+    }
+
+  private:
+    std::atomic<const T *> m_current;
+    std::atomic<uint64_t> m_epoch;
+    const size_t m_maxReaders;
+    std::unique_ptr<ReaderSlot[]> m_readers;
+    std::mutex m_writerMutex;
+    std::vector<Retired> m_retired;
+};
+
+#endif
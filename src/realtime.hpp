@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALTIME_HPP
+#define REALTIME_HPP
+
+#include "steering.hpp"
+
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// How a thread runs in real-time mode: pinned to cpu unless it is negative, with SCHED_FIFO at priority.
+struct RealtimeSchedule
+{
+    bool enabled{false};
+    int cpu{-1};
+    int priority{0};
+};
+
+// Parses a comma-separated list of CPU numbers like "2,3".
+inline bool parseCpuList(const std::string &text, std::vector<int> &cpus)
+{
+    // splitList drops an empty last entry.
+    if (text.empty() || (',' == text.back()))
+    {
+        return false;
+    }
+    std::vector<int> parsed;
+    for (const std::string &entry : splitList(text, ','))
+    {
+        if (entry.empty() || (std::string::npos != entry.find_first_not_of("0123456789")) || (entry.size() > 4))
+        {
+            return false;
+        }
+        const int cpu{std::stoi(entry)};
+        if (cpu >= CPU_SETSIZE)
+        {
+            return false;
+        }
+        parsed.push_back(cpu);
+    }
+    if (parsed.empty())
+    {
+        return false;
+    }
+    cpus = parsed;
+    return true;
+}
+
+// Parses a SCHED_FIFO priority [1 .. 99].
+inline bool parsePriority(const std::string &text, int &priority)
+{
+    if (text.empty() || (std::string::npos != text.find_first_not_of("0123456789")) || (text.size() > 2))
+    {
+        return false;
+    }
+    const int parsed{std::stoi(text)};
+    if (1 > parsed)
+    {
+        return false;
+    }
+    priority = parsed;
+    return true;
+}
+
+// Restricts the thread to the given CPU; fails for CPUs outside the cpuset of the process.
+inline bool pinThread(pthread_t thread, int cpu, std::string &error)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    const int result{::pthread_setaffinity_np(thread, sizeof(cpus), &cpus)};
+    if (0 != result)
+    {
+        error = "cannot pin to CPU " + std::to_string(cpu) + " (" + std::strerror(result) + ")";
+        return false;
+    }
+    return true;
+}
+
+// Runs the thread with SCHED_FIFO at the given priority [1 .. 99]; needs CAP_SYS_NICE
+// or an RLIMIT_RTPRIO of at least the priority.
+inline bool setFifoPriority(pthread_t thread, int priority, std::string &error)
+{
+    struct sched_param parameters
+    {
+    };
+    parameters.sched_priority = priority;
+    const int result{::pthread_setschedparam(thread, SCHED_FIFO, &parameters)};
+    if (0 != result)
+    {
+        error = "cannot run with SCHED_FIFO priority " + std::to_string(priority) + " (" + std::strerror(result) + ")";
+        return false;
+    }
+    return true;
+}
+
+// Locks all current and future pages of the process into memory and keeps glibc
+// from handing freed memory back to the kernel, so that the frame loop never
+// waits for a page fault; fails without CAP_IPC_LOCK beyond RLIMIT_MEMLOCK.
+inline bool lockMemory(std::string &error)
+{
+    if (0 != ::mlockall(MCL_CURRENT | MCL_FUTURE))
+    {
+        error = std::string{"cannot lock the memory ("} + std::strerror(errno) + ")";
+        return false;
+    }
+    // Without locked pages, keeping freed memory would only grow the process.
+    ::mallopt(M_TRIM_THRESHOLD, -1);
+    ::mallopt(M_MMAP_MAX, 0);
+    return true;
+}
+
+// Touches every page of the given memory, keeping its content.
+inline void prefault(void *data, size_t bytes)
+{
+    static const size_t PAGE_SIZE{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+    volatile uint8_t *bytesToTouch = static_cast<volatile uint8_t *>(data);
+    for (size_t offset = 0; offset < bytes; offset += PAGE_SIZE)
+    {
+        bytesToTouch[offset] = bytesToTouch[offset];
+    }
+}
+
+// Touches the stack the calling thread is going to need; call it at the start of each real-time thread.
+inline void prefaultStack()
+{
+    constexpr size_t STACK_SIZE{256 * 1024};
+    uint8_t stack[STACK_SIZE];
+    prefault(stack, STACK_SIZE);
+}
+
+// Current time on CLOCK_MONOTONIC in microseconds, the clock the producers
+// stamp publishing a frame with (cluon::SharedMemory::publishedAt()).
+inline int64_t monotonicMicroseconds()
+{
+    struct timespec now
+    {
+    };
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+// Time from publishing a frame until its waiter thread woke up, in
+// microseconds, both taken on CLOCK_MONOTONIC. Filled by the waiter thread;
+// the summary is read from other threads.
+class WakeLagStatistics
+{
+  public:
+    static constexpr int64_t BUCKET_WIDTH{10};
+    static constexpr size_t BUCKETS{1000};
+
+    WakeLagStatistics()
+        : m_buckets{}, m_count{0}, m_sum{0}, m_max{0}
+    {
+    }
+
+    // Lags beyond the last bucket (10 ms) are only counted there; the maximum stays exact.
+    void observe(int64_t lag)
+    {
+        const int64_t clamped{(lag < 0) ? 0 : lag};
+        const size_t bucket{std::min(static_cast<size_t>(clamped / BUCKET_WIDTH), BUCKETS - 1)};
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(clamped, std::memory_order_relaxed);
+        if (clamped > m_max.load(std::memory_order_relaxed))
+        {
+            m_max.store(clamped, std::memory_order_relaxed);
+        }
+        m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Upper bound of the bucket holding the given quantile [0 .. 1]; 0 before the first frame.
+    int64_t quantile(double q) const
+    {
+        const uint64_t count{m_count.load(std::memory_order_relaxed)};
+        const uint64_t rank{static_cast<uint64_t>(q * static_cast<double>(count))};
+        uint64_t seen{0};
+        for (size_t i = 0; (0 != count) && (i < BUCKETS); i++)
+        {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen > rank)
+            {
+                return std::min(static_cast<int64_t>(i + 1) * BUCKET_WIDTH, m_max.load(std::memory_order_relaxed));
+            }
+        }
+        return m_max.load(std::memory_order_relaxed);
+    }
+
+    std::string summary() const
+    {
+        const uint64_t count{m_count.load(std::memory_order_relaxed)};
+        const int64_t mean{(0 == count) ? 0 : m_sum.load(std::memory_order_relaxed) / static_cast<int64_t>(count)};
+        return "wakeLagMean=" + std::to_string(mean) + ";wakeLagP50=" + std::to_string(quantile(0.5)) + ";wakeLagP99=" + std::to_string(quantile(0.99)) +
+               ";wakeLagMax=" + std::to_string(m_max.load(std::memory_order_relaxed));
+    }
+
+  private:
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<int64_t> m_sum;
+    std::atomic<int64_t> m_max;
+};
+
+#endif
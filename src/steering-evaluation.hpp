@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STEERING_EVALUATION_HPP
+#define STEERING_EVALUATION_HPP
+
+#include "steering-features.hpp"
+#include "steering.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// A frame passes when the steering is within 25% of the recorded steering,
+// or within 0.05 when the recorded steering is 0.
+inline bool steeringPasses(double steering, double groundSteering)
+{
+    if (std::fabs(groundSteering) < 1e-9)
+    {
+        return std::fabs(steering) <= 0.05;
+    }
+    return std::fabs(steering - groundSteering) <= 0.25 * std::fabs(groundSteering);
+}
+
+struct SteeringScore
+{
+    size_t frames{0};
+    size_t passed{0};
+    double absoluteError{0.0};
+
+    void add(double steering, double groundSteering)
+    {
+        frames++;
+        passed += steeringPasses(steering, groundSteering) ? 1 : 0;
+        absoluteError += std::fabs(steering - groundSteering);
+    }
+
+    double passRate() const { return (0 == frames) ? 0.0 : static_cast<double>(passed) / static_cast<double>(frames); }
+    double meanAbsoluteError() const { return (0 == frames) ? 0.0 : absoluteError / static_cast<double>(frames); }
+
+    // More passed frames win; the smaller error breaks ties.
+    bool betterThan(const SteeringScore &other) const
+    {
+        return (passed != other.passed) ? (passed > other.passed) : (absoluteError < other.absoluteError);
+    }
+};
+
+// Frames of one or more recordings reduced to the inputs of calculateSteering,
+// one column per input. The direction estimate does not depend on the steering
+// parameters, so the cones are assigned to the sides once. Before the direction
+// is known, the steering stays at 0 whatever the parameters; these frames are
+// only scored once.
+struct SteeringColumns
+{
+    std::vector<double> rightIR{};
+    std::vector<double> leftIR{};
+    std::vector<int32_t> rightCones{};
+    std::vector<int32_t> leftCones{};
+    std::vector<double> groundSteering{};
+    // Steering a frame passes with and the allowed deviation from it (see steeringPasses).
+    std::vector<double> target{};
+    std::vector<double> tolerance{};
+    SteeringScore beforeDirection{};
+
+    size_t size() const { return rightIR.size(); }
+};
+
+// Replays the direction estimator over the frames of one recording.
+inline void appendSteeringColumns(const std::vector<FrameFeatures> &frames, SteeringColumns &columns)
+{
+    DirectionEstimator directionEstimator;
+    for (const FrameFeatures &f : frames)
+    {
+        directionEstimator.observe(f.sampleTimeStamp, f.largestBlueX, f.largestBlueWidth, f.largestYellowX, f.largestYellowWidth);
+        const CarDirection direction{directionEstimator.direction()};
+        if (CarDirection::Unknown == direction)
+        {
+            columns.beforeDirection.add(0.0, f.groundSteering);
+            continue;
+        }
+        const bool clockwise{CarDirection::Clockwise == direction};
+        const bool straight{std::fabs(f.groundSteering) < 1e-9};
+        columns.rightIR.push_back(f.rightIR);
+        columns.leftIR.push_back(f.leftIR);
+        columns.rightCones.push_back(clockwise ? f.yellowCones : f.blueCones);
+        columns.leftCones.push_back(clockwise ? f.blueCones : f.yellowCones);
+        columns.groundSteering.push_back(f.groundSteering);
+        columns.target.push_back(straight ? 0.0 : f.groundSteering);
+        columns.tolerance.push_back(straight ? 0.05 : 0.25 * std::fabs(f.groundSteering));
+    }
+}
+
+// Scores the parameters chunk by chunk, so that the steering column stays in the L1 cache.
+inline SteeringScore scoreSteering(const SteeringParameters &parameters, const SteeringColumns &columns)
+{
+    constexpr size_t CHUNK{1024};
+    double steering[CHUNK];
+    SteeringScore score{columns.beforeDirection};
+    for (size_t first = 0; first < columns.size(); first += CHUNK)
+    {
+        const size_t n{(columns.size() - first < CHUNK) ? columns.size() - first : CHUNK};
+        calculateSteeringBatch(parameters, &columns.rightIR[first], &columns.leftIR[first], &columns.rightCones[first], &columns.leftCones[first],
+                               steering, n);
+        size_t passed{0};
+        for (size_t i = 0; i < n; i++)
+        {
+            passed += (std::fabs(steering[i] - columns.target[first + i]) <= columns.tolerance[first + i]) ? 1 : 0;
+            score.absoluteError += std::fabs(steering[i] - columns.groundSteering[first + i]);
+        }
+        score.frames += n;
+        score.passed += passed;
+    }
+    return score;
+}
+
+// Scores every candidate on the given number of threads, which take the next
+// unscored candidate until none is left.
+inline std::vector<SteeringScore> scoreCandidates(const std::vector<SteeringParameters> &candidates, const SteeringColumns &columns, size_t threads)
+{
+    std::vector<SteeringScore> scores(candidates.size());
+    std::atomic<size_t> next{0};
+    auto work = [&candidates, &columns, &scores, &next]()
+    {
+        for (size_t i = next.fetch_add(1); i < candidates.size(); i = next.fetch_add(1))
+        {
+            scores[i] = scoreSteering(candidates[i], columns);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+    return scores;
+}
+
+#endif
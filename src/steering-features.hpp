@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STEERING_FEATURES_HPP
+#define STEERING_FEATURES_HPP
+
+#include "cone-detections.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Everything the steering decision of one frame depends on, together with the
+// steering recorded for it; segmenting a recording once yields these features,
+// which are then enough to evaluate any number of steering parameters.
+struct FrameFeatures
+{
+    int64_t sampleTimeStamp{0};
+    int32_t yellowCones{0};
+    int32_t blueCones{0};
+    int32_t largestYellowX{0};
+    int32_t largestYellowY{0};
+    int32_t largestYellowWidth{0};
+    int32_t largestYellowHeight{0};
+    int32_t largestBlueX{0};
+    int32_t largestBlueY{0};
+    int32_t largestBlueWidth{0};
+    int32_t largestBlueHeight{0};
+    double leftIR{0.0};
+    double rightIR{0.0};
+    double groundSteering{0.0};
+};
+
+inline FrameFeatures makeFrameFeatures(const ConeDetections &cones, double leftIR, double rightIR, double groundSteering)
+{
+    FrameFeatures features;
+    features.sampleTimeStamp = cones.sampleTimeStamp;
+    features.yellowCones = cones.amountOfYellowCones;
+    features.blueCones = cones.amountOfBlueCones;
+    features.largestYellowX = cones.largestYellow.x;
+    features.largestYellowY = cones.largestYellow.y;
+    features.largestYellowWidth = cones.largestYellow.width;
+    features.largestYellowHeight = cones.largestYellow.height;
+    features.largestBlueX = cones.largestBlue.x;
+    features.largestBlueY = cones.largestBlue.y;
+    features.largestBlueWidth = cones.largestBlue.width;
+    features.largestBlueHeight = cones.largestBlue.height;
+    features.leftIR = leftIR;
+    features.rightIR = rightIR;
+    features.groundSteering = groundSteering;
+    return features;
+}
+
+// Feature files are column oriented so that they can be mapped into memory
+// and evaluated without parsing:
+//
+//   file header   magic, version, number of columns
+//   column table  name, type and element size of every column
+//   blocks        block header (magic, frames) followed by each column's
+//                 values of these frames, every column padded to 8 bytes
+//
+// All values are stored in host byte order; a byte-swapped magic is reported
+// as such. Readers look columns up by name and ignore the ones they do not
+// know, so columns can be added without a new version. A block is written
+// once complete, so a run that ends abruptly loses at most its last block.
+namespace features
+{
+constexpr uint32_t FILE_MAGIC{0x54414546};  // "FEAT"
+constexpr uint32_t BLOCK_MAGIC{0x4B434C42}; // "BLCK"
+constexpr uint16_t VERSION{1};
+constexpr uint32_t FRAMES_PER_BLOCK{1024};
+constexpr size_t NAME_SIZE{24};
+
+enum class ColumnType : uint32_t
+{
+    Int32 = 1,
+    Int64 = 2,
+    Float64 = 3
+};
+
+struct FileHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t numberOfColumns;
+};
+
+struct ColumnDescription
+{
+    char name[NAME_SIZE];
+    ColumnType type;
+    uint32_t elementSize;
+};
+
+struct BlockHeader
+{
+    uint32_t magic;
+    uint32_t frames;
+};
+
+// The columns of version 1 and where they live in FrameFeatures.
+struct Column
+{
+    const char *name;
+    ColumnType type;
+    size_t offset;
+};
+
+constexpr Column COLUMNS[]{{"sampleTimeStamp", ColumnType::Int64, offsetof(FrameFeatures, sampleTimeStamp)},
+                           {"yellowCones", ColumnType::Int32, offsetof(FrameFeatures, yellowCones)},
+                           {"blueCones", ColumnType::Int32, offsetof(FrameFeatures, blueCones)},
+                           {"largestYellowX", ColumnType::Int32, offsetof(FrameFeatures, largestYellowX)},
+                           {"largestYellowY", ColumnType::Int32, offsetof(FrameFeatures, largestYellowY)},
+                           {"largestYellowWidth", ColumnType::Int32, offsetof(FrameFeatures, largestYellowWidth)},
+                           {"largestYellowHeight", ColumnType::Int32, offsetof(FrameFeatures, largestYellowHeight)},
+                           {"largestBlueX", ColumnType::Int32, offsetof(FrameFeatures, largestBlueX)},
+                           {"largestBlueY", ColumnType::Int32, offsetof(FrameFeatures, largestBlueY)},
+                           {"largestBlueWidth", ColumnType::Int32, offsetof(FrameFeatures, largestBlueWidth)},
+                           {"largestBlueHeight", ColumnType::Int32, offsetof(FrameFeatures, largestBlueHeight)},
+                           {"leftIR", ColumnType::Float64, offsetof(FrameFeatures, leftIR)},
+                           {"rightIR", ColumnType::Float64, offsetof(FrameFeatures, rightIR)},
+                           {"groundSteering", ColumnType::Float64, offsetof(FrameFeatures, groundSteering)}};
+constexpr size_t NUMBER_OF_COLUMNS{sizeof(COLUMNS) / sizeof(COLUMNS[0])};
+
+inline uint32_t elementSize(ColumnType type)
+{
+    return (ColumnType::Int32 == type) ? 4 : 8;
+}
+
+inline size_t padded(size_t bytes)
+{
+    return (bytes + 7) / 8 * 8;
+}
+} // namespace features
+
+// Appends frames to a feature file; complete blocks are written as they fill up
+// and the last one when the writer is closed or destroyed.
+class FeatureWriter
+{
+  private:
+    FeatureWriter(const FeatureWriter &) = delete;
+    FeatureWriter &operator=(const FeatureWriter &) = delete;
+
+  public:
+    FeatureWriter()
+        : m_file{}, m_frames{0}, m_columns(features::NUMBER_OF_COLUMNS)
+    {
+    }
+
+    ~FeatureWriter()
+    {
+        close();
+    }
+
+    bool open(const std::string &path)
+    {
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        const features::FileHeader header{features::FILE_MAGIC, features::VERSION, static_cast<uint16_t>(features::NUMBER_OF_COLUMNS)};
+        m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (size_t c = 0; c < features::NUMBER_OF_COLUMNS; c++)
+        {
+            features::ColumnDescription description{};
+            std::strncpy(description.name, features::COLUMNS[c].name, features::NAME_SIZE - 1);
+            description.type = features::COLUMNS[c].type;
+            description.elementSize = features::elementSize(description.type);
+            m_file.write(reinterpret_cast<const char *>(&description), sizeof(description));
+            m_columns[c].resize(features::padded(features::FRAMES_PER_BLOCK * description.elementSize));
+        }
+        return m_file.good();
+    }
+
+    bool isOpen() const { return m_file.is_open(); }
+
+    void append(const FrameFeatures &frame)
+    {
+        for (size_t c = 0; c < features::NUMBER_OF_COLUMNS; c++)
+        {
+            const uint32_t size{features::elementSize(features::COLUMNS[c].type)};
+            std::memcpy(m_columns[c].data() + m_frames * size, reinterpret_cast<const char *>(&frame) + features::COLUMNS[c].offset, size);
+        }
+        if (features::FRAMES_PER_BLOCK == ++m_frames)
+        {
+            writeBlock();
+        }
+    }
+
+    void close()
+    {
+        if (m_file.is_open())
+        {
+            writeBlock();
+            m_file.close();
+        }
+    }
+
+  private:
+    void writeBlock()
+    {
+        if (0 == m_frames)
+        {
+            return;
+        }
+        const features::BlockHeader header{features::BLOCK_MAGIC, m_frames};
+        m_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (size_t c = 0; c < features::NUMBER_OF_COLUMNS; c++)
+        {
+            const size_t bytes{features::padded(m_frames * features::elementSize(features::COLUMNS[c].type))};
+            std::memset(m_columns[c].data() + m_frames * features::elementSize(features::COLUMNS[c].type), 0,
+                        bytes - m_frames * features::elementSize(features::COLUMNS[c].type));
+            m_file.write(m_columns[c].data(), static_cast<std::streamsize>(bytes));
+        }
+        m_file.flush();
+        m_frames = 0;
+    }
+
+  private:
+    std::ofstream m_file;
+    uint32_t m_frames;
+    std::vector<std::vector<char>> m_columns;
+};
+
+// Read-only mapping of a feature file. Each block gives direct access to its
+// columns; columns that are not in the file are returned as nullptr.
+class FeatureFile
+{
+  private:
+    FeatureFile(const FeatureFile &) = delete;
+    FeatureFile &operator=(const FeatureFile &) = delete;
+
+  public:
+    struct Block
+    {
+        uint32_t frames;
+        // Start of every column of FrameFeatures in this block, in the order of features::COLUMNS.
+        const char *columns[features::NUMBER_OF_COLUMNS];
+
+        template <typename T>
+        const T *column(size_t c) const
+        {
+            return reinterpret_cast<const T *>(columns[c]);
+        }
+    };
+
+    FeatureFile()
+        : m_data{nullptr}, m_size{0}, m_blocks{}, m_frames{0}
+    {
+    }
+
+    ~FeatureFile()
+    {
+        if (nullptr != m_data)
+        {
+            ::munmap(m_data, m_size);
+        }
+    }
+
+    bool open(const std::string &path, std::string &error)
+    {
+        const int fd{::open(path.c_str(), O_RDONLY)};
+        if (0 > fd)
+        {
+            error = "cannot open '" + path + "'";
+            return false;
+        }
+        struct stat status;
+        if ((0 == ::fstat(fd, &status)) && (0 < status.st_size))
+        {
+            m_size = static_cast<size_t>(status.st_size);
+            void *data{::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0)};
+            m_data = (MAP_FAILED == data) ? nullptr : static_cast<char *>(data);
+        }
+        ::close(fd);
+        if (nullptr == m_data)
+        {
+            error = "cannot map '" + path + "'";
+            return false;
+        }
+        ::madvise(m_data, m_size, MADV_SEQUENTIAL);
+        if (!index(error))
+        {
+            error = path + ": " + error;
+            return false;
+        }
+        return true;
+    }
+
+    const std::vector<Block> &blocks() const { return m_blocks; }
+    size_t frames() const { return m_frames; }
+
+    // Gathers the columns of one frame; columns missing in the file keep their defaults.
+    FrameFeatures frame(const Block &block, uint32_t i) const
+    {
+        FrameFeatures frame;
+        for (size_t c = 0; c < features::NUMBER_OF_COLUMNS; c++)
+        {
+            if (nullptr != block.columns[c])
+            {
+                const uint32_t size{features::elementSize(features::COLUMNS[c].type)};
+                std::memcpy(reinterpret_cast<char *>(&frame) + features::COLUMNS[c].offset, block.columns[c] + i * size, size);
+            }
+        }
+        return frame;
+    }
+
+  private:
+    // Checks the header and finds the columns of every block.
+    bool index(std::string &error)
+    {
+        features::FileHeader header;
+        if (m_size < sizeof(header))
+        {
+            error = "not a feature file";
+            return false;
+        }
+        std::memcpy(&header, m_data, sizeof(header));
+        if (features::FILE_MAGIC != header.magic)
+        {
+            error = (__builtin_bswap32(features::FILE_MAGIC) == header.magic) ? "feature file of the other byte order" : "not a feature file";
+            return false;
+        }
+        if (0 == header.version)
+        {
+            error = "feature file without version";
+            return false;
+        }
+        if (features::VERSION < header.version)
+        {
+            error = "feature file version " + std::to_string(header.version) + " is newer than " + std::to_string(features::VERSION);
+            return false;
+        }
+
+        size_t offset{sizeof(header)};
+        if (m_size < offset + header.numberOfColumns * sizeof(features::ColumnDescription))
+        {
+            error = "truncated column table";
+            return false;
+        }
+        // Where each column of the file goes in FrameFeatures; the unknown ones are skipped.
+        std::vector<size_t> sizes(header.numberOfColumns);
+        std::vector<size_t> known(header.numberOfColumns, features::NUMBER_OF_COLUMNS);
+        for (size_t i = 0; i < header.numberOfColumns; i++, offset += sizeof(features::ColumnDescription))
+        {
+            features::ColumnDescription description;
+            std::memcpy(&description, m_data + offset, sizeof(description));
+            description.name[features::NAME_SIZE - 1] = '\0';
+            sizes[i] = description.elementSize;
+            for (size_t c = 0; c < features::NUMBER_OF_COLUMNS; c++)
+            {
+                if ((0 == std::strcmp(description.name, features::COLUMNS[c].name)) && (features::COLUMNS[c].type == description.type))
+                {
+                    known[i] = c;
+                }
+            }
+            // The values of known columns are read with the size of their type.
+            if ((features::NUMBER_OF_COLUMNS != known[i]) && (features::elementSize(description.type) != description.elementSize))
+            {
+                error = "column '" + std::string{description.name} + "' has elements of " + std::to_string(description.elementSize) + " bytes instead of " +
+                        std::to_string(features::elementSize(description.type));
+                return false;
+            }
+        }
+
+        while (offset + sizeof(features::BlockHeader) <= m_size)
+        {
+            features::BlockHeader blockHeader;
+            std::memcpy(&blockHeader, m_data + offset, sizeof(blockHeader));
+            if (features::BLOCK_MAGIC != blockHeader.magic)
+            {
+                error = "corrupt block at byte " + std::to_string(offset);
+                return false;
+            }
+            Block block{blockHeader.frames, {}};
+            size_t next{offset + sizeof(blockHeader)};
+            for (size_t i = 0; (i < header.numberOfColumns) && (next <= m_size); i++)
+            {
+                if (features::NUMBER_OF_COLUMNS != known[i])
+                {
+                    block.columns[known[i]] = m_data + next;
+                }
+                next += features::padded(blockHeader.frames * sizes[i]);
+            }
+            if (next > m_size)
+            {
+                // The last block of a run that ended while writing it.
+                break;
+            }
+            m_blocks.push_back(block);
+            m_frames += block.frames;
+            offset = next;
+        }
+        return true;
+    }
+
+  private:
+    char *m_data;
+    size_t m_size;
+    std::vector<Block> m_blocks;
+    size_t m_frames;
+};
+
+// Reads all frames of a feature file.
+inline bool readFrameFeatures(const std::string &path, std::vector<FrameFeatures> &frames, std::string &error)
+{
+    FeatureFile file;
+    if (!file.open(path, error))
+    {
+        return false;
+    }
+    frames.reserve(frames.size() + file.frames());
+    for (const FeatureFile::Block &block : file.blocks())
+    {
+        for (uint32_t i = 0; i < block.frames; i++)
+        {
+            frames.push_back(file.frame(block, i));
+        }
+    }
+    return true;
+}
+
+#endif
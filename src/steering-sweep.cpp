@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the command line handling
+#include "cluon-complete.hpp"
+// Include the cached frame features and the scoring of steering parameters against them
+#include "steering-evaluation.hpp"
+#include "steering-features.hpp"
+#include "steering.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Values of one swept parameter from "min:max:step".
+struct SweepRange
+{
+    double minimum;
+    double maximum;
+    double step;
+
+    std::vector<double> values() const
+    {
+        std::vector<double> result;
+        for (double value = minimum; value <= maximum + step * 1e-6; value += step)
+        {
+            result.push_back(value);
+        }
+        return result;
+    }
+};
+
+bool parseSweepRange(const std::string &text, SweepRange &range)
+{
+    const std::vector<std::string> fields{splitList(text, ':')};
+    double values[3]{0.0, 0.0, 1.0};
+    if (((1 != fields.size()) && (3 != fields.size())) || !parseDouble(fields[0], values[0]))
+    {
+        return false;
+    }
+    values[1] = values[0];
+    if ((3 == fields.size()) && (!parseDouble(fields[1], values[1]) || !parseDouble(fields[2], values[2])))
+    {
+        return false;
+    }
+    if ((values[0] > values[1]) || (values[2] <= 0.0))
+    {
+        return false;
+    }
+    range = SweepRange{values[0], values[1], values[2]};
+    return true;
+}
+
+// The parameters calculateSteering depends on; segmentation parameters cannot be swept over cached features.
+struct SweepParameter
+{
+    const char *key;
+    double SteeringParameters::*member;
+    SweepRange range;
+};
+
+struct Candidate
+{
+    SteeringParameters parameters;
+    SteeringScore score;
+};
+
+void scoreInto(const std::vector<SteeringParameters> &batch, const SteeringColumns &columns, size_t threads, std::vector<Candidate> &evaluated)
+{
+    const std::vector<SteeringScore> scores{scoreCandidates(batch, columns, threads)};
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        evaluated.push_back(Candidate{batch[i], scores[i]});
+    }
+}
+
+void sweepGrid(const SteeringParameters &base, const std::vector<SweepParameter> &swept, const SteeringColumns &columns, size_t threads,
+               std::vector<Candidate> &evaluated)
+{
+    std::vector<SteeringParameters> batch{base};
+    for (const SweepParameter &p : swept)
+    {
+        std::vector<SteeringParameters> expanded;
+        for (const SteeringParameters &partial : batch)
+        {
+            for (double value : p.range.values())
+            {
+                expanded.push_back(partial);
+                expanded.back().*p.member = value;
+            }
+        }
+        batch.swap(expanded);
+    }
+    scoreInto(batch, columns, threads, evaluated);
+}
+
+void sweepRandom(const SteeringParameters &base, const std::vector<SweepParameter> &swept, const SteeringColumns &columns, size_t threads,
+                 size_t numberOfSamples, uint32_t seed, std::vector<Candidate> &evaluated)
+{
+    std::mt19937 generator{seed};
+    std::vector<SteeringParameters> batch(numberOfSamples, base);
+    for (SteeringParameters &candidate : batch)
+    {
+        for (const SweepParameter &p : swept)
+        {
+            candidate.*p.member = std::uniform_real_distribution<double>{p.range.minimum, p.range.maximum}(generator);
+        }
+    }
+    scoreInto(batch, columns, threads, evaluated);
+}
+
+// Coordinate descent: moves one parameter at a time to its best value in the
+// range until a whole round brings no improvement.
+void sweepDescent(const SteeringParameters &base, const std::vector<SweepParameter> &swept, const SteeringColumns &columns, size_t threads,
+                  size_t rounds, std::vector<Candidate> &evaluated)
+{
+    Candidate best{base, scoreSteering(base, columns)};
+    evaluated.push_back(best);
+    bool improved{true};
+    for (size_t round = 0; improved && (round < rounds); round++)
+    {
+        improved = false;
+        for (const SweepParameter &p : swept)
+        {
+            std::vector<SteeringParameters> batch;
+            for (double value : p.range.values())
+            {
+                batch.push_back(best.parameters);
+                batch.back().*p.member = value;
+            }
+            const size_t first{evaluated.size()};
+            scoreInto(batch, columns, threads, evaluated);
+            for (size_t i = first; i < evaluated.size(); i++)
+            {
+                if (evaluated[i].score.betterThan(best.score))
+                {
+                    best = evaluated[i];
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+int32_t main(int32_t argc, char **argv)
+{
+    int32_t retCode{1};
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 == commandlineArguments.count("features"))
+    {
+        std::cerr << argv[0] << " scores steering parameters against the steering recorded in feature files." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " --features=<file>[,<file>...] [--search=grid|random|descent] [--threads=<n>] [--top=<n>]" << std::endl;
+        std::cerr << "         --features:   feature files written by template-opencv --features=<file> while replaying a recording" << std::endl;
+        std::cerr << "         --search:     grid (default) tries every combination of the ranges, random draws --samples" << std::endl;
+        std::cerr << "                       uniform parameter sets, descent optimises one parameter at a time for up to --rounds" << std::endl;
+        std::cerr << "         --parameters: parameter file with the values not swept and the start of the descent" << std::endl;
+        std::cerr << "         --incrementSteering, --infraredThreshold, --fallbackSteering: range as min:max:step or a fixed value" << std::endl;
+        std::cerr << "         --threads:    number of threads scoring parameter sets, 1 to 1024 (default: all cores)" << std::endl;
+        std::cerr << "         --top:        number of best parameter sets printed as parameter files, 1 to 1000 (default: 5)" << std::endl;
+        std::cerr << "         --samples:    parameter sets of the random search, 1 to 10000000 (default: 10000), drawn with --seed (default: 1)" << std::endl;
+        std::cerr << "         --rounds:     rounds of the descent, 1 to 10000 (default: 10)" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --features=lap1.features,lap2.features --search=descent --top=1 > steering.parameters" << std::endl;
+        return retCode;
+    }
+
+    const std::string SEARCH{(commandlineArguments.count("search") != 0) ? commandlineArguments["search"] : "grid"};
+    // Counts are bounded, so that a typo cannot start millions of threads or fill the memory with candidates.
+    struct CountArgument
+    {
+        const char *key;
+        uint64_t minimum;
+        uint64_t maximum;
+        uint64_t *value;
+    };
+    uint64_t threads{std::max(1u, std::thread::hardware_concurrency())};
+    uint64_t top{5};
+    uint64_t samples{10000};
+    uint64_t rounds{10};
+    uint64_t seed{1};
+    for (const CountArgument &c : {CountArgument{"threads", 1, 1024, &threads}, CountArgument{"top", 1, 1000, &top}, CountArgument{"samples", 1, 10000000, &samples},
+                                   CountArgument{"rounds", 1, 10000, &rounds}, CountArgument{"seed", 0, UINT32_MAX, &seed}})
+    {
+        if ((commandlineArguments.count(c.key) != 0) && !parseCount(commandlineArguments[c.key], c.minimum, c.maximum, *c.value))
+        {
+            std::cerr << argv[0] << ": Invalid value '" << commandlineArguments[c.key] << "' for " << c.key << ", expected " << c.minimum << " to "
+                      << c.maximum << "." << std::endl;
+            return retCode;
+        }
+    }
+    const size_t THREADS{static_cast<size_t>(threads)};
+    const size_t TOP{static_cast<size_t>(top)};
+    const size_t SAMPLES{static_cast<size_t>(samples)};
+    const size_t ROUNDS{static_cast<size_t>(rounds)};
+    const uint32_t SEED{static_cast<uint32_t>(seed)};
+
+    SteeringParameters base;
+    std::string error;
+    if ((commandlineArguments.count("parameters") != 0) && !loadSteeringParameters(commandlineArguments["parameters"], base, error))
+    {
+        std::cerr << argv[0] << ": " << error << std::endl;
+        return retCode;
+    }
+
+    std::vector<SweepParameter> swept{{"incrementSteering", &SteeringParameters::incrementSteering, SweepRange{0.0, 0.2, 0.005}},
+                                      {"infraredThreshold", &SteeringParameters::infraredThreshold, SweepRange{0.0, 0.05, 0.001}},
+                                      {"fallbackSteering", &SteeringParameters::fallbackSteering, SweepRange{0.0, 0.3, 0.01}}};
+    for (SweepParameter &p : swept)
+    {
+        if ((commandlineArguments.count(p.key) != 0) && !parseSweepRange(commandlineArguments[p.key], p.range))
+        {
+            std::cerr << argv[0] << ": Invalid range '" << commandlineArguments[p.key] << "' for " << p.key << "." << std::endl;
+            return retCode;
+        }
+    }
+
+    // Every recording gets its own direction estimate.
+    SteeringColumns columns;
+    for (const std::string &path : splitList(commandlineArguments["features"], ','))
+    {
+        std::vector<FrameFeatures> frames;
+        if (!readFrameFeatures(path, frames, error))
+        {
+            std::cerr << argv[0] << ": " << error << std::endl;
+            return retCode;
+        }
+        appendSteeringColumns(frames, columns);
+    }
+    std::clog << argv[0] << ": Loaded " << columns.size() + columns.beforeDirection.frames << " frames." << std::endl;
+
+    std::vector<Candidate> evaluated;
+    const auto start{std::chrono::steady_clock::now()};
+    if ("grid" == SEARCH)
+    {
+        sweepGrid(base, swept, columns, THREADS, evaluated);
+    }
+    else if ("random" == SEARCH)
+    {
+        sweepRandom(base, swept, columns, THREADS, SAMPLES, SEED, evaluated);
+    }
+    else if ("descent" == SEARCH)
+    {
+        sweepDescent(base, swept, columns, THREADS, ROUNDS, evaluated);
+    }
+    else
+    {
+        std::cerr << argv[0] << ": Unknown search '" << SEARCH << "'." << std::endl;
+        return retCode;
+    }
+    const auto elapsed{std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)};
+    std::clog << argv[0] << ": Scored " << evaluated.size() << " parameter sets on " << THREADS << " threads in " << elapsed.count() << " ms." << std::endl;
+
+    const size_t shown{std::min(TOP, evaluated.size())};
+    std::partial_sort(evaluated.begin(), evaluated.begin() + static_cast<std::ptrdiff_t>(shown), evaluated.end(),
+                      [](const Candidate &a, const Candidate &b) { return a.score.betterThan(b.score); });
+    const SteeringScore reference{scoreSteering(base, columns)};
+    std::cout << "# start: " << reference.passed << "/" << reference.frames << " frames passed, mean absolute error " << reference.meanAbsoluteError()
+              << std::endl;
+    for (size_t i = 0; i < shown; i++)
+    {
+        const Candidate &c = evaluated[i];
+        std::cout << "# " << (i + 1) << ": " << c.score.passed << "/" << c.score.frames << " frames passed (" << 100.0 * c.score.passRate()
+                  << "%), mean absolute error " << c.score.meanAbsoluteError() << std::endl;
+        std::cout << formatSteeringParameters(c.parameters) << std::flush;
+    }
+    retCode = 0;
+    return retCode;
+}
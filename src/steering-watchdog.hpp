@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STEERING_WATCHDOG_HPP
+#define STEERING_WATCHDOG_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// What is emitted when the steering of a frame is not ready by its deadline.
+enum class WatchdogMode
+{
+    // No deadline: the steering is emitted when the frame is done.
+    Off,
+    // Repeat the last steering.
+    Hold,
+    // Continue the last change of the steering for at most as long as it took.
+    Extrapolate
+};
+
+inline bool parseWatchdogMode(const std::string &name, WatchdogMode &mode)
+{
+    if ("off" == name)
+    {
+        mode = WatchdogMode::Off;
+    }
+    else if ("hold" == name)
+    {
+        mode = WatchdogMode::Hold;
+    }
+    else if ("extrapolate" == name)
+    {
+        mode = WatchdogMode::Extrapolate;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Keeps the steering output at the frame cadence when a frame overruns: the
+// steering of a frame is due 1.5 frame periods after the previous output (the
+// gap FrameStatistics counts as a dropped frame); once overrunning, a
+// predicted value is due every period. After MAX_PREDICTIONS predictions in a
+// row the camera is taken to have stopped and nothing is due until a frame is
+// done again. A frame finishing after a prediction stood in for it only
+// updates the state, so that every sample time is emitted once.
+class SteeringWatchdog
+{
+  public:
+    static constexpr uint32_t MAX_PREDICTIONS{3};
+
+    explicit SteeringWatchdog(WatchdogMode mode)
+        : m_mode{mode}, m_lastEmitted{}, m_predictions{0}, m_overruns{0}, m_previousSampleTimeStamp{0}, m_previousSteering{0.0},
+          m_lastSampleTimeStamp{0}, m_lastSteering{0.0}, m_lastOutput{0}, m_lastPrediction{0}
+    {
+    }
+
+    // Records the steering computed for a frame; returns false if a prediction was
+    // already emitted for the frame (less than half a period before its sample time).
+    bool frameDone(int64_t sampleTimeStamp, double steering, int64_t period, std::chrono::steady_clock::time_point now)
+    {
+        // Time going backwards means a new recording: its frames are never stood in for.
+        const bool predicted{(0 != m_lastPrediction) && (sampleTimeStamp >= m_lastSampleTimeStamp) && (2 * sampleTimeStamp < 2 * m_lastPrediction + period)};
+        m_previousSampleTimeStamp = m_lastSampleTimeStamp;
+        m_previousSteering = m_lastSteering;
+        m_lastSampleTimeStamp = sampleTimeStamp;
+        m_lastSteering = steering;
+        m_lastEmitted = now;
+        m_predictions = 0;
+        if (!predicted)
+        {
+            m_lastOutput = sampleTimeStamp;
+            m_lastPrediction = 0;
+        }
+        return !predicted;
+    }
+
+    // When the next steering is due for the given frame period in microseconds; never
+    // when disabled, before the first frame and the period are known or after giving up.
+    std::chrono::steady_clock::time_point deadline(int64_t period) const
+    {
+        if ((WatchdogMode::Off == m_mode) || (0 >= period) || (0 == m_lastSampleTimeStamp) || gaveUp())
+        {
+            return std::chrono::steady_clock::time_point::max();
+        }
+        return m_lastEmitted + std::chrono::microseconds((0 < m_predictions) ? period : period + period / 2);
+    }
+
+    // Steering to emit in place of the overrunning frame, which is expected one period
+    // after the previous output; sampleTimeStamp receives that expected sample time.
+    double predict(int64_t period, std::chrono::steady_clock::time_point now, int64_t &sampleTimeStamp)
+    {
+        m_lastOutput += period;
+        m_lastPrediction = m_lastOutput;
+        m_lastEmitted = now;
+        m_predictions++;
+        m_overruns++;
+        sampleTimeStamp = m_lastOutput;
+
+        const int64_t step{m_lastSampleTimeStamp - m_previousSampleTimeStamp};
+        if ((WatchdogMode::Extrapolate != m_mode) || (0 == m_previousSampleTimeStamp) || (0 >= step))
+        {
+            return m_lastSteering;
+        }
+        const int64_t horizon{(m_lastOutput - m_lastSampleTimeStamp < step) ? m_lastOutput - m_lastSampleTimeStamp : step};
+        return m_lastSteering + (m_lastSteering - m_previousSteering) * static_cast<double>(horizon) / static_cast<double>(step);
+    }
+
+    // True once MAX_PREDICTIONS were emitted in a row; a finished frame starts over.
+    bool gaveUp() const { return m_predictions >= MAX_PREDICTIONS; }
+
+    uint64_t overruns() const { return m_overruns; }
+
+  private:
+    const WatchdogMode m_mode;
+    std::chrono::steady_clock::time_point m_lastEmitted;
+    uint32_t m_predictions;
+    uint64_t m_overruns;
+    // The last two frames done and the sample times of the last output and of the last prediction not yet caught up with.
+    int64_t m_previousSampleTimeStamp;
+    double m_previousSteering;
+    int64_t m_lastSampleTimeStamp;
+    double m_lastSteering;
+    int64_t m_lastOutput;
+    int64_t m_lastPrediction;
+};
+
+#endif
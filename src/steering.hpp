@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STEERING_HPP
+#define STEERING_HPP
+
+#include "cluon-complete.hpp"
+#include "cone-detections.hpp"
+#include "cone-segmentation.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Everything the steering decision can be tuned with; the defaults are the
+// values the algorithm was developed with.
+struct SteeringParameters
+{
+    // Steering added per side whose infrared sensor sees a wall closer than infraredThreshold (in V).
+    double incrementSteering{0.045};
+    double infraredThreshold{0.007};
+    // Steering when no cones are seen on one side.
+    double fallbackSteering{0.15};
+    int32_t minBlobArea{MIN_BLOB_AREA};
+    int32_t minConeArea{MIN_CONE_AREA};
+    ThresholdTable thresholds{DEFAULT_THRESHOLDS};
+};
+
+inline double calculateSteering(const SteeringParameters &parameters, double rightIR, double leftIR, int rightCones, int leftCones)
+{
+    double steering = 0;
+
+    if (rightIR <= parameters.infraredThreshold)
+    {
+        steering = steering + parameters.incrementSteering;
+    }
+    if (leftIR <= parameters.infraredThreshold)
+    {
+        steering = steering - parameters.incrementSteering;
+    }
+
+    if (rightCones == 0)
+    {
+        steering = -parameters.fallbackSteering;
+    }
+    if (leftCones == 0)
+    {
+        steering = parameters.fallbackSteering;
+    }
+    return steering;
+}
+
+// calculateSteering for n frames given as columns. It selects instead of
+// branching and returns exactly what the scalar version returns for every
+// frame. GCC only vectorises the loop with -fno-trapping-math, as the compare
+// of doubles may raise floating-point exceptions.
+inline void calculateSteeringBatch(const SteeringParameters &parameters, const double *rightIR, const double *leftIR, const int32_t *rightCones,
+                                   const int32_t *leftCones, double *steering, size_t n)
+{
+    const double increment{parameters.incrementSteering};
+    const double threshold{parameters.infraredThreshold};
+    const double fallback{parameters.fallbackSteering};
+    for (size_t i = 0; i < n; i++)
+    {
+        double s = ((rightIR[i] <= threshold) ? increment : 0.0) - ((leftIR[i] <= threshold) ? increment : 0.0);
+        s = (0 == rightCones[i]) ? -fallback : s;
+        s = (0 == leftCones[i]) ? fallback : s;
+        steering[i] = s;
+    }
+}
+
+enum class CarDirection
+{
+    Unknown,
+    Clockwise,
+    CounterClockwise
+};
+
+enum class DirectionState
+{
+    // No direction yet: testing the evidence of the frames.
+    Searching,
+    // Direction decided; frames are watched for evidence of the opposite direction.
+    Locked,
+    // The locked direction was contradicted and is tested again; it stays in use until the test decides.
+    Revalidating
+};
+
+// Estimates the driving direction from the largest boxes of both colours:
+// blue cones left of the yellow ones are evidence for clockwise. Each frame
+// showing both adds its log-likelihood ratio to a sequential probability ratio
+// test, which locks in as soon as the error rate allows (four consistent frames
+// with the defaults). Once locked, a CUSUM of the evidence against the locked
+// direction detects a change of the lap direction. Time going backwards means
+// a new recording or a restarted replay and starts the search from scratch.
+class DirectionEstimator
+{
+  public:
+    // Probability that a single frame points in the true direction.
+    static constexpr double FRAME_RELIABILITY{0.8};
+    // Probability of locking in the wrong direction.
+    static constexpr double ERROR_RATE{0.01};
+
+    DirectionEstimator()
+        : m_step{std::log(FRAME_RELIABILITY / (1.0 - FRAME_RELIABILITY))}, m_decision{std::log((1.0 - ERROR_RATE) / ERROR_RATE)},
+          m_state{DirectionState::Searching}, m_direction{CarDirection::Unknown}, m_logLikelihoodRatio{0.0}, m_cusum{0.0}, m_lastTimeStamp{0}
+    {
+    }
+
+    void observe(int64_t sampleTimeStamp, int32_t blueX, int32_t blueWidth, int32_t yellowX, int32_t yellowWidth)
+    {
+        if (sampleTimeStamp < m_lastTimeStamp)
+        {
+            reset();
+        }
+        m_lastTimeStamp = sampleTimeStamp;
+
+        // Compare the centres (doubled to stay integer) of the boxes of both colours.
+        const int32_t blueCentre{2 * blueX + blueWidth};
+        const int32_t yellowCentre{2 * yellowX + yellowWidth};
+        if ((0 >= blueWidth) || (0 >= yellowWidth) || (blueCentre == yellowCentre))
+        {
+            return;
+        }
+        const double clockwiseEvidence{(blueCentre < yellowCentre) ? m_step : -m_step};
+
+        if (DirectionState::Locked == m_state)
+        {
+            const double against{(CarDirection::Clockwise == m_direction) ? -clockwiseEvidence : clockwiseEvidence};
+            m_cusum = (m_cusum + against > 0.0) ? m_cusum + against : 0.0;
+            if (m_cusum >= 2.0 * m_decision)
+            {
+                m_state = DirectionState::Revalidating;
+                m_logLikelihoodRatio = 0.0;
+            }
+            return;
+        }
+
+        m_logLikelihoodRatio += clockwiseEvidence;
+        if (m_logLikelihoodRatio >= m_decision)
+        {
+            lock(CarDirection::Clockwise);
+        }
+        else if (m_logLikelihoodRatio <= -m_decision)
+        {
+            lock(CarDirection::CounterClockwise);
+        }
+    }
+
+    void reset()
+    {
+        m_state = DirectionState::Searching;
+        m_direction = CarDirection::Unknown;
+        m_logLikelihoodRatio = 0.0;
+        m_cusum = 0.0;
+    }
+
+    CarDirection direction() const { return m_direction; }
+    DirectionState state() const { return m_state; }
+
+  private:
+    void lock(CarDirection direction)
+    {
+        m_state = DirectionState::Locked;
+        m_direction = direction;
+        m_cusum = 0.0;
+    }
+
+  private:
+    const double m_step;
+    const double m_decision;
+    DirectionState m_state;
+    CarDirection m_direction;
+    double m_logLikelihoodRatio;
+    double m_cusum;
+    int64_t m_lastTimeStamp;
+};
+
+inline const char *carDirectionName(CarDirection direction)
+{
+    switch (direction)
+    {
+    case CarDirection::Clockwise:
+        return "clockwise";
+    case CarDirection::CounterClockwise:
+        return "counter-clockwise";
+    default:
+        return "unknown";
+    }
+}
+
+// Steering for the given direction: yellow cones are on the right when driving
+// clockwise. Without a direction, the previous steering is kept.
+inline double steerInDirection(const SteeringParameters &parameters, CarDirection direction, double rightIR, double leftIR, int yellowCones, int blueCones,
+                               double previousSteering)
+{
+    if (CarDirection::Clockwise == direction)
+    {
+        return calculateSteering(parameters, rightIR, leftIR, yellowCones, blueCones);
+    }
+    if (CarDirection::CounterClockwise == direction)
+    {
+        return calculateSteering(parameters, rightIR, leftIR, blueCones, yellowCones);
+    }
+    return previousSteering;
+}
+
+// Splits a list like "a,b,c"; unlike stringtoolbox::split, a single entry without separator is kept.
+inline std::vector<std::string> splitList(const std::string &text, char separator)
+{
+    std::vector<std::string> entries;
+    std::istringstream list(text);
+    std::string entry;
+    while (std::getline(list, entry, separator))
+    {
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+// Parses a whole string as int; unlike std::stoi, trailing characters are rejected.
+inline bool parseInt(const std::string &text, int &value)
+{
+    try
+    {
+        size_t pos{0};
+        const int parsed{std::stoi(text, &pos)};
+        if (pos != text.size())
+        {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+// Parses a whole string as finite double; unlike std::stod, trailing characters, inf and nan are rejected.
+inline bool parseDouble(const std::string &text, double &value)
+{
+    try
+    {
+        size_t pos{0};
+        const double parsed{std::stod(text, &pos)};
+        if ((pos != text.size()) || !std::isfinite(parsed))
+        {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+// Parses an area in pixels, which must not be negative.
+inline bool parseArea(const std::string &text, int32_t &area)
+{
+    int parsed{0};
+    if (!parseInt(text, parsed) || (parsed < 0))
+    {
+        return false;
+    }
+    area = parsed;
+    return true;
+}
+
+// Parses a count given as decimal digits only, from minimum to maximum; unlike
+// std::stoul, a sign, blanks and trailing characters are rejected, so that
+// "-1" cannot wrap around to a huge count.
+inline bool parseCount(const std::string &text, uint64_t minimum, uint64_t maximum, uint64_t &count)
+{
+    if (text.empty() || (std::string::npos != text.find_first_not_of("0123456789")) || (text.size() > 18))
+    {
+        return false;
+    }
+    const uint64_t parsed{static_cast<uint64_t>(std::stoull(text))};
+    if ((minimum > parsed) || (maximum < parsed))
+    {
+        return false;
+    }
+    count = parsed;
+    return true;
+}
+
+// Parses "hLow,sLow,vLow,hHigh,sHigh,vHigh"; the range is only changed when all six bounds are valid.
+inline bool parseHsvRange(const std::string &value, HsvRange &range)
+{
+    const std::vector<std::string> fields{splitList(value, ',')};
+    // splitList drops an empty last field.
+    if ((6 != fields.size()) || (',' == value.back()))
+    {
+        return false;
+    }
+    HsvRange parsed{range};
+    uint8_t *bounds[6]{&parsed.hLow, &parsed.sLow, &parsed.vLow, &parsed.hHigh, &parsed.sHigh, &parsed.vHigh};
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        int bound{0};
+        if (!parseInt(fields[i], bound) || (bound < 0) || (bound > 255))
+        {
+            return false;
+        }
+        *bounds[i] = static_cast<uint8_t>(bound);
+    }
+    range = parsed;
+    return true;
+}
+
+// Sets one parameter; returns false for unknown keys and malformed values,
+// which leave the parameter unchanged.
+inline bool setSteeringParameter(SteeringParameters &parameters, const std::string &key, const std::string &value)
+{
+    if ("incrementSteering" == key)
+    {
+        return parseDouble(value, parameters.incrementSteering);
+    }
+    else if ("infraredThreshold" == key)
+    {
+        return parseDouble(value, parameters.infraredThreshold);
+    }
+    else if ("fallbackSteering" == key)
+    {
+        return parseDouble(value, parameters.fallbackSteering);
+    }
+    else if ("minBlobArea" == key)
+    {
+        return parseArea(value, parameters.minBlobArea);
+    }
+    else if ("minConeArea" == key)
+    {
+        return parseArea(value, parameters.minConeArea);
+    }
+    else if ("yellow" == key)
+    {
+        return parseHsvRange(value, parameters.thresholds.yellow);
+    }
+    else if ("yellowLow" == key)
+    {
+        return parseHsvRange(value, parameters.thresholds.yellowLow);
+    }
+    else if ("blue" == key)
+    {
+        return parseHsvRange(value, parameters.thresholds.blue);
+    }
+    return false;
+}
+
+// Applies "key=value" entries separated by separator; empty entries and those
+// starting with '#' are skipped. On failure, error names the offending entry.
+inline bool parseSteeringParameters(const std::string &text, char separator, SteeringParameters &parameters, std::string &error)
+{
+    std::istringstream entries(text);
+    std::string entry;
+    while (std::getline(entries, entry, separator))
+    {
+        stringtoolbox::trim(entry);
+        if (entry.empty() || ('#' == entry[0]))
+        {
+            continue;
+        }
+        const size_t equals{entry.find('=')};
+        std::string key{entry.substr(0, equals)};
+        std::string value{(std::string::npos == equals) ? std::string{} : entry.substr(equals + 1)};
+        if ((std::string::npos == equals) || !setSteeringParameter(parameters, stringtoolbox::trim(key), stringtoolbox::trim(value)))
+        {
+            error = "invalid entry '" + entry + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads a parameter file with one "key=value" per line on top of the defaults.
+inline bool loadSteeringParameters(const std::string &path, SteeringParameters &parameters, std::string &error)
+{
+    std::ifstream file(path);
+    if (!file.good())
+    {
+        error = "cannot open '" + path + "'";
+        return false;
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    SteeringParameters loaded;
+    if (!parseSteeringParameters(content.str(), '\n', loaded, error))
+    {
+        return false;
+    }
+    parameters = loaded;
+    return true;
+}
+
+// Formats a range the way parseHsvRange reads it.
+inline std::string formatHsvRange(const HsvRange &range)
+{
+    return std::to_string(range.hLow) + "," + std::to_string(range.sLow) + "," + std::to_string(range.vLow) + "," + std::to_string(range.hHigh) + "," +
+           std::to_string(range.sHigh) + "," + std::to_string(range.vHigh);
+}
+
+// Shortest decimal that std::stod reads back as the same value, e.g. "0.045" rather than "0.044999999999999998".
+inline std::string formatDouble(double value)
+{
+    std::ostringstream text;
+    for (int precision = std::numeric_limits<double>::digits10; precision <= std::numeric_limits<double>::max_digits10; precision++)
+    {
+        text.str(std::string{});
+        text.precision(precision);
+        text << value;
+        const double parsed{std::stod(text.str())};
+        if ((parsed <= value) && (parsed >= value))
+        {
+            break;
+        }
+    }
+    return text.str();
+}
+
+// Writes every parameter as "key=value" line, so that loadSteeringParameters
+// reads back exactly the same values.
+inline std::string formatSteeringParameters(const SteeringParameters &parameters)
+{
+    std::ostringstream text;
+    text << "incrementSteering=" << formatDouble(parameters.incrementSteering) << '\n';
+    text << "infraredThreshold=" << formatDouble(parameters.infraredThreshold) << '\n';
+    text << "fallbackSteering=" << formatDouble(parameters.fallbackSteering) << '\n';
+    text << "minBlobArea=" << parameters.minBlobArea << '\n';
+    text << "minConeArea=" << parameters.minConeArea << '\n';
+    text << "yellow=" << formatHsvRange(parameters.thresholds.yellow) << '\n';
+    text << "yellowLow=" << formatHsvRange(parameters.thresholds.yellowLow) << '\n';
+    text << "blue=" << formatHsvRange(parameters.thresholds.blue) << '\n';
+    return text.str();
+}
+
+#endif
@@ -19,89 +19,552 @@
 #include "cluon-complete.hpp"
 // Include the OpenDLV Standard Message Set that contains messages that are usually exchanged for automotive or robotic applications
 #include "opendlv-standard-message-set.hpp"
+// Include the cone segmentation kernels that replace cvtColor + inRange
+#include "cone-segmentation.hpp"
+// Include the per-camera frame context and the fusion of the detections of all cameras
+#include "frame-context.hpp"
+#include "detection-fusion.hpp"
+// Include the CPU pinning, SCHED_FIFO and memory locking of the real-time mode
+#include "realtime.hpp"
+// Include the steering decision and its parameters, which can be replaced while running
+#include "rcu-value.hpp"
+#include "steering.hpp"
+// Include the per-frame features recorded for tuning the steering offline
+#include "steering-evaluation.hpp"
+#include "steering-features.hpp"
+// Include the watchdog keeping the steering output at the frame cadence
+#include "steering-watchdog.hpp"
 
 // Include the GUI and image processing header files from OpenCV
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <sys/stat.h>
+
+#include <atomic>
 #include <ctime>
 #include <iostream>
 #include <fstream>
+#include <thread>
+
+using Parameters = RcuValue<SteeringParameters>;
+
+// Pixel format of the frames in the shared memory as FourCC (cf. cluon::SharedMemory::getFormat()).
+constexpr uint32_t FOURCC_BGRA{'B' | ('G' << 8) | ('R' << 16) | (static_cast<uint32_t>('A') << 24)};
+
+// Segments the frame at pixels and hands the cone detections to the fusion stage;
+// in verbose mode, pixels must point to ctx.img, which is annotated for display.
+void detectCones(FrameContext &ctx, DetectionFusion &fusion, const SteeringParameters &parameters, const uint8_t *pixels, int64_t tStamp, uint32_t rowStep, bool verbose)
+{
+    // New colour thresholds need another kernel; the specialised ones only know the defaults.
+    if (!(parameters.thresholds == ctx.segmenter.thresholds()))
+    {
+        ctx.segmenter = ConeSegmenter{ctx.width, ctx.height, ChannelLayout::BGRA, parameters.thresholds};
+        std::clog << "Thresholds for '" << ctx.sharedMemory->name() << "' changed; using " << ctx.segmenter.description() << " segmentation kernel." << std::endl;
+    }
+
+    // HSV values reference: https://www.codespeedy.com/splitting-rgb-and-hsv-values-in-an-image-using-opencv-python/
+    // Solution partly inspired by: https://stackoverflow.com/questions/9018906/detect-rgb-color-interval-with-opencv-and-c
+    // AND: https://solarianprogrammer.com/2015/05/08/detect-red-circles-image-using-opencv/
+
+    // Cone color detection
+    // Everything the previous frame allocated is released at once.
+    ctx.arena.reset();
+    RunList coneRuns{ArenaAllocator<ConeRun>{&ctx.arena}};
+    coneRuns.reserve(ctx.runCount + ctx.runCount / 4);
+    ctx.segmenter.segment(pixels, coneRuns, rowStep);
+    ctx.runCount = coneRuns.size();
+    const BlobList coneBlobs{labelRuns(coneRuns, rowStep)};
+    fusion.submit(ctx.index, summariseBlobs(coneBlobs, tStamp, parameters.minBlobArea, parameters.minConeArea));
+    ctx.statistics.countProcessed();
+
+    if (verbose)
+    {
+        // Draw box around unnecessary part of car and in region above cones; the segmentation kernel skips both regions.
+        cv::rectangle(ctx.img, cv::Point(150, 385), cv::Point(500, 500), cv::Scalar(0, 0, 0), CV_FILLED);
+        cv::rectangle(ctx.img, cv::Point(0, 0), cv::Point(650, 250), cv::Scalar(0, 0, 0), CV_FILLED);
+
+        for (const ConeBlob &blob : coneBlobs)
+        {
+            if (blob.area() > parameters.minBlobArea)
+            {
+                const cv::Rect boundRectangle(blob.x, blob.y, blob.width, blob.height);
+                const cv::Scalar colour = (ConeColour::Blue == blob.colour) ? cv::Scalar(0, 255, 0) : cv::Scalar(6, 82, 58); //<-- Light green rectangles for blue and dark green for yellow cones
+                cv::rectangle(ctx.img, boundRectangle.tl(), boundRectangle.br(), colour, 3);
+            }
+        }
+        cv::rectangle(ctx.img, cv::Point(50, 50), cv::Point(100, 100), cv::Scalar(0, 0, 255));
+
+        std::lock_guard<std::mutex> lck(ctx.displayMutex);
+        cv::swap(ctx.display, ctx.img);
+    }
+}
 
-auto calculateSteering(double rightIR, double leftIR, int rightCones, int leftCones, double steering)
+// Copies the next frame without taking the lock of the shared memory; the copy
+// is only kept when the producer did not touch the frame while it was copied.
+bool copyFrameWithSequence(FrameContext &ctx, cv::Mat &frame, int64_t &tStamp, uint32_t &sampleNumber)
 {
-    double incrementSteering = 0.045;
-    steering = 0;
+    const uint32_t sequence{ctx.sharedMemory->waitForSequence(ctx.sequence, std::chrono::milliseconds(100))};
+    if (sequence == ctx.sequence)
+    {
+        return false;
+    }
+    const int64_t woken{monotonicMicroseconds()};
+
+    std::pair<bool, cluon::data::TimeStamp> pair = ctx.sharedMemory->getTimeStamp();
+    tStamp = cluon::time::toMicroseconds(pair.second);
+    sampleNumber = ctx.sharedMemory->sampleNumber();
+    const int64_t published{ctx.sharedMemory->publishedAt()};
+    cv::Mat wrapped(ctx.height, ctx.width, CV_8UC4, ctx.sharedMemory->data());
+    wrapped.copyTo(frame);
+    if (!ctx.sharedMemory->sequenceUnchanged(sequence))
+    {
+        ctx.statistics.countTorn();
+        return false;
+    }
+    ctx.sequence = sequence;
+    ctx.wakeLag.observe(woken - published);
+    return true;
+}
 
-    if (rightIR <= 0.007)
+// Processes a frame right away, adapting the row step with FramePolicy::Adaptive.
+void processFrame(FrameContext &ctx, DetectionFusion &fusion, const SteeringParameters &parameters, const uint8_t *pixels, int64_t tStamp, bool verbose)
+{
+    const auto start{std::chrono::steady_clock::now()};
+    detectCones(ctx, fusion, parameters, pixels, tStamp, ctx.governor.rowStep(), verbose);
+    if (FramePolicy::Adaptive == ctx.policy)
     {
-        steering = steering + incrementSteering;
+        ctx.governor.update(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start), ctx.statistics.period());
     }
-    if (leftIR <= 0.007)
+}
+
+// Applies the real-time schedule to a thread; what the process is not permitted to do is reported and skipped.
+// A priority the process may not use fails alike for every thread and is only reported for the first one.
+void makeRealtime(pthread_t thread, const RealtimeSchedule &schedule, const std::string &role)
+{
+    static std::atomic<bool> priorityFailureReported{false};
+    std::string error;
+    if ((0 <= schedule.cpu) && !pinThread(thread, schedule.cpu, error))
     {
-        steering = steering - incrementSteering;
+        std::cerr << "Real-time mode of the " << role << ": " << error << "; running on any CPU." << std::endl;
     }
+    if (!setFifoPriority(thread, schedule.priority, error) && !priorityFailureReported.exchange(true))
+    {
+        std::cerr << "Real-time mode: " << error << "; keeping the default scheduling of all threads." << std::endl;
+    }
+}
 
-    if (rightCones == 0)
+// Processing loop of one camera with FramePolicy::Queue.
+void processQueuedFrames(FrameContext &ctx, DetectionFusion &fusion, Parameters &parameters, cluon::OD4Session &od4, const RealtimeSchedule &schedule,
+                         bool verbose)
+{
+    if (schedule.enabled)
     {
-        steering = -0.15;
+        makeRealtime(::pthread_self(), schedule, "processing thread of '" + ctx.sharedMemory->name() + "'");
+        prefaultStack();
     }
-    if (leftCones == 0)
+    Parameters::Reader reader{parameters};
+    while (od4.isRunning())
+    {
+        reader.quiescent();
+        int64_t tStamp{0};
+        if (ctx.queue->pop(ctx.img, tStamp, std::chrono::milliseconds(100)))
+        {
+            detectCones(ctx, fusion, parameters.read(), ctx.img.data, tStamp, 1, verbose);
+        }
+    }
+}
+
+// Takes a frame buffer from the pool with all its pages faulted in.
+cv::Mat allocateFrame(FrameContext &ctx)
+{
+    cv::Mat frame{ctx.frameBuffers.allocate(ctx.width, ctx.height)};
+    prefault(frame.data, static_cast<size_t>(ctx.width) * ctx.height * 4);
+    return frame;
+}
+
+// Allocates the frame buffers of a camera from the pool before the first frame;
+// called by the waiter thread so that the buffers end up on the NUMA node it runs on.
+void allocateFrameBuffers(FrameContext &ctx, bool verbose)
+{
+    ctx.img = allocateFrame(ctx);
+    ctx.staging = allocateFrame(ctx);
+    if (verbose)
+    {
+        ctx.display = allocateFrame(ctx);
+    }
+    if (ctx.queue)
+    {
+        // Queued frames plus the one being copied in and the one being processed.
+        for (size_t i = 0; i < ctx.queue->capacity() + 2; i++)
+        {
+            ctx.queue->recycle(allocateFrame(ctx));
+        }
+    }
+    std::clog << "Frame buffers for '" << ctx.sharedMemory->name() << "': " << ctx.frameBuffers.description() << "." << std::endl;
+}
+
+// Waiter loop of one camera: takes each new frame out of the shared memory and
+// either processes it right away or, with FramePolicy::Queue, only enqueues a
+// copy for a processing thread started here.
+void processFrames(FrameContext &ctx, DetectionFusion &fusion, Parameters &parameters, cluon::OD4Session &od4, const RealtimeSchedule &schedule, bool verbose)
+{
+    if (schedule.enabled)
+    {
+        makeRealtime(::pthread_self(), schedule, "waiter thread of '" + ctx.sharedMemory->name() + "'");
+        prefaultStack();
+    }
+    // In real-time mode, the first frames must not page-fault either.
+    if (ctx.frameBuffers.enabled() || schedule.enabled)
+    {
+        allocateFrameBuffers(ctx, verbose);
+    }
+    std::thread processor;
+    if (ctx.queue)
+    {
+        processor = std::thread(processQueuedFrames, std::ref(ctx), std::ref(fusion), std::ref(parameters), std::ref(od4), schedule, verbose);
+    }
+
+    // Endless loop; end the program by pressing Ctrl-C.
+    Parameters::Reader reader{parameters};
+    while (od4.isRunning())
+    {
+        // The parameters of the previous frame may be freed from here on.
+        reader.quiescent();
+        const SteeringParameters &current = parameters.read();
+
+        int64_t tStamp{0};
+        if (1 < ctx.sharedMemory->slots())
+        {
+            // The producer publishes frames in slots: the newest frame is borrowed and
+            // processed in place while the producer fills another slot.
+            const uint32_t sequence{ctx.sharedMemory->waitForSequence(ctx.sequence, std::chrono::milliseconds(100))};
+            const int64_t woken{monotonicMicroseconds()};
+            cluon::data::TimeStamp sampleT;
+            const char *slot{(sequence != ctx.sequence) ? ctx.sharedMemory->borrowSlot(sampleT) : nullptr};
+            if (nullptr != slot)
+            {
+                ctx.sequence = sequence;
+                tStamp = cluon::time::toMicroseconds(sampleT);
+                ctx.wakeLag.observe(woken - ctx.sharedMemory->publishedAt());
+                if (ctx.statistics.observe(tStamp, ctx.sharedMemory->sampleNumber()))
+                {
+                    const cv::Mat borrowed(ctx.height, ctx.width, CV_8UC4, const_cast<char *>(slot));
+                    if (ctx.queue)
+                    {
+                        if (!ctx.queue->push(borrowed, tStamp))
+                        {
+                            ctx.statistics.countOverflow();
+                        }
+                    }
+                    else if (verbose)
+                    {
+                        // The annotations must not end up in the shared memory.
+                        borrowed.copyTo(ctx.img);
+                        processFrame(ctx, fusion, current, ctx.img.data, tStamp, verbose);
+                    }
+                    else
+                    {
+                        processFrame(ctx, fusion, current, borrowed.data, tStamp, verbose);
+                    }
+                }
+                ctx.sharedMemory->returnSlot();
+            }
+        }
+        else if (ctx.sharedMemory->hasSequence())
+        {
+            // The producer maintains a sequence counter: neither side blocks the other.
+            cv::Mat &frame = ctx.queue ? ctx.staging : ctx.img;
+            uint32_t sampleNumber{0};
+            if (copyFrameWithSequence(ctx, frame, tStamp, sampleNumber) && ctx.statistics.observe(tStamp, sampleNumber))
+            {
+                if (!ctx.queue)
+                {
+                    processFrame(ctx, fusion, current, ctx.img.data, tStamp, verbose);
+                }
+                else if (!ctx.queue->push(frame, tStamp))
+                {
+                    ctx.statistics.countOverflow();
+                }
+            }
+        }
+        else
+        {
+            // Wait for a notification of a new frame.
+            ctx.sharedMemory->wait();
+
+            // Lock the shared memory.
+            ctx.sharedMemory->lock();
+            std::pair<bool, cluon::data::TimeStamp> pair = ctx.sharedMemory->getTimeStamp();
+            cluon::data::TimeStamp sampleT = pair.second;
+            tStamp = cluon::time::toMicroseconds(sampleT);
+
+            // Wake-ups without a new sample time would only repeat the previous frame.
+            const bool isNewFrame{ctx.statistics.observe(tStamp, ctx.sharedMemory->sampleNumber())};
+            if (isNewFrame)
+            {
+                // Copy the pixels from the shared memory into our own data structure.
+                cv::Mat wrapped(ctx.height, ctx.width, CV_8UC4, ctx.sharedMemory->data());
+                if (ctx.queue)
+                {
+                    if (!ctx.queue->push(wrapped, tStamp))
+                    {
+                        ctx.statistics.countOverflow();
+                    }
+                }
+                else
+                {
+                    wrapped.copyTo(ctx.img);
+                }
+            }
+            ctx.sharedMemory->unlock();
+
+            if (isNewFrame && !ctx.queue)
+            {
+                processFrame(ctx, fusion, current, ctx.img.data, tStamp, verbose);
+            }
+        }
+    }
+
+    if (processor.joinable())
+    {
+        processor.join();
+    }
+}
+
+// Publishes the content of the parameter file if it was modified since lastModified;
+// a file with errors leaves the running parameters untouched.
+void reloadParameterFile(const std::string &path, struct timespec &lastModified, Parameters &parameters)
+{
+    struct stat fileStatus;
+    if ((0 == ::stat(path.c_str(), &fileStatus)) &&
+        ((fileStatus.st_mtim.tv_sec != lastModified.tv_sec) || (fileStatus.st_mtim.tv_nsec != lastModified.tv_nsec)))
+    {
+        lastModified = fileStatus.st_mtim;
+        std::unique_ptr<SteeringParameters> loaded{new SteeringParameters};
+        std::string error;
+        if (loadSteeringParameters(path, *loaded, error))
+        {
+            parameters.publish(std::move(loaded));
+            std::clog << "Loaded steering parameters from '" << path << "'." << std::endl;
+        }
+        else
+        {
+            std::cerr << "Ignoring steering parameters from '" << path << "': " << error << "." << std::endl;
+        }
+    }
+}
+
+// Polls the parameter file twice per second.
+void watchParameterFile(const std::string &path, struct timespec lastModified, Parameters &parameters, cluon::OD4Session &od4)
+{
+    while (od4.isRunning())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        reloadParameterFile(path, lastModified, parameters);
+        parameters.reclaim();
+    }
+}
+
+// Replays the steering decisions for the frames of a feature file without
+// touching any pixels; prints the same lines as a live run.
+bool replayFeatureFile(const std::string &path, const SteeringParameters &parameters, std::string &error)
+{
+    FeatureFile file;
+    if (!file.open(path, error))
+    {
+        return false;
+    }
+
+    DirectionEstimator directionEstimator;
+    double steering{0.0};
+    SteeringScore score;
+    for (const FeatureFile::Block &block : file.blocks())
     {
-        steering = 0.15;
+        for (uint32_t i = 0; i < block.frames; i++)
+        {
+            const FrameFeatures frame{file.frame(block, i)};
+            directionEstimator.observe(frame.sampleTimeStamp, frame.largestBlueX, frame.largestBlueWidth, frame.largestYellowX, frame.largestYellowWidth);
+            steering = steerInDirection(parameters, directionEstimator.direction(), frame.rightIR, frame.leftIR, frame.yellowCones, frame.blueCones, steering);
+            std::cout << "Group_02;" << frame.sampleTimeStamp << ";" << steering << '\n';
+            score.add(steering, frame.groundSteering);
+        }
     }
-    return steering;
+    std::cout.flush();
+    std::clog << "Replayed " << score.frames << " frames: " << score.passed << " passed (" << 100.0 * score.passRate() << "%), mean absolute error "
+              << score.meanAbsoluteError() << "." << std::endl;
+    return true;
 }
 
 int32_t main(int32_t argc, char **argv)
 {
     int32_t retCode{1};
-    int yellowCones = 6;
-    int blueCones = 0;
-    double leftIR;
-    double rightIR;
+    double leftIR{0.0};
+    double rightIR{0.0};
     double steering = 0.0;
-    int directionEstablished = 0;
-    std::string carDirection;
-    int numberClockwise = 0;
-    int numberCounterclockwise = 0;
-
-    
+    DirectionEstimator directionEstimator;
 
     // Parse the command line parameters as we require the user to specify some mandatory information on startup.
     auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
-    if ((0 == commandlineArguments.count("cid")) ||
+    if (0 != commandlineArguments.count("replay"))
+    {
+        SteeringParameters replayParameters;
+        std::string error;
+        if (((0 == commandlineArguments.count("parameters")) || loadSteeringParameters(commandlineArguments["parameters"], replayParameters, error)) &&
+            replayFeatureFile(commandlineArguments["replay"], replayParameters, error))
+        {
+            retCode = 0;
+        }
+        else
+        {
+            std::cerr << argv[0] << ": " << error << std::endl;
+        }
+    }
+    else if ((0 == commandlineArguments.count("cid")) ||
         (0 == commandlineArguments.count("name")) ||
         (0 == commandlineArguments.count("width")) ||
         (0 == commandlineArguments.count("height")))
     {
-        std::cerr << argv[0] << " attaches to a shared memory area containing an ARGB image." << std::endl;
-        std::cerr << "Usage:   " << argv[0] << " --cid=<OD4 session> --name=<name of shared memory area> [--verbose]" << std::endl;
+        std::cerr << argv[0] << " attaches to one or more shared memory areas containing an ARGB image." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " --cid=<OD4 session> --name=<name of shared memory area>[,<name>...] [--verbose]" << std::endl;
         std::cerr << "         --cid:    CID of the OD4Session to send and receive messages" << std::endl;
-        std::cerr << "         --name:   name of the shared memory area to attach" << std::endl;
+        std::cerr << "         --name:   comma-separated names of the shared memory areas to attach; the first camera drives the output" << std::endl;
         std::cerr << "         --width:  width of the frame" << std::endl;
         std::cerr << "         --height: height of the frame" << std::endl;
+        std::cerr << "         --policy: how to keep up with the cameras: latest (default), queue or adaptive" << std::endl;
+        std::cerr << "         --queue:  number of frames buffered per camera with --policy=queue [1 .. " << MAX_QUEUE_LENGTH << "] (default: 3)" << std::endl;
+        std::cerr << "         --hugepages: back the frame buffers with pre-faulted 2 MB pages on the NUMA node of the camera thread" << std::endl;
+        std::cerr << "         --parameters: file with one steering parameter per line (key=value); reloaded when modified" << std::endl;
+        std::cerr << "                       keys: incrementSteering, infraredThreshold, fallbackSteering, minBlobArea, minConeArea," << std::endl;
+        std::cerr << "                             yellow, yellowLow, blue (HSV ranges as hLow,sLow,vLow,hHigh,sHigh,vHigh)" << std::endl;
+        std::cerr << "                       changes can also be sent as SystemOperationState with description 'steering:key=value;...'" << std::endl;
+        std::cerr << "         --watchdog: what to emit when the steering of a frame is not ready 1.5 frame periods after the previous one:" << std::endl;
+        std::cerr << "                     off (default), hold (the last steering) or extrapolate (the last change of the steering);" << std::endl;
+        std::cerr << "                     stops after " << SteeringWatchdog::MAX_PREDICTIONS << " frames in a row until the next frame is done" << std::endl;
+        std::cerr << "         --features: file to record the cone detections, infrared readings and ground steering of every frame to" << std::endl;
+        std::cerr << "                     (input of --replay and steering-sweep)" << std::endl;
+        std::cerr << "         --kernel-filter: let the kernel drop the messages of the OD4Session that are not processed (Linux)" << std::endl;
+        std::cerr << "         --receive-batch: number of messages of the OD4Session read per system call (Linux; default: 1)" << std::endl;
+        std::cerr << "         --inline-dispatch: handle the infrared readings on the thread receiving the messages of the OD4Session" << std::endl;
+        std::cerr << "         --realtime: run the camera and sensor threads with SCHED_FIFO and lock the memory; what is not permitted is skipped" << std::endl;
+        std::cerr << "         --priority: SCHED_FIFO priority of these threads with --realtime [1 .. 99] (default: 50)" << std::endl;
+        std::cerr << "         --frame-cpu: comma-separated CPUs to pin the threads of the cameras to with --realtime, one per camera" << std::endl;
+        std::cerr << "         --sensor-cpu: one CPU to pin the threads receiving the messages of the OD4Session to with --realtime" << std::endl;
         std::cerr << "Example: " << argv[0] << " --cid=253 --name=img --width=640 --height=480 --verbose" << std::endl;
+        std::cerr << "Replay:  " << argv[0] << " --replay=<feature file> [--parameters=<file>]" << std::endl;
+        std::cerr << "         prints the steering for every recorded frame and how it compares to the ground steering" << std::endl;
     }
     else
     {
         // Extract the values from the command line parameters
-        const std::string NAME{commandlineArguments["name"]};
+        const std::vector<std::string> NAMES{splitList(commandlineArguments["name"], ',')};
         const uint32_t WIDTH{static_cast<uint32_t>(std::stoi(commandlineArguments["width"]))};
         const uint32_t HEIGHT{static_cast<uint32_t>(std::stoi(commandlineArguments["height"]))};
         const bool VERBOSE{commandlineArguments.count("verbose") != 0};
+        const bool HUGEPAGES{commandlineArguments.count("hugepages") != 0};
+        const bool KERNEL_FILTER{commandlineArguments.count("kernel-filter") != 0};
+        const uint32_t RECEIVE_BATCH{(commandlineArguments.count("receive-batch") != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["receive-batch"])) : 1};
+        const bool INLINE_DISPATCH{commandlineArguments.count("inline-dispatch") != 0};
+        const bool REALTIME{commandlineArguments.count("realtime") != 0};
+        int PRIORITY{50};
+        if ((commandlineArguments.count("priority") != 0) && !parsePriority(commandlineArguments["priority"], PRIORITY))
+        {
+            std::cerr << argv[0] << ": Invalid priority '" << commandlineArguments["priority"] << "', expected 1 .. 99; using 50." << std::endl;
+        }
+        std::vector<int> FRAME_CPUS;
+        if ((commandlineArguments.count("frame-cpu") != 0) && !parseCpuList(commandlineArguments["frame-cpu"], FRAME_CPUS))
+        {
+            std::cerr << argv[0] << ": Invalid CPU list '" << commandlineArguments["frame-cpu"] << "'; not pinning the camera threads." << std::endl;
+        }
+        int SENSOR_CPU{-1};
+        if (commandlineArguments.count("sensor-cpu") != 0)
+        {
+            std::vector<int> cpus;
+            if (parseCpuList(commandlineArguments["sensor-cpu"], cpus) && (1 == cpus.size()))
+            {
+                SENSOR_CPU = cpus.front();
+            }
+            else
+            {
+                std::cerr << argv[0] << ": Invalid CPU '" << commandlineArguments["sensor-cpu"] << "', expected one CPU; not pinning the sensor threads." << std::endl;
+            }
+        }
+        size_t QUEUE{3};
+        if ((commandlineArguments.count("queue") != 0) && !parseQueueLength(commandlineArguments["queue"], QUEUE))
+        {
+            std::cerr << argv[0] << ": Invalid queue length '" << commandlineArguments["queue"] << "', expected 1 .. " << MAX_QUEUE_LENGTH << "; using 3." << std::endl;
+        }
+        FramePolicy POLICY{FramePolicy::Latest};
+        if ((commandlineArguments.count("policy") != 0) && !parseFramePolicy(commandlineArguments["policy"], POLICY))
+        {
+            std::cerr << argv[0] << ": Unknown policy '" << commandlineArguments["policy"] << "'; using latest." << std::endl;
+        }
+        WatchdogMode WATCHDOG{WatchdogMode::Off};
+        if ((commandlineArguments.count("watchdog") != 0) && !parseWatchdogMode(commandlineArguments["watchdog"], WATCHDOG))
+        {
+            std::cerr << argv[0] << ": Unknown watchdog mode '" << commandlineArguments["watchdog"] << "'; using off." << std::endl;
+        }
+        const std::string PARAMETERS{(commandlineArguments.count("parameters") != 0) ? commandlineArguments["parameters"] : ""};
+        const std::string FEATURES{(commandlineArguments.count("features") != 0) ? commandlineArguments["features"] : ""};
+
+        // The steering parameters are read without locks and replaced as a whole, so that they can be tuned while driving.
+        // Readers: the waiter of every camera, its processing thread when queueing, and the fusion stage.
+        Parameters parameters{SteeringParameters{}, NAMES.size() * ((FramePolicy::Queue == POLICY) ? 2 : 1) + 1};
+        struct timespec parametersModified{0, 0};
+        if (!PARAMETERS.empty())
+        {
+            reloadParameterFile(PARAMETERS, parametersModified, parameters);
+        }
 
-        // Attach to the shared memory.
-        std::unique_ptr<cluon::SharedMemory> sharedMemory{new cluon::SharedMemory{NAME}};
-        if (sharedMemory && sharedMemory->valid())
+        // Attach to the shared memory of every camera; each gets its own frame context.
+        std::vector<std::unique_ptr<FrameContext>> cameras;
+        bool allValid{!NAMES.empty()};
+        for (const std::string &name : NAMES)
         {
-            std::clog << argv[0] << ": Attached to shared memory '" << sharedMemory->name() << " (" << sharedMemory->size() << " bytes)." << std::endl;
+            std::unique_ptr<FrameContext> ctx{new FrameContext{cameras.size(), name, WIDTH, HEIGHT, POLICY, QUEUE, HUGEPAGES}};
+            uint32_t width{0};
+            uint32_t height{0};
+            uint32_t pixelFormat{0};
+            if (ctx->sharedMemory && ctx->sharedMemory->valid() && ctx->sharedMemory->getFormat(width, height, pixelFormat) &&
+                ((WIDTH != width) || (HEIGHT != height) || (FOURCC_BGRA != pixelFormat)))
+            {
+                // The producer announced its images; frames of another format would be misread.
+                std::cerr << argv[0] << ": Shared memory '" << name << "' holds " << width << "x" << height << " images in format 0x" << std::hex << pixelFormat
+                          << std::dec << ", expected " << WIDTH << "x" << HEIGHT << " BGRA." << std::endl;
+                allValid = false;
+            }
+            else if (ctx->sharedMemory && ctx->sharedMemory->valid())
+            {
+                std::clog << argv[0] << ": Attached to shared memory '" << ctx->sharedMemory->name() << " (" << ctx->sharedMemory->size() << " bytes)." << std::endl;
+                std::clog << argv[0] << ": Using " << ctx->segmenter.description() << " segmentation kernel." << std::endl;
+            }
+            else
+            {
+                std::cerr << argv[0] << ": Failed to attach to shared memory '" << name << "'." << std::endl;
+                allValid = false;
+            }
+            cameras.push_back(std::move(ctx));
+        }
 
+        if (allValid)
+        {
             // Interface to a running OpenDaVINCI session where network messages are exchanged.
             // The instance od4 allows you to send and receive messages.
             cluon::OD4Session od4{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
+            // Point clouds and images on the bus would otherwise all be copied and decoded only to be dropped;
+            // the filter follows the dataTriggers below.
+            if (KERNEL_FILTER && !od4.filterInKernel(true))
+            {
+                std::cerr << argv[0] << ": Cannot filter messages in the kernel; filtering them after receiving." << std::endl;
+            }
+            if ((1 < RECEIVE_BATCH) && !od4.receiveInBatches(RECEIVE_BATCH))
+            {
+                std::cerr << argv[0] << ": Cannot receive messages in batches of " << RECEIVE_BATCH << "; receiving them one by one." << std::endl;
+            }
+            // Only the infrared handlers below are cheap enough to run on the receiving thread (cf. runInline); the
+            // steering parameters sent as SystemOperationState are still applied on a separate thread.
+            od4.dispatchInline(INLINE_DISPATCH);
 
             opendlv::proxy::GroundSteeringRequest gsr;
-            opendlv::proxy::VoltageReading infrared;
             std::mutex infraredMutex;
             std::mutex gsrMutex;
             auto onGroundSteeringRequest = [&gsr, &gsrMutex](cluon::data::Envelope &&env)
@@ -115,188 +578,208 @@ int32_t main(int32_t argc, char **argv)
 
             ///Infrared sensor
 
-            auto onVoltageReading = [&infrared, &infraredMutex, &rightIR, &leftIR, &yellowCones, &blueCones, &steering](cluon::data::Envelope &&env)
+            // Only the left (sender 1) and right (sender 3) sensors are routed here; the voltages of other
+            // sensors are dropped before they are decoded.
+            auto onLeftVoltageReading = [&infraredMutex, &leftIR](cluon::data::Envelope &&env)
             {
+                const opendlv::proxy::VoltageReading infrared{cluon::extractMessage<opendlv::proxy::VoltageReading>(std::move(env))};
                 std::lock_guard<std::mutex> lck(infraredMutex);
-                infrared = cluon::extractMessage<opendlv::proxy::VoltageReading>(std::move(env));
-                if (env.senderStamp() == 3)
-                {
-                    rightIR = infrared.voltage();
-                }
-                else if (env.senderStamp() == 1)
-                {
-                    leftIR = infrared.voltage();
-                }
+                leftIR = infrared.voltage();
             };
-
-            od4.dataTrigger(opendlv::proxy::VoltageReading::ID(), onVoltageReading);
-
-            // Endless loop; end the program by pressing Ctrl-C.
-            while (od4.isRunning())
+            auto onRightVoltageReading = [&infraredMutex, &rightIR](cluon::data::Envelope &&env)
             {
-                // OpenCV data structure to hold an image.
-                cv::Mat img;
+                const opendlv::proxy::VoltageReading infrared{cluon::extractMessage<opendlv::proxy::VoltageReading>(std::move(env))};
+                std::lock_guard<std::mutex> lck(infraredMutex);
+                rightIR = infrared.voltage();
+            };
 
-                // Wait for a notification of a new frame.
-                sharedMemory->wait();
+            od4.dataTrigger(opendlv::proxy::VoltageReading::ID(), 1, onLeftVoltageReading);
+            od4.dataTrigger(opendlv::proxy::VoltageReading::ID(), 3, onRightVoltageReading);
+            // They only store the latest voltage.
+            od4.runInline(opendlv::proxy::VoltageReading::ID(), true);
 
-                // Lock the shared memory.
-                sharedMemory->lock();
+            // Parameter changes sent during a run apply on top of the current parameters.
+            auto onSystemOperationState = [&parameters](cluon::data::Envelope &&env)
+            {
+                const std::string PREFIX{"steering:"};
+                opendlv::system::SystemOperationState state = cluon::extractMessage<opendlv::system::SystemOperationState>(std::move(env));
+                if (0 == state.description().compare(0, PREFIX.size(), PREFIX))
                 {
-                    // Copy the pixels from the shared memory into our own data structure.
-                    cv::Mat wrapped(HEIGHT, WIDTH, CV_8UC4, sharedMemory->data());
-                    img = wrapped.clone();
+                    std::string error;
+                    parameters.update([&state, &PREFIX, &error](SteeringParameters &changed)
+                                      { return parseSteeringParameters(state.description().substr(PREFIX.size()), ';', changed, error); });
+                    std::clog << "Steering parameters " << (error.empty() ? "changed" : "unchanged: " + error) << "." << std::endl;
                 }
-                
-                std::pair<bool, cluon::data::TimeStamp> pair = sharedMemory->getTimeStamp();
-                cluon::data::TimeStamp sampleT = pair.second;
-                int64_t tStamp = cluon::time::toMicroseconds(sampleT);
-                std::string ts = std::to_string(tStamp);
-                std::string sampleTimeVar = "Sample Time: " + ts;
-                sharedMemory->unlock();
-
-                
-
-                // HSV values reference: https://www.codespeedy.com/splitting-rgb-and-hsv-values-in-an-image-using-opencv-python/
-                // Solution partly inspired by: https://stackoverflow.com/questions/9018906/detect-rgb-color-interval-with-opencv-and-c
-                // AND: https://solarianprogrammer.com/2015/05/08/detect-red-circles-image-using-opencv/
-
-                // Cone color detection
-
-                using namespace cv;
-                using namespace std;
-
-                cv::Mat originalImg;
-                img.copyTo(originalImg);
-
-                cv::Mat hsvIMG;
-                img.copyTo(hsvIMG);
-
-                // Draw box around unnecessary part of car(to avoid conflicts with inrange below)
-                cv::rectangle(img, cv::Point(150, 385), cv::Point(500, 500), cv::Scalar(0, 0, 0), CV_FILLED);
-                // Draw box in region above cones, to avoid conflicts with irrelevant objects.
-                cv::rectangle(img, cv::Point(0, 0), cv::Point(650, 250), cv::Scalar(0, 0, 0), CV_FILLED);
-
-                cv::cvtColor(img, hsvIMG, cv::COLOR_BGR2HSV);
-
-                cv::Mat justYellowColor;
-                cv::Mat justYellowColor2;
-                cv::Mat justBlueColor;
-
-                inRange(hsvIMG, cv::Scalar(12, 20, 20), cv::Scalar(70, 100, 250), justYellowColor); // Yellow(low, high) - Yellow cones
-                inRange(hsvIMG, cv::Scalar(8, 20, 20), cv::Scalar(11, 100, 250), justYellowColor2); // Yellow(low, high) - Yellow cones copy for lower ranges
-                inRange(hsvIMG, cv::Scalar(80, 125, 8), cv::Scalar(135, 255, 210), justBlueColor); // Blue(low, high) - Blue cones
+            };
+            od4.dataTrigger(opendlv::system::SystemOperationState::ID(), onSystemOperationState);
 
-                justYellowColor = justYellowColor | justYellowColor2;
+            FeatureWriter features;
+            if (!FEATURES.empty() && !features.open(FEATURES))
+            {
+                std::cerr << argv[0] << ": Cannot write features to '" << FEATURES << "'." << std::endl;
+            }
 
-                cv::Rect bounding_rect;                   
-                vector<vector<cv::Point>> yellowcontours; // Vector for storing yellow contours
-                vector<vector<cv::Point>> bluecontours;   // Vector for storing blue contours
-                cv::findContours(justBlueColor, bluecontours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-                cv::findContours(justYellowColor, yellowcontours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+            std::thread parameterWatcher;
+            if (!PARAMETERS.empty())
+            {
+                parameterWatcher = std::thread(watchParameterFile, PARAMETERS, parametersModified, std::ref(parameters), std::ref(od4));
+            }
 
-             
+            // The shared memory areas are mapped by now; the frame buffers are allocated by the waiters below.
+            if (REALTIME)
+            {
+                std::string error;
+                if (!lockMemory(error))
+                {
+                    std::cerr << argv[0] << ": Real-time mode: " << error << "; pages may still be faulted in while driving." << std::endl;
+                }
+                const RealtimeSchedule sensorSchedule{true, SENSOR_CPU, PRIORITY};
+                for (const pthread_t thread : od4.receivingThreads())
+                {
+                    makeRealtime(thread, sensorSchedule, "sensor thread");
+                }
+                // The fusion stage below turns the detections into steering; it is not pinned.
+                makeRealtime(::pthread_self(), RealtimeSchedule{true, -1, PRIORITY}, "fusion thread");
+                prefaultStack();
+            }
 
-                cv::Rect boundRectangleYellow;
-                cv::Rect boundRectangleBlue;
+            // One waiter thread per camera (plus a processing thread when queueing) feeds the fusion stage running in this thread.
+            DetectionFusion fusion{cameras.size()};
+            std::vector<std::thread> waiters;
+            for (auto &ctx : cameras)
+            {
+                const RealtimeSchedule schedule{REALTIME, FRAME_CPUS.empty() ? -1 : FRAME_CPUS[ctx->index % FRAME_CPUS.size()], PRIORITY};
+                waiters.emplace_back(processFrames, std::ref(*ctx), std::ref(fusion), std::ref(parameters), std::ref(od4), schedule, VERBOSE);
+            }
 
-                cv::Rect largestboundRectangleBlue;
-                cv::Rect largestboundRectangleYellow;
+            // The frame statistics of every camera are exported once per second.
+            auto lastExport{std::chrono::steady_clock::now()};
 
-                int amountOfYellowCones = 0;
-                int amountOfBlueCones = 0;
+            // Steering is due at the cadence of the primary camera, even when one of its frames takes too long.
+            SteeringWatchdog watchdog{WATCHDOG};
 
-                int largestAreaYellow = 0;
-                int largestAreaBlue = 0;
+            Parameters::Reader reader{parameters};
+            while (od4.isRunning())
+            {
+                reader.quiescent();
 
-                for (unsigned int i = 0; i < bluecontours.size(); i++)
+                if (std::chrono::steady_clock::now() - lastExport > std::chrono::seconds(1))
                 {
-                    boundRectangleBlue = cv::boundingRect(bluecontours[i]);
-                    if (boundRectangleBlue.area() > 80)
-                    {                                                                                                   
-                        cv::rectangle(img, boundRectangleBlue.tl(), boundRectangleBlue.br(), cv::Scalar(0, 255, 0), 3); //<-- Light green rectangles
-
-                        if (boundRectangleBlue.area() > largestAreaBlue)
+                    lastExport = std::chrono::steady_clock::now();
+                    for (auto &ctx : cameras)
+                    {
+                        opendlv::system::SignalStatusMessage frameStatus;
+                        frameStatus.code(static_cast<int32_t>(ctx->index));
+                        frameStatus.description("frames;" + ctx->sharedMemory->name() + ";" + ctx->statistics.summary() + ";" + ctx->wakeLag.summary());
+                        od4.send(frameStatus, cluon::time::now(), static_cast<uint32_t>(ctx->index));
+                        if (VERBOSE)
                         {
-                            largestAreaBlue = boundRectangleBlue.area();
-                            largestboundRectangleBlue = cv::boundingRect(bluecontours[i]);
-                        }
-
-                        if (boundRectangleBlue.area() > 120)
-                        {   
-                            amountOfBlueCones += 1;
+                            std::clog << argv[0] << ": " << frameStatus.description() << std::endl;
                         }
                     }
                 }
 
-                for (unsigned int i = 0; i < yellowcontours.size(); i++)
+                const int64_t period{cameras.front()->statistics.period()};
+                const auto deadline{watchdog.deadline(period)};
+                const auto now{std::chrono::steady_clock::now()};
+                std::chrono::steady_clock::duration timeout{std::chrono::milliseconds(100)};
+                if (deadline <= now)
                 {
-                    boundRectangleYellow = cv::boundingRect(yellowcontours[i]);
-                    if (boundRectangleYellow.area() > 80)
-                    {                                                                                                       
-                                                                                                                            
-                        cv::rectangle(img, boundRectangleYellow.tl(), boundRectangleYellow.br(), cv::Scalar(6, 82, 58), 3); //<-- Dark green rectangles
-
-                        if (boundRectangleYellow.area() > largestAreaYellow)
-                        {
-                            largestAreaYellow = boundRectangleYellow.area();
-                            largestboundRectangleYellow = cv::boundingRect(yellowcontours[i]);
-                        }
+                    timeout = std::chrono::steady_clock::duration::zero();
+                }
+                else if (deadline - now < timeout)
+                {
+                    timeout = deadline - now;
+                }
 
-                        if (boundRectangleYellow.area() > 120)
+                ConeDetections cones;
+                if (!fusion.waitForPrimary(std::chrono::duration_cast<std::chrono::microseconds>(timeout), cones))
+                {
+                    const auto late{std::chrono::steady_clock::now()};
+                    if (late >= deadline)
+                    {
+                        int64_t expected{0};
+                        const double predicted{watchdog.predict(period, late, expected)};
+                        std::cout << "Group_02;" << expected << ";" << predicted << std::endl;
+                        std::clog << argv[0] << ": Frame at " << expected << " missed its deadline by "
+                                  << std::chrono::duration_cast<std::chrono::microseconds>(late - deadline).count() << " us; emitted steering " << predicted
+                                  << "." << std::endl;
+                        if (watchdog.gaveUp())
                         {
-                            amountOfYellowCones += 1;
+                            std::clog << argv[0] << ": No frame for " << SteeringWatchdog::MAX_PREDICTIONS
+                                      << " periods; emitting no steering until the next frame is done." << std::endl;
                         }
                     }
+                    continue;
                 }
 
-                if (directionEstablished < 10 && (largestboundRectangleBlue.x != 0) && (boundRectangleYellow.x != 0))
+                const CarDirection previousDirection{directionEstimator.direction()};
+                directionEstimator.observe(cones.sampleTimeStamp, cones.largestBlue.x, cones.largestBlue.width, cones.largestYellow.x, cones.largestYellow.width);
+                if (previousDirection != directionEstimator.direction())
                 {
-                    if (largestboundRectangleBlue.x < largestboundRectangleYellow.x)
-                    {
-                        numberClockwise++;
-                    }
-                    else if (largestboundRectangleBlue.x > largestboundRectangleYellow.x)
-                    {
-                        numberCounterclockwise++;
-                    }
-
-                    if (numberClockwise > numberCounterclockwise)
-                    {
-                        carDirection = "Clockwise";
-                    }
-                    else if (numberCounterclockwise > numberClockwise)
-                    {
-                        carDirection = "Counter-Clockwise";
-                    }
-
-                    directionEstablished++;
+                    std::clog << argv[0] << ": Driving " << carDirectionName(directionEstimator.direction()) << " at " << cones.sampleTimeStamp << "." << std::endl;
                 }
 
-                if (carDirection == "Clockwise")
+                double right;
+                double left;
                 {
-                    steering = calculateSteering(rightIR, leftIR, amountOfYellowCones, amountOfBlueCones, steering);
+                    std::lock_guard<std::mutex> lck(infraredMutex);
+                    right = rightIR;
+                    left = leftIR;
                 }
-                if (carDirection == "Counter-Clockwise")
+
+                const SteeringParameters &current = parameters.read();
+                steering = steerInDirection(current, directionEstimator.direction(), right, left, cones.amountOfYellowCones, cones.amountOfBlueCones, steering);
+                // A frame that finished after the watchdog stood in for it is not emitted a second time.
+                if (watchdog.frameDone(cones.sampleTimeStamp, steering, period, std::chrono::steady_clock::now()))
                 {
-                    steering = calculateSteering(rightIR, leftIR, amountOfBlueCones, amountOfYellowCones, steering);
+                    std::cout << "Group_02;" << cones.sampleTimeStamp << ";" << steering << std::endl;
                 }
-                std::cout << "Group_02;" << tStamp << ";" << steering << std::endl;
-
-                cv::rectangle(img, cv::Point(50, 50), cv::Point(100, 100), cv::Scalar(0, 0, 255));
 
+                if (features.isOpen())
                 {
-                    std::lock_guard<std::mutex> lck(gsrMutex);
-
+                    double groundSteering;
+                    {
+                        std::lock_guard<std::mutex> lck(gsrMutex);
+                        groundSteering = gsr.groundSteering();
+                    }
+                    features.append(makeFrameFeatures(cones, left, right, groundSteering));
                 }
 
-
                 if (VERBOSE)
                 {
-                    cv::imshow(sharedMemory->name().c_str(), img);
+                    for (auto &ctx : cameras)
+                    {
+                        std::lock_guard<std::mutex> lck(ctx->displayMutex);
+                        if (!ctx->display.empty())
+                        {
+                            cv::imshow(ctx->sharedMemory->name().c_str(), ctx->display);
+                        }
+                    }
                     cv::waitKey(1);
                 }
             }
+
+            // Each waiter leaves its loop after its next frame.
+            for (auto &waiter : waiters)
+            {
+                waiter.join();
+            }
+            if (WatchdogMode::Off != WATCHDOG)
+            {
+                std::clog << argv[0] << ": " << watchdog.overruns() << " frames missed their deadline." << std::endl;
+            }
+            if (REALTIME)
+            {
+                for (auto &ctx : cameras)
+                {
+                    std::clog << argv[0] << ": Wake lag of '" << ctx->sharedMemory->name() << "' in microseconds: " << ctx->wakeLag.summary() << "." << std::endl;
+                }
+            }
+            if (parameterWatcher.joinable())
+            {
+                parameterWatcher.join();
+            }
         }
         retCode = 0;
     }
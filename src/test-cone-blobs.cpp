@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cone-blobs.hpp"
+#include "test-cone-masks.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Bounding box and number of pixels of a blob.
+using Box = std::array<int32_t, 5>;
+
+std::vector<Box> boxesOf(const BlobList &blobs, ConeColour colour)
+{
+    std::vector<Box> boxes;
+    for (const ConeBlob &b : blobs)
+    {
+        if (colour == b.colour)
+        {
+            boxes.push_back(Box{b.x, b.y, b.width, b.height, static_cast<int32_t>(b.pixels)});
+        }
+    }
+    std::sort(boxes.begin(), boxes.end());
+    return boxes;
+}
+
+// The 8-connected components of a mask.
+std::vector<Box> componentsOf(const cv::Mat &mask)
+{
+    cv::Mat labels;
+    cv::Mat stats;
+    cv::Mat centroids;
+    const int count{cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S)};
+    std::vector<Box> boxes;
+    for (int i = 1; i < count; i++)
+    {
+        boxes.push_back(Box{stats.at<int32_t>(i, cv::CC_STAT_LEFT), stats.at<int32_t>(i, cv::CC_STAT_TOP), stats.at<int32_t>(i, cv::CC_STAT_WIDTH),
+                            stats.at<int32_t>(i, cv::CC_STAT_HEIGHT), stats.at<int32_t>(i, cv::CC_STAT_AREA)});
+    }
+    std::sort(boxes.begin(), boxes.end());
+    return boxes;
+}
+
+// The mask as labelRuns sees it with a rowStep: every rowStep-th row stands for the rows up to the next one.
+cv::Mat repeatRows(const cv::Mat &mask, uint32_t rowStep)
+{
+    const int step{static_cast<int>(rowStep)};
+    cv::Mat repeated{cv::Mat::zeros((mask.rows + step - 1) / step * step, mask.cols, CV_8UC1)};
+    for (int y = 0; y < repeated.rows; y++)
+    {
+        std::copy(mask.ptr<uint8_t>(y - y % step), mask.ptr<uint8_t>(y - y % step) + mask.cols, repeated.ptr<uint8_t>(y));
+    }
+    return repeated;
+}
+
+// Bounding boxes of the outer contours; findContours may change its input and,
+// before OpenCV 3.4, ignores the pixels at the border of the image.
+std::vector<Box> externalContoursOf(const cv::Mat &mask)
+{
+    cv::Mat image{mask.clone()};
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(image, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    std::vector<Box> boxes;
+    for (const auto &contour : contours)
+    {
+        const cv::Rect r{cv::boundingRect(contour)};
+        boxes.push_back(Box{r.x, r.y, r.width, r.height, 0});
+    }
+    std::sort(boxes.begin(), boxes.end());
+    return boxes;
+}
+
+void setPixel(cv::Mat &mask, int x, int y)
+{
+    if ((x >= 1) && (y >= 1) && (x + 1 < mask.cols) && (y + 1 < mask.rows))
+    {
+        mask.at<uint8_t>(y, x) = 255;
+    }
+}
+
+// Shapes that stress the merging of runs: diagonal chains, blobs touching
+// only at a corner, U and comb shapes whose prongs only meet in their last
+// row, rings with blobs in their holes, and random rectangles and noise. The
+// border of the mask stays empty for findContours.
+cv::Mat syntheticMask(std::mt19937 &generator, int width, int height)
+{
+    cv::Mat mask{cv::Mat::zeros(height, width, CV_8UC1)};
+    std::uniform_int_distribution<int> x{0, width - 1};
+    std::uniform_int_distribution<int> y{0, height - 1};
+    std::uniform_int_distribution<int> length{1, 40};
+    std::uniform_int_distribution<int> shape{0, 6};
+    for (int i = 0; i < 12; i++)
+    {
+        const int x0{x(generator)};
+        const int y0{y(generator)};
+        const int w{length(generator)};
+        const int h{length(generator)};
+        switch (shape(generator))
+        {
+        case 0:
+            // Diagonal and anti-diagonal chains.
+            for (int k = 0; k < w; k++)
+            {
+                setPixel(mask, x0 + k, y0 + k);
+                setPixel(mask, x0 + w - k, y0 + k);
+            }
+            break;
+        case 1:
+            // Two squares touching at a corner.
+            for (int k = 0; k < 9; k++)
+            {
+                setPixel(mask, x0 + k % 3, y0 + k / 3);
+                setPixel(mask, x0 + 3 + k % 3, y0 + 3 + k / 3);
+            }
+            break;
+        case 2:
+            // U shape, and the comb of a W.
+            for (int k = 0; k <= h; k++)
+            {
+                for (int prong = 0; prong <= w; prong += ((0 == i % 2) ? std::max(w, 1) : 4))
+                {
+                    setPixel(mask, x0 + prong, y0 + k);
+                }
+            }
+            for (int k = 0; k <= w; k++)
+            {
+                setPixel(mask, x0 + k, y0 + h);
+            }
+            break;
+        case 3:
+            // Ring with a blob in its hole.
+            for (int k = 0; k <= w + 4; k++)
+            {
+                setPixel(mask, x0 + k, y0);
+                setPixel(mask, x0 + k, y0 + h + 4);
+            }
+            for (int k = 0; k <= h + 4; k++)
+            {
+                setPixel(mask, x0, y0 + k);
+                setPixel(mask, x0 + w + 4, y0 + k);
+            }
+            for (int k = 0; k < w * h; k++)
+            {
+                setPixel(mask, x0 + 2 + k % w, y0 + 2 + k / w);
+            }
+            break;
+        case 4:
+            // Noise.
+            for (int k = 0; k < w * h; k++)
+            {
+                if (0 == generator() % 3)
+                {
+                    setPixel(mask, x0 + k % w, y0 + k / w);
+                }
+            }
+            break;
+        default:
+            for (int k = 0; k < w * h; k++)
+            {
+                setPixel(mask, x0 + k % w, y0 + k / w);
+            }
+            break;
+        }
+    }
+    return mask;
+}
+
+// With a rowStep, only every rowStep-th row is labelled and each stands for
+// rowStep rows, which is what connectedComponentsWithStats finds when the rows
+// are repeated. The seed is fixed, so that a failure can be reproduced.
+TEST_CASE("labelRuns matches connectedComponentsWithStats on synthetic masks.")
+{
+    std::mt19937 generator{20220514};
+    for (size_t round = 0; round < 300; round++)
+    {
+        const cv::Mat yellow{syntheticMask(generator, 160, 120)};
+        const cv::Mat blue{(0 == round % 4) ? yellow.clone() : syntheticMask(generator, 160, 120)};
+        for (const uint32_t rowStep : {1u, 2u, 4u})
+        {
+            INFO("round " << round << ", rowStep " << rowStep);
+            RunList runs;
+            runsFromMasks(yellow, blue, rowStep, runs);
+            const BlobList blobs{labelRuns(runs, rowStep)};
+            REQUIRE(componentsOf(repeatRows(yellow, rowStep)) == boxesOf(blobs, ConeColour::Yellow));
+            REQUIRE(componentsOf(repeatRows(blue, rowStep)) == boxesOf(blobs, ConeColour::Blue));
+        }
+    }
+}
+
+// labelRuns also reports the blobs in the holes of other blobs, which findContours with RETR_EXTERNAL skips.
+TEST_CASE("labelRuns reports the outer contours of findContours and the blobs inside them.")
+{
+    std::mt19937 generator{20220514};
+    for (size_t round = 0; round < 300; round++)
+    {
+        const cv::Mat mask{syntheticMask(generator, 160, 120)};
+        RunList runs;
+        runsFromMasks(mask, cv::Mat::zeros(mask.rows, mask.cols, CV_8UC1), 1, runs);
+        const std::vector<Box> blobs{boxesOf(labelRuns(runs), ConeColour::Yellow)};
+        std::vector<Box> outer{externalContoursOf(mask)};
+
+        INFO("round " << round);
+        std::vector<Box> nested;
+        for (Box box : blobs)
+        {
+            box[4] = 0;
+            auto match = std::find(outer.begin(), outer.end(), box);
+            if (outer.end() != match)
+            {
+                outer.erase(match);
+            }
+            else
+            {
+                nested.push_back(box);
+            }
+        }
+        REQUIRE(outer.empty());
+        for (const Box &box : nested)
+        {
+            const bool inside{std::any_of(blobs.begin(), blobs.end(),
+                                          [&box](const Box &b)
+                                          { return (b[0] < box[0]) && (b[1] < box[1]) && (b[0] + b[2] > box[0] + box[2]) && (b[1] + b[3] > box[1] + box[3]); })};
+            REQUIRE(inside);
+        }
+    }
+}
+
+// Cones crossing the edges of the horizon and of the hood end up as the same
+// blobs as with the black rectangles the frame loop painted before.
+TEST_CASE("ConeSegmenter and labelRuns match the OpenCV path across the blanked regions.")
+{
+    const cv::Scalar YELLOW{150, 200, 210, 255};
+    const cv::Scalar BLUE{200, 80, 20, 255};
+    std::mt19937 generator{20220514};
+    for (const cv::Size size : {cv::Size(640, 480), cv::Size(1280, 720)})
+    {
+        cv::Mat frame(size.height, size.width, CV_8UC4);
+        cv::rectangle(frame, cv::Point(0, 0), cv::Point(size.width - 1, size.height - 1), cv::Scalar(128, 128, 128, 255), CV_FILLED);
+        // Across the bottom and the right edge of the horizon.
+        cv::rectangle(frame, cv::Point(20, 240), cv::Point(40, 270), YELLOW, CV_FILLED);
+        cv::rectangle(frame, cv::Point(630, 200), cv::Point(700, 260), BLUE, CV_FILLED);
+        cv::rectangle(frame, cv::Point(600, 245), cv::Point(660, 251), YELLOW, CV_FILLED);
+        // A U around the hood, and cones across its left, top, right and bottom edge.
+        cv::rectangle(frame, cv::Point(140, 380), cv::Point(145, 505), BLUE, CV_FILLED);
+        cv::rectangle(frame, cv::Point(505, 380), cv::Point(510, 505), BLUE, CV_FILLED);
+        cv::rectangle(frame, cv::Point(140, 502), cv::Point(510, 505), BLUE, CV_FILLED);
+        cv::rectangle(frame, cv::Point(145, 400), cv::Point(155, 420), YELLOW, CV_FILLED);
+        cv::rectangle(frame, cv::Point(300, 380), cv::Point(320, 390), YELLOW, CV_FILLED);
+        cv::rectangle(frame, cv::Point(495, 430), cv::Point(504, 440), YELLOW, CV_FILLED);
+        cv::rectangle(frame, cv::Point(250, 495), cv::Point(260, 501), YELLOW, CV_FILLED);
+        // Noise in cone colours over the whole frame.
+        std::uniform_int_distribution<int> x{0, size.width - 1};
+        std::uniform_int_distribution<int> y{0, size.height - 1};
+        for (int i = 0; i < 20000; i++)
+        {
+            const cv::Point p{x(generator), y(generator)};
+            cv::rectangle(frame, p, p, (0 == i % 2) ? YELLOW : BLUE, CV_FILLED);
+        }
+
+        cv::Mat yellow;
+        cv::Mat blue;
+        segmentWithOpenCV(frame, yellow, blue);
+        ConeSegmenter segmenter{static_cast<uint32_t>(size.width), static_cast<uint32_t>(size.height), ChannelLayout::BGRA, DEFAULT_THRESHOLDS};
+        for (const uint32_t rowStep : {1u, 2u, 4u})
+        {
+            INFO(segmenter.description() << ", rowStep " << rowStep);
+            RunList runs;
+            segmenter.segment(frame.data, runs, rowStep);
+            RunList expected;
+            runsFromMasks(yellow, blue, rowStep, expected);
+            REQUIRE(expected == runs);
+
+            const BlobList blobs{labelRuns(runs, rowStep)};
+            REQUIRE(componentsOf(repeatRows(yellow, rowStep)) == boxesOf(blobs, ConeColour::Yellow));
+            REQUIRE(componentsOf(repeatRows(blue, rowStep)) == boxesOf(blobs, ConeColour::Blue));
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEST_CONE_MASKS_HPP
+#define TEST_CONE_MASKS_HPP
+
+#include "cone-runs.hpp"
+#include "cone-segmentation.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <cstdint>
+#include <initializer_list>
+
+// The cone masks as the frame loop computed them with OpenCV before the
+// segmentation kernels replaced it: the horizon and the hood are painted
+// black, then the frame is thresholded in HSV.
+inline void segmentWithOpenCV(const cv::Mat &frame, cv::Mat &yellow, cv::Mat &blue)
+{
+    cv::Mat img{frame.clone()};
+    cv::rectangle(img, cv::Point(150, 385), cv::Point(500, 500), cv::Scalar(0, 0, 0), CV_FILLED);
+    cv::rectangle(img, cv::Point(0, 0), cv::Point(650, 250), cv::Scalar(0, 0, 0), CV_FILLED);
+
+    cv::Mat hsv;
+    cv::cvtColor(img, hsv, cv::COLOR_BGR2HSV);
+    cv::Mat yellowLow;
+    cv::inRange(hsv, cv::Scalar(12, 20, 20), cv::Scalar(70, 100, 250), yellow);
+    cv::inRange(hsv, cv::Scalar(8, 20, 20), cv::Scalar(11, 100, 250), yellowLow);
+    cv::inRange(hsv, cv::Scalar(80, 125, 8), cv::Scalar(135, 255, 210), blue);
+    yellow = yellow | yellowLow;
+}
+
+// Runs of every rowStep-th row of the masks (CV_8UC1, non-zero for cone
+// pixels) in the order the segmentation kernels emit them.
+inline void runsFromMasks(const cv::Mat &yellow, const cv::Mat &blue, uint32_t rowStep, RunList &runs)
+{
+    runs.clear();
+    for (int y = 0; y < yellow.rows; y += static_cast<int>(rowStep))
+    {
+        for (const cv::Mat *mask : {&yellow, &blue})
+        {
+            const ConeColour colour{(mask == &yellow) ? ConeColour::Yellow : ConeColour::Blue};
+            const uint8_t *row = mask->ptr<uint8_t>(y);
+            for (int x = 0; x < mask->cols;)
+            {
+                if (0 == row[x])
+                {
+                    x++;
+                    continue;
+                }
+                const int start{x};
+                while ((x < mask->cols) && (0 != row[x]))
+                {
+                    x++;
+                }
+                runs.push_back(ConeRun{static_cast<uint16_t>(y), static_cast<uint16_t>(start), static_cast<uint16_t>(x), colour});
+            }
+        }
+    }
+}
+
+inline bool operator==(const ConeRun &a, const ConeRun &b)
+{
+    return (a.row == b.row) && (a.start == b.start) && (a.end == b.end) && (a.colour == b.colour);
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cone-segmentation.hpp"
+#include "cpu-features.hpp"
+#include "test-cone-masks.hpp"
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Instruction sets the running CPU can execute: the kernel variants below the best one run as well on x86.
+std::vector<CpuIsa> supportedCpuIsas()
+{
+    const CpuIsa best{detectCpuIsa()};
+    std::vector<CpuIsa> isas{CpuIsa::Generic};
+    if (CpuIsa::NEON == best)
+    {
+        isas.push_back(CpuIsa::NEON);
+    }
+    else
+    {
+        for (CpuIsa isa : {CpuIsa::SSE42, CpuIsa::AVX2, CpuIsa::AVX512})
+        {
+            if (static_cast<int>(isa) <= static_cast<int>(best))
+            {
+                isas.push_back(isa);
+            }
+        }
+    }
+    return isas;
+}
+
+using Bgr = std::array<uint8_t, 3>;
+
+// BGR colours whose hue, saturation or value lies on a bound of the default thresholds or next to it.
+std::vector<Bgr> thresholdBoundaryColours(std::mt19937 &generator)
+{
+    std::vector<int> hues;
+    std::vector<int> saturations;
+    std::vector<int> values;
+    for (const HsvRange &r : {DEFAULT_THRESHOLDS.yellow, DEFAULT_THRESHOLDS.yellowLow, DEFAULT_THRESHOLDS.blue})
+    {
+        for (int d : {-1, 0, 1})
+        {
+            hues.insert(hues.end(), {r.hLow + d, r.hHigh + d});
+            saturations.insert(saturations.end(), {r.sLow + d, r.sHigh + d});
+            values.insert(values.end(), {r.vLow + d, r.vHigh + d});
+        }
+    }
+    auto onBound = [](const std::vector<int> &bounds, int x)
+    {
+        for (int b : bounds)
+        {
+            if (b == x)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<Bgr> colours;
+    cv::Mat bgr(1, 1, CV_8UC3);
+    cv::Mat hsv;
+    while (colours.size() < 4096)
+    {
+        const Bgr colour{{static_cast<uint8_t>(generator()), static_cast<uint8_t>(generator()), static_cast<uint8_t>(generator())}};
+        std::copy(colour.begin(), colour.end(), bgr.ptr<uint8_t>(0));
+        cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+        const uint8_t *p = hsv.ptr<uint8_t>(0);
+        if (onBound(hues, p[0]) || onBound(saturations, p[1]) || onBound(values, p[2]))
+        {
+            colours.push_back(colour);
+        }
+    }
+    return colours;
+}
+
+// Random pixels with random alpha, every other one taken from the colours on the threshold bounds.
+cv::Mat randomFrame(std::mt19937 &generator, const std::vector<Bgr> &boundaryColours, int width, int height)
+{
+    std::uniform_int_distribution<size_t> pick{0, boundaryColours.size() - 1};
+    cv::Mat frame(height, width, CV_8UC4);
+    for (int y = 0; y < height; y++)
+    {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < width; x++)
+        {
+            const uint32_t r{static_cast<uint32_t>(generator())};
+            const Bgr c{(0 == (r & 1)) ? boundaryColours[pick(generator)] : Bgr{{static_cast<uint8_t>(r >> 8), static_cast<uint8_t>(r >> 16), static_cast<uint8_t>(r >> 24)}}};
+            row[4 * x + 0] = c[0];
+            row[4 * x + 1] = c[1];
+            row[4 * x + 2] = c[2];
+            row[4 * x + 3] = static_cast<uint8_t>(r);
+        }
+    }
+    return frame;
+}
+
+// Every kernel of every instruction set this CPU runs must find the cone
+// pixels of cvtColor and inRange exactly. The seed is fixed, so that a
+// failure can be reproduced.
+TEST_CASE("Segmentation kernels match cvtColor and inRange on random frames.")
+{
+    std::mt19937 generator{20220514};
+    const std::vector<Bgr> boundaryColours{thresholdBoundaryColours(generator)};
+    const RuntimeThresholds thresholds{DEFAULT_THRESHOLDS};
+    struct Format
+    {
+        int width;
+        int height;
+    };
+    // The specialised sizes, and one the generic kernels have to handle with partial vectors.
+    for (const Format format : {Format{640, 480}, Format{1280, 720}, Format{667, 389}})
+    {
+        const RuntimeGeometry geometry{static_cast<uint32_t>(format.width), static_cast<uint32_t>(format.height)};
+        for (size_t round = 0; round < 2; round++)
+        {
+            const cv::Mat frame{randomFrame(generator, boundaryColours, format.width, format.height)};
+            cv::Mat bgrFrame;
+            cv::cvtColor(frame, bgrFrame, cv::COLOR_BGRA2BGR);
+            cv::Mat yellow;
+            cv::Mat blue;
+            segmentWithOpenCV(frame, yellow, blue);
+
+            for (CpuIsa isa : supportedCpuIsas())
+            {
+                CpuIsa used{isa};
+                const SegmentationKernels kernels{selectSegmentationKernels(used)};
+                REQUIRE(isa == used);
+                for (const uint32_t rowStep : {1u, 2u, 4u})
+                {
+                    INFO(format.width << "x" << format.height << ", round " << round << ", " << cpuIsaName(isa) << ", rowStep " << rowStep);
+                    RunList expected;
+                    runsFromMasks(yellow, blue, rowStep, expected);
+                    RunList runs;
+                    RunList rowScratch;
+
+                    if ((640 == format.width) && (480 == format.height))
+                    {
+                        kernels.bgra640x480(geometry, thresholds, frame.data, rowStep, runs, rowScratch);
+                        REQUIRE(expected == runs);
+                    }
+                    if ((1280 == format.width) && (720 == format.height))
+                    {
+                        kernels.bgra1280x720(geometry, thresholds, frame.data, rowStep, runs, rowScratch);
+                        REQUIRE(expected == runs);
+                    }
+                    kernels.genericBGRA(geometry, thresholds, frame.data, rowStep, runs, rowScratch);
+                    REQUIRE(expected == runs);
+                    kernels.genericBGR(geometry, thresholds, bgrFrame.data, rowStep, runs, rowScratch);
+                    REQUIRE(expected == runs);
+                }
+            }
+        }
+    }
+}
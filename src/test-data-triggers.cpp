@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using DataTriggerTable = cluon::OD4Session::DataTriggerTable;
+using Key = std::pair<int32_t, int64_t>;
+
+// Delegates that tell which key they were registered for.
+std::map<Key, cluon::OD4Session::Delegate> delegatesFor(const std::vector<Key> &keys, Key &called)
+{
+    std::map<Key, cluon::OD4Session::Delegate> delegates;
+    for (const Key &key : keys)
+    {
+        delegates[key] = [&called, key](cluon::data::Envelope &&) { called = key; };
+    }
+    return delegates;
+}
+
+// The slot must hold the key and the delegate registered for it.
+void requireSlotFor(const DataTriggerTable::Slot *slot, const Key &key, Key &called)
+{
+    REQUIRE(nullptr != slot);
+    REQUIRE(key.first == slot->m_dataType);
+    REQUIRE(key.second == slot->m_senderStamp);
+    called = Key{0, 0};
+    slot->m_delegate(cluon::data::Envelope{});
+    REQUIRE(key == called);
+}
+
+TEST_CASE("DataTriggerTable prefers the delegate for the sender over the one for any sender.")
+{
+    const int64_t ANY{cluon::OD4Session::ANY_SENDER};
+    Key called;
+    const DataTriggerTable table{delegatesFor({{10, ANY}, {10, 7}, {11, 7}, {12, 0}}, called), {}};
+    REQUIRE(!table.empty());
+    requireSlotFor(table.find(10, 7), Key{10, 7}, called);
+    requireSlotFor(table.find(10, 8), Key{10, ANY}, called);
+    requireSlotFor(table.find(10, 0), Key{10, ANY}, called);
+    requireSlotFor(table.find(11, 7), Key{11, 7}, called);
+    requireSlotFor(table.find(12, 0), Key{12, 0}, called);
+    // Neither for the sender nor for any sender.
+    REQUIRE(nullptr == table.find(11, 8));
+    REQUIRE(nullptr == table.find(12, 1));
+    REQUIRE(nullptr == table.find(13, 7));
+    // The sender stamp 0xFFFFFFFF is a sender, not ANY_SENDER.
+    REQUIRE(nullptr == table.find(11, 0xFFFFFFFFu));
+
+    const DataTriggerTable empty{{}, {}};
+    REQUIRE(empty.empty());
+    REQUIRE(nullptr == empty.find(10, 7));
+}
+
+// Keys whose probe sequences start at the last slot wrap around to the first
+// one; a key with the same start that is not in the table ends at the first
+// free slot behind them.
+TEST_CASE("DataTriggerTable probes colliding keys.")
+{
+    Key called;
+    const size_t CAPACITY{DataTriggerTable{delegatesFor({{1, 1}, {2, 1}, {3, 1}, {4, 1}}, called), {}}.capacity()};
+    REQUIRE(8 == CAPACITY);
+    for (size_t start : {CAPACITY - 1, size_t{0}, size_t{3}})
+    {
+        INFO("probing from slot " << start);
+        std::vector<Key> colliding;
+        for (int32_t dataType = 0; colliding.size() < 5; dataType++)
+        {
+            for (int64_t senderStamp = 0; (senderStamp < 3) && (colliding.size() < 5); senderStamp++)
+            {
+                if (start == (DataTriggerTable::hash(dataType, senderStamp) & (CAPACITY - 1)))
+                {
+                    colliding.push_back(Key{dataType, senderStamp});
+                }
+            }
+        }
+        const Key absent{colliding.back()};
+        colliding.pop_back();
+
+        const DataTriggerTable table{delegatesFor(colliding, called), {}};
+        REQUIRE(CAPACITY == table.capacity());
+        for (const Key &key : colliding)
+        {
+            INFO("key " << key.first << "/" << key.second);
+            requireSlotFor(table.find(key.first, static_cast<uint32_t>(key.second)), key, called);
+        }
+        REQUIRE(nullptr == table.find(absent.first, static_cast<uint32_t>(absent.second)));
+    }
+}
+
+TEST_CASE("DataTriggerTable finds every one of many keys and none of the others.")
+{
+    std::mt19937 generator{20220514};
+    std::uniform_int_distribution<int32_t> dataType{-2000, 2000};
+    std::uniform_int_distribution<int64_t> senderStamp{-1, 50};
+    std::set<Key> keys;
+    while (keys.size() < 1000)
+    {
+        keys.insert(Key{dataType(generator), senderStamp(generator)});
+    }
+    Key called;
+    const DataTriggerTable table{delegatesFor(std::vector<Key>(keys.begin(), keys.end()), called), {}};
+    REQUIRE(2 * keys.size() <= table.capacity());
+    for (size_t i = 0; i < 20000; i++)
+    {
+        const int32_t t{dataType(generator)};
+        const uint32_t s{static_cast<uint32_t>(senderStamp(generator) + 1)};
+        INFO("key " << t << "/" << s);
+        const DataTriggerTable::Slot *slot{table.find(t, s)};
+        if (0 != keys.count(Key{t, s}))
+        {
+            requireSlotFor(slot, Key{t, s}, called);
+        }
+        else if (0 != keys.count(Key{t, cluon::OD4Session::ANY_SENDER}))
+        {
+            requireSlotFor(slot, Key{t, cluon::OD4Session::ANY_SENDER}, called);
+        }
+        else
+        {
+            REQUIRE(nullptr == slot);
+        }
+    }
+}
+
+// Envelopes per sender stamp as the delegates of one dataType received them.
+struct Deliveries
+{
+    std::atomic<uint32_t> forSender[3]{};
+    std::atomic<uint32_t> forAnySender{0};
+    std::atomic<uint32_t> flushed{0};
+};
+
+// A second session sends to the tested one, which drops what it sent itself;
+// a PlayerCommand sent last marks when all Envelopes sent before were
+// dispatched. Both need a route for multicast, e.g. on the loopback device.
+class LoopbackSession
+{
+  public:
+    explicit LoopbackSession(uint16_t cid)
+        : m_deliveries{}, m_od4{cid}, m_sender{cid}
+    {
+        m_od4.dataTrigger(cluon::data::PlayerCommand::ID(), [this](cluon::data::Envelope &&) { m_deliveries.flushed++; });
+    }
+
+    cluon::OD4Session &od4()
+    {
+        return m_od4;
+    }
+
+    Deliveries &deliveries()
+    {
+        return m_deliveries;
+    }
+
+    void sendFrom(uint32_t senderStamp, size_t count)
+    {
+        cluon::data::TimeStamp message;
+        message.seconds(static_cast<int32_t>(senderStamp));
+        for (size_t i = 0; i < count; i++)
+        {
+            m_sender.send(message, cluon::data::TimeStamp{}, senderStamp);
+        }
+    }
+
+    bool flush()
+    {
+        const uint32_t before{m_deliveries.flushed.load()};
+        cluon::data::PlayerCommand marker;
+        m_sender.send(marker);
+        const auto deadline{std::chrono::steady_clock::now() + std::chrono::seconds(1)};
+        while ((before == m_deliveries.flushed.load()) && (std::chrono::steady_clock::now() < deadline))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return (before != m_deliveries.flushed.load());
+    }
+
+    // Sends five Envelopes from each of the senders 0 .. 2 and counts where they ended up.
+    void exchange(uint32_t (&forSender)[3], uint32_t &forAnySender)
+    {
+        for (auto &d : m_deliveries.forSender)
+        {
+            d.store(0);
+        }
+        m_deliveries.forAnySender.store(0);
+        for (uint32_t senderStamp = 0; senderStamp < 3; senderStamp++)
+        {
+            sendFrom(senderStamp, 5);
+        }
+        REQUIRE(flush());
+        for (uint32_t senderStamp = 0; senderStamp < 3; senderStamp++)
+        {
+            forSender[senderStamp] = m_deliveries.forSender[senderStamp].load();
+        }
+        forAnySender = m_deliveries.forAnySender.load();
+    }
+
+  private:
+    // Constructed before the delegates can run.
+    Deliveries m_deliveries;
+    cluon::OD4Session m_od4;
+    cluon::OD4Session m_sender;
+};
+
+// Each delegate counts the Envelopes of its key and checks that they come from its sender.
+cluon::OD4Session::Delegate countFrom(std::atomic<uint32_t> &count, uint32_t senderStamp)
+{
+    return [&count, senderStamp](cluon::data::Envelope &&envelope)
+    {
+        const uint32_t sender{envelope.senderStamp()};
+        const cluon::data::TimeStamp message{cluon::extractMessage<cluon::data::TimeStamp>(std::move(envelope))};
+        if ((senderStamp == sender) && (static_cast<int32_t>(senderStamp) == message.seconds()))
+        {
+            count++;
+        }
+    };
+}
+
+TEST_CASE("OD4Session::dataTrigger removes only the delegate of its own message identifier and sender stamp.")
+{
+    LoopbackSession session{static_cast<uint16_t>(200 + (::getpid() % 50))};
+    REQUIRE(session.od4().isRunning());
+    REQUIRE(session.flush());
+    Deliveries &d = session.deliveries();
+    const int32_t ID{cluon::data::TimeStamp::ID()};
+    uint32_t forSender[3];
+    uint32_t forAnySender{0};
+
+    // Unregistered senders reach no delegate.
+    REQUIRE(session.od4().dataTrigger(ID, 1u, countFrom(d.forSender[1], 1)));
+    session.exchange(forSender, forAnySender);
+    REQUIRE(0 == forSender[0]);
+    REQUIRE(5 == forSender[1]);
+    REQUIRE(0 == forSender[2]);
+    REQUIRE(0 == forAnySender);
+
+    // The delegate for sender 1 takes precedence over the one for any sender.
+    std::atomic<uint32_t> &anySender = d.forAnySender;
+    REQUIRE(session.od4().dataTrigger(ID, [&anySender](cluon::data::Envelope &&) { anySender++; }));
+    REQUIRE(session.od4().dataTrigger(ID, 2u, countFrom(d.forSender[2], 2)));
+    session.exchange(forSender, forAnySender);
+    REQUIRE(0 == forSender[0]);
+    REQUIRE(5 == forSender[1]);
+    REQUIRE(5 == forSender[2]);
+    REQUIRE(5 == forAnySender);
+
+    // Removing the delegate for sender 1 leaves those for sender 2 and any sender.
+    REQUIRE(session.od4().dataTrigger(ID, 1u, nullptr));
+    session.exchange(forSender, forAnySender);
+    REQUIRE(0 == forSender[1]);
+    REQUIRE(5 == forSender[2]);
+    REQUIRE(10 == forAnySender);
+
+    // Removing the delegate for any sender leaves the one for sender 2.
+    REQUIRE(session.od4().dataTrigger(ID, nullptr));
+    session.exchange(forSender, forAnySender);
+    REQUIRE(0 == forSender[0]);
+    REQUIRE(0 == forSender[1]);
+    REQUIRE(5 == forSender[2]);
+    REQUIRE(0 == forAnySender);
+
+    // Removing a delegate that was never set changes nothing.
+    REQUIRE(session.od4().dataTrigger(ID, 0u, nullptr));
+    REQUIRE(session.od4().dataTrigger(ID + 1, 2u, nullptr));
+    session.exchange(forSender, forAnySender);
+    REQUIRE(5 == forSender[2]);
+    REQUIRE(0 == forAnySender);
+
+    REQUIRE(session.od4().dataTrigger(ID, 2u, nullptr));
+    session.exchange(forSender, forAnySender);
+    REQUIRE(0 == forSender[2]);
+    REQUIRE(0 == forAnySender);
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "detection-fusion.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+ConeDetections detectionsAt(int64_t sampleTimeStamp, int yellow, int blue)
+{
+    ConeDetections detections;
+    detections.sampleTimeStamp = sampleTimeStamp;
+    detections.amountOfYellowCones = yellow;
+    detections.amountOfBlueCones = blue;
+    detections.largestYellow = ConeBlob{static_cast<int32_t>(yellow), 10, 20, 30, 600, ConeColour::Yellow};
+    detections.largestBlue = ConeBlob{static_cast<int32_t>(blue), 40, 50, 60, 3000, ConeColour::Blue};
+    return detections;
+}
+
+const std::chrono::microseconds NO_WAIT{0};
+
+// Secondary detections count when they are less than 100 ms apart from the
+// primary frame, before or after it; the boxes stay those of the primary camera.
+TEST_CASE("DetectionFusion sums the cones of the other camera within 100 ms of the primary frame.")
+{
+    const int64_t WINDOW{DetectionFusion::FUSION_WINDOW_US};
+    const int64_t PRIMARY{1652515200000000};
+    for (int64_t distance : {int64_t{0}, int64_t{1}, int64_t{-1}, WINDOW - 1, -WINDOW + 1, WINDOW, -WINDOW, WINDOW + 1, -WINDOW - 1, 5 * WINDOW, -5 * WINDOW})
+    {
+        INFO("secondary frame " << distance << " us from the primary one");
+        DetectionFusion fusion{2};
+        fusion.submit(1, detectionsAt(PRIMARY + distance, 10, 20));
+        fusion.submit(0, detectionsAt(PRIMARY, 1, 2));
+        ConeDetections fused;
+        REQUIRE(fusion.waitForPrimary(NO_WAIT, fused));
+        const bool within{(distance < WINDOW) && (distance > -WINDOW)};
+        REQUIRE(PRIMARY == fused.sampleTimeStamp);
+        REQUIRE((within ? 11 : 1) == fused.amountOfYellowCones);
+        REQUIRE((within ? 22 : 2) == fused.amountOfBlueCones);
+        REQUIRE(1 == fused.largestYellow.x);
+        REQUIRE(600u == fused.largestYellow.pixels);
+        REQUIRE(2 == fused.largestBlue.x);
+        REQUIRE(3000u == fused.largestBlue.pixels);
+    }
+
+    // A camera that has not submitted yet does not keep the others from being summed.
+    DetectionFusion fusion{3};
+    fusion.submit(2, detectionsAt(30000, 100, 200));
+    fusion.submit(0, detectionsAt(0, 1, 2));
+    ConeDetections fused;
+    REQUIRE(fusion.waitForPrimary(NO_WAIT, fused));
+    REQUIRE(101 == fused.amountOfYellowCones);
+    REQUIRE(202 == fused.amountOfBlueCones);
+}
+
+// The primary camera at 30 Hz, the secondary one at 20 Hz and 10 ms behind;
+// their frames arrive in the order of their time stamps. Each primary frame
+// yields one fused frame with the latest secondary one, until the secondary
+// camera stops and its last frame falls out of the window.
+TEST_CASE("DetectionFusion yields one fused frame per primary frame of staggered cameras.")
+{
+    const int64_t PRIMARY_PERIOD{33333};
+    const int64_t SECONDARY_PERIOD{50000};
+    const int64_t SECONDARY_OFFSET{10000};
+    const int64_t SECONDARY_STOPS{1000000};
+    const int64_t END{2000000};
+    const int64_t WINDOW{DetectionFusion::FUSION_WINDOW_US};
+
+    DetectionFusion fusion{2};
+    ConeDetections fused;
+    int64_t nextPrimary{0};
+    int64_t nextSecondary{SECONDARY_OFFSET};
+    int64_t latestSecondary{-1};
+    int primaryFrames{0};
+    int summed{0};
+    while (nextPrimary < END)
+    {
+        if ((nextSecondary < nextPrimary) && (nextSecondary < SECONDARY_STOPS))
+        {
+            const int cones{static_cast<int>(nextSecondary / SECONDARY_PERIOD) + 1};
+            fusion.submit(1, detectionsAt(nextSecondary, cones, 2 * cones));
+            latestSecondary = nextSecondary;
+            nextSecondary += SECONDARY_PERIOD;
+            // The secondary camera alone does not yield a fused frame.
+            REQUIRE_FALSE(fusion.waitForPrimary(NO_WAIT, fused));
+            continue;
+        }
+        INFO("primary frame at " << nextPrimary << " us");
+        fusion.submit(0, detectionsAt(nextPrimary, 1000, 2000));
+        REQUIRE(fusion.waitForPrimary(NO_WAIT, fused));
+        REQUIRE(nextPrimary == fused.sampleTimeStamp);
+        const int cones{(0 <= latestSecondary) && (nextPrimary - latestSecondary < WINDOW) ? static_cast<int>(latestSecondary / SECONDARY_PERIOD) + 1 : 0};
+        REQUIRE((1000 + cones) == fused.amountOfYellowCones);
+        REQUIRE((2000 + 2 * cones) == fused.amountOfBlueCones);
+        summed += (0 < cones) ? 1 : 0;
+        // One fused frame per primary frame.
+        REQUIRE_FALSE(fusion.waitForPrimary(NO_WAIT, fused));
+        primaryFrames++;
+        nextPrimary += PRIMARY_PERIOD;
+    }
+    REQUIRE(61 == primaryFrames);
+    // The primary frames from 33333 us, after the first secondary frame, to
+    // 1033323 us, less than 100 ms after the last one at 960000 us.
+    REQUIRE(31 == summed);
+}
+
+// Primary frames that arrive faster than they are fused are coalesced into
+// the latest one, fused with the secondary frames of its time.
+TEST_CASE("DetectionFusion fuses only the latest of several pending primary frames.")
+{
+    DetectionFusion fusion{2};
+    fusion.submit(0, detectionsAt(0, 1, 2));
+    fusion.submit(1, detectionsAt(50000, 10, 20));
+    fusion.submit(0, detectionsAt(200000, 3, 4));
+    fusion.submit(1, detectionsAt(210000, 30, 40));
+    ConeDetections fused;
+    REQUIRE(fusion.waitForPrimary(NO_WAIT, fused));
+    REQUIRE(200000 == fused.sampleTimeStamp);
+    REQUIRE(33 == fused.amountOfYellowCones);
+    REQUIRE(44 == fused.amountOfBlueCones);
+    REQUIRE_FALSE(fusion.waitForPrimary(std::chrono::milliseconds(20), fused));
+}
+
+// The waiter sleeps through frames of the secondary camera and wakes up for
+// the primary one; the camera thread only reports through atomics.
+TEST_CASE("DetectionFusion wakes up its waiter only for the primary camera.")
+{
+    DetectionFusion fusion{2};
+    std::atomic<bool> secondarySubmitted{false};
+    std::thread camera(
+        [&fusion, &secondarySubmitted]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            fusion.submit(1, detectionsAt(90000, 10, 20));
+            secondarySubmitted.store(true);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            fusion.submit(0, detectionsAt(100000, 1, 2));
+        });
+    const auto start{std::chrono::steady_clock::now()};
+    ConeDetections fused;
+    const bool woken{fusion.waitForPrimary(std::chrono::seconds(5), fused)};
+    const auto waited{std::chrono::steady_clock::now() - start};
+    camera.join();
+    REQUIRE(woken);
+    REQUIRE(secondarySubmitted.load());
+    REQUIRE(std::chrono::milliseconds(100) <= waited);
+    REQUIRE(100000 == fused.sampleTimeStamp);
+    REQUIRE(11 == fused.amountOfYellowCones);
+    REQUIRE(22 == fused.amountOfBlueCones);
+}
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// An Envelope as extractEnvelope returns it, and where it starts and ends in the input.
+struct ExpectedEnvelope
+{
+    cluon::data::Envelope envelope;
+    uint64_t offset;
+    uint64_t position;
+};
+
+cluon::data::TimeStamp randomTimeStamp(std::mt19937 &generator)
+{
+    return cluon::data::TimeStamp{}.seconds(static_cast<int32_t>(generator())).microseconds(static_cast<int32_t>(generator() % 1000000));
+}
+
+// Envelopes of random dataTypes and time stamps; most payloads are small, some
+// exceed the buffer of a stream reader, and some are empty.
+std::vector<std::string> randomEnvelopes(std::mt19937 &generator, size_t count)
+{
+    std::uniform_int_distribution<size_t> smallSize{0, 300};
+    std::uniform_int_distribution<size_t> largeSize{70000, 200000};
+    std::vector<std::string> envelopes;
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t size{(0 == i % 50) ? largeSize(generator) : ((0 == i % 7) ? 0 : smallSize(generator))};
+        std::string payload(size, '\0');
+        for (char &c : payload)
+        {
+            c = static_cast<char>(generator());
+        }
+        cluon::data::Envelope envelope;
+        envelope.dataType(static_cast<int32_t>(generator()))
+            .serializedData(payload)
+            .sent(randomTimeStamp(generator))
+            .received(randomTimeStamp(generator))
+            .sampleTimeStamp(randomTimeStamp(generator))
+            .senderStamp(static_cast<uint32_t>(generator()));
+        envelopes.push_back(cluon::serializeEnvelope(std::move(envelope)));
+    }
+    return envelopes;
+}
+
+// What extractEnvelope finds in the input; offsets and positions are taken with tellg.
+std::vector<ExpectedEnvelope> extractAll(const std::string &input)
+{
+    std::vector<ExpectedEnvelope> expected;
+    std::istringstream in(input);
+    while (true)
+    {
+        const uint64_t offset{static_cast<uint64_t>(in.tellg())};
+        std::pair<bool, cluon::data::Envelope> extracted{cluon::extractEnvelope(in)};
+        if (!extracted.first)
+        {
+            break;
+        }
+        expected.push_back(ExpectedEnvelope{extracted.second, offset, static_cast<uint64_t>(in.tellg())});
+    }
+    return expected;
+}
+
+void requireSameEnvelope(cluon::data::Envelope expected, cluon::data::Envelope actual)
+{
+    REQUIRE(expected.dataType() == actual.dataType());
+    REQUIRE(expected.serializedData() == actual.serializedData());
+    REQUIRE(expected.sent().seconds() == actual.sent().seconds());
+    REQUIRE(expected.sent().microseconds() == actual.sent().microseconds());
+    REQUIRE(expected.received().seconds() == actual.received().seconds());
+    REQUIRE(expected.received().microseconds() == actual.received().microseconds());
+    REQUIRE(expected.sampleTimeStamp().seconds() == actual.sampleTimeStamp().seconds());
+    REQUIRE(expected.sampleTimeStamp().microseconds() == actual.sampleTimeStamp().microseconds());
+    REQUIRE(expected.senderStamp() == actual.senderStamp());
+}
+
+// Takes every Envelope the reader has and compares it with the next expected one.
+void requireNextEnvelopes(cluon::EnvelopeReader &reader, const std::vector<ExpectedEnvelope> &expected, size_t &read)
+{
+    cluon::EnvelopeView view;
+    while (reader.next(view))
+    {
+        INFO("Envelope " << read);
+        REQUIRE(read < expected.size());
+        requireSameEnvelope(expected[read].envelope, view.envelope());
+        REQUIRE(expected[read].offset == reader.offset());
+        REQUIRE(expected[read].position == reader.position());
+        read++;
+    }
+}
+
+// Reads the input from a stream, from memory and appended in random chunks.
+void requireReadersFind(const std::string &input, const std::vector<ExpectedEnvelope> &expected, uint64_t skippedBytes, std::mt19937 &generator)
+{
+    for (size_t bufferSize : {size_t{16}, size_t{1000}, size_t{64 * 1024}})
+    {
+        INFO("stream with a buffer of " << bufferSize << " bytes");
+        std::istringstream in(input);
+        cluon::EnvelopeReader reader(in, bufferSize);
+        size_t read{0};
+        requireNextEnvelopes(reader, expected, read);
+        REQUIRE(expected.size() == read);
+        REQUIRE(skippedBytes == reader.skippedBytes());
+    }
+    {
+        INFO("memory");
+        cluon::EnvelopeReader reader(input.data(), input.size());
+        size_t read{0};
+        requireNextEnvelopes(reader, expected, read);
+        REQUIRE(expected.size() == read);
+        REQUIRE(skippedBytes == reader.skippedBytes());
+    }
+    for (size_t maxChunk : {size_t{1}, size_t{7}, size_t{5000}})
+    {
+        INFO("appended in chunks of up to " << maxChunk << " bytes");
+        std::uniform_int_distribution<size_t> chunkSize{1, maxChunk};
+        cluon::EnvelopeReader reader;
+        size_t read{0};
+        for (size_t begin = 0; begin < input.size();)
+        {
+            const size_t size{std::min(chunkSize(generator), input.size() - begin)};
+            reader.append(input.data() + begin, size);
+            begin += size;
+            requireNextEnvelopes(reader, expected, read);
+        }
+        REQUIRE(expected.size() == read);
+        REQUIRE(skippedBytes == reader.skippedBytes());
+    }
+}
+
+TEST_CASE("EnvelopeReader returns the Envelopes of extractEnvelope from streams, memory and appended chunks.")
+{
+    std::mt19937 generator{20220514};
+    std::string input;
+    for (const std::string &envelope : randomEnvelopes(generator, 200))
+    {
+        input += envelope;
+    }
+    const std::vector<ExpectedEnvelope> expected{extractAll(input)};
+    REQUIRE(200 == expected.size());
+    REQUIRE(input.size() == expected.back().position);
+    requireReadersFind(input, expected, 0, generator);
+}
+
+// Bytes that cannot start an OD4 header are skipped; the offsets still count
+// from the beginning of the input.
+TEST_CASE("EnvelopeReader skips garbage before the OD4 header.")
+{
+    std::mt19937 generator{20220514};
+    std::uniform_int_distribution<size_t> garbageSize{0, 40};
+    std::string input;
+    std::vector<ExpectedEnvelope> expected;
+    uint64_t skippedBytes{0};
+    for (const std::string &envelope : randomEnvelopes(generator, 100))
+    {
+        const size_t size{garbageSize(generator)};
+        for (size_t i = 0; i < size; i++)
+        {
+            // 0x0D would start a header.
+            const char c{static_cast<char>(generator())};
+            input += (0x0D == static_cast<uint8_t>(c)) ? '\0' : c;
+        }
+        skippedBytes += size;
+        std::istringstream in(envelope);
+        expected.push_back(ExpectedEnvelope{cluon::extractEnvelope(in).second, input.size(), input.size() + envelope.size()});
+        input += envelope;
+    }
+    // The last four bytes could still begin a header and are kept for more input.
+    const std::string TRAILER{"\xA4garbage at the end"};
+    input += TRAILER;
+    skippedBytes += TRAILER.size() - 4;
+    requireReadersFind(input, expected, skippedBytes, generator);
+}
+
+// An Envelope cut off anywhere, also within its header, is not returned; when
+// appending, it is returned once the rest of it was appended.
+TEST_CASE("EnvelopeReader does not return a truncated last Envelope.")
+{
+    std::mt19937 generator{20220514};
+    const std::vector<std::string> envelopes{randomEnvelopes(generator, 4)};
+    std::string complete;
+    for (size_t i = 1; i < envelopes.size(); i++)
+    {
+        complete += envelopes[i];
+    }
+    const std::vector<ExpectedEnvelope> expected{extractAll(complete)};
+    REQUIRE(3 == expected.size());
+    const std::string &last = envelopes[1];
+    REQUIRE(5 < last.size());
+
+    for (size_t cut = 1; cut < last.size(); cut += (cut < 10) ? 1 : 97)
+    {
+        INFO("last Envelope cut after " << cut << " of " << last.size() << " bytes");
+        const std::string input{complete + last.substr(0, cut)};
+        REQUIRE(expected.size() == extractAll(input).size());
+        requireReadersFind(input, expected, 0, generator);
+
+        cluon::EnvelopeReader reader;
+        size_t read{0};
+        reader.append(input.data(), input.size());
+        requireNextEnvelopes(reader, expected, read);
+        REQUIRE(expected.size() == read);
+        reader.append(last.data() + cut, last.size() - cut);
+        cluon::EnvelopeView view;
+        REQUIRE(reader.next(view));
+        std::istringstream in(last);
+        requireSameEnvelope(cluon::extractEnvelope(in).second, view.envelope());
+        REQUIRE(complete.size() == reader.offset());
+        REQUIRE(complete.size() + last.size() == reader.position());
+        REQUIRE(!reader.next(view));
+    }
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "frame-arena.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <utility>
+#include <vector>
+
+uintptr_t address(const void *p)
+{
+    return reinterpret_cast<uintptr_t>(p);
+}
+
+// A frame of 64, 128 and 200 bytes needs three blocks starting from 64
+// bytes; after reset() the 448 bytes of all blocks are one block, so that the
+// same frame is laid out contiguously and stays at the same place from then on.
+TEST_CASE("FrameArena merges its blocks into one on reset.")
+{
+    FrameArena arena{64};
+    const size_t SIZES[]{64, 128, 200};
+    std::vector<void *> firstFrame;
+    for (size_t size : SIZES)
+    {
+        firstFrame.push_back(arena.allocate(size, 1));
+    }
+    // The second and third allocations did not fit into the block before.
+    REQUIRE(address(firstFrame[1]) != address(firstFrame[0]) + 64);
+    REQUIRE(address(firstFrame[2]) != address(firstFrame[1]) + 128);
+    REQUIRE(392 == arena.highWater());
+
+    arena.reset();
+    void *base{nullptr};
+    for (size_t frame = 0; frame < 3; frame++)
+    {
+        INFO("frame " << frame << " after the merge");
+        size_t offset{0};
+        void *first{nullptr};
+        for (size_t size : SIZES)
+        {
+            void *p{arena.allocate(size, 1)};
+            first = (nullptr == first) ? p : first;
+            REQUIRE(address(first) + offset == address(p));
+            std::memset(p, static_cast<int>(frame), size);
+            offset += size;
+        }
+        // The remaining 56 bytes of the merged block are used before a new one is added.
+        void *rest{arena.allocate(56, 1)};
+        REQUIRE(address(first) + offset == address(rest));
+        base = (nullptr == base) ? first : base;
+        REQUIRE(base == first);
+        arena.reset();
+    }
+    REQUIRE(448 == arena.highWater());
+
+    // A frame larger than the merged block grows the arena again, and the next reset merges once more.
+    void *large{arena.allocate(1000, 1)};
+    REQUIRE(address(large) != address(base));
+    arena.reset();
+    void *first{arena.allocate(448, 1)};
+    void *second{arena.allocate(1000, 1)};
+    REQUIRE(address(first) + 448 == address(second));
+}
+
+// Allocations of random sizes and alignments are aligned and do not overlap,
+// within blocks as well as across new ones.
+TEST_CASE("FrameArena aligns allocations and never hands out a byte twice in a frame.")
+{
+    std::mt19937 generator{20220514};
+    std::uniform_int_distribution<size_t> size{0, 3000};
+    std::uniform_int_distribution<size_t> alignmentShift{0, 12};
+    FrameArena arena{256};
+    size_t highWater{0};
+    for (size_t frame = 0; frame < 20; frame++)
+    {
+        std::vector<std::pair<uintptr_t, size_t>> allocations;
+        size_t used{0};
+        for (size_t i = 0; i < 100; i++)
+        {
+            const size_t bytes{size(generator)};
+            const size_t alignment{size_t{1} << alignmentShift(generator)};
+            INFO("frame " << frame << ", " << bytes << " bytes aligned to " << alignment);
+            const uintptr_t p{address(arena.allocate(bytes, alignment))};
+            REQUIRE(0 == p % alignment);
+            std::memset(reinterpret_cast<void *>(p), static_cast<int>(i), bytes);
+            allocations.push_back(std::make_pair(p, bytes));
+            used += bytes;
+        }
+        std::sort(allocations.begin(), allocations.end());
+        for (size_t i = 1; i < allocations.size(); i++)
+        {
+            REQUIRE(allocations[i - 1].first + allocations[i - 1].second <= allocations[i].first);
+        }
+        highWater = std::max(highWater, used);
+        REQUIRE(highWater == arena.highWater());
+        arena.reset();
+    }
+}
+
+// Containers on an arena allocate from it; without an arena, or with a
+// default-constructed allocator, they use the heap and free what they allocated.
+TEST_CASE("ArenaAllocator falls back to the heap without an arena.")
+{
+    FrameArena arena{1024};
+    {
+        ArenaVector<int64_t> onArena{ArenaAllocator<int64_t>{&arena}};
+        for (int64_t i = 0; i < 1000; i++)
+        {
+            onArena.push_back(i);
+        }
+        REQUIRE(0 == address(onArena.data()) % alignof(int64_t));
+        REQUIRE(999 == onArena.back());
+    }
+    const size_t usedOnArena{arena.highWater()};
+    REQUIRE(1000 * sizeof(int64_t) <= usedOnArena);
+
+    for (const ArenaAllocator<int64_t> &allocator : {ArenaAllocator<int64_t>{}, ArenaAllocator<int64_t>{nullptr}})
+    {
+        REQUIRE(nullptr == allocator.arena());
+        ArenaVector<int64_t> onHeap{allocator};
+        for (int64_t i = 0; i < 100000; i++)
+        {
+            onHeap.push_back(i);
+        }
+        REQUIRE(99999 == onHeap.back());
+        ArenaVector<int64_t> copy{onHeap};
+        REQUIRE(onHeap == copy);
+        onHeap.clear();
+        onHeap.shrink_to_fit();
+    }
+    // Nothing of the heap containers went to the arena.
+    REQUIRE(usedOnArena == arena.highWater());
+
+    // Rebound allocators keep their arena and compare by it.
+    const ArenaAllocator<int64_t> a{&arena};
+    const ArenaAllocator<char> b{a};
+    FrameArena other{64};
+    REQUIRE(&arena == b.arena());
+    REQUIRE(a == b);
+    REQUIRE_FALSE(a != b);
+    REQUIRE(a != ArenaAllocator<char>{&other});
+    REQUIRE(ArenaAllocator<int64_t>{} == ArenaAllocator<char>{nullptr});
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "frame-pacing.hpp"
+
+#include <opencv2/core/core.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+TEST_CASE("parseQueueLength accepts 1 to MAX_QUEUE_LENGTH frames only.")
+{
+    const size_t maxQueueLength{MAX_QUEUE_LENGTH};
+    size_t length{3};
+    REQUIRE(parseQueueLength("1", length));
+    REQUIRE(1 == length);
+    REQUIRE(parseQueueLength(std::to_string(maxQueueLength), length));
+    REQUIRE(maxQueueLength == length);
+    REQUIRE(parseQueueLength("08", length));
+    REQUIRE(8 == length);
+    REQUIRE_FALSE(parseQueueLength(std::to_string(maxQueueLength + 1), length));
+    for (const char *text : {"", "0", "-1", "+2", " 2", "2 ", "2x", "0x10", "3.5", "99999999999999999999"})
+    {
+        INFO("'" << text << "'");
+        REQUIRE_FALSE(parseQueueLength(text, length));
+        REQUIRE(8 == length);
+    }
+}
+
+// Value of a counter in FrameStatistics::summary(), e.g. "dropped".
+uint64_t counter(const FrameStatistics &statistics, const std::string &name)
+{
+    const std::string summary{";" + statistics.summary()};
+    const size_t begin{summary.find(";" + name + "=") + name.size() + 2};
+    return std::stoull(summary.substr(begin, summary.find(';', begin) - begin));
+}
+
+TEST_CASE("FrameStatistics counts the frames missing between sample numbers.")
+{
+    constexpr int64_t PERIOD{33333};
+    FrameStatistics statistics;
+    REQUIRE(0 == statistics.period());
+    for (uint32_t n = 1; n <= 5; n++)
+    {
+        REQUIRE(statistics.observe(1000000 + n * PERIOD, n));
+    }
+    REQUIRE(PERIOD == statistics.period());
+    REQUIRE(0 == counter(statistics, "dropped"));
+
+    // Numbers 6 .. 8 were never seen; the time stamps do not matter once numbered.
+    REQUIRE(statistics.observe(1000000 + 9 * PERIOD, 9));
+    REQUIRE(3 == counter(statistics, "dropped"));
+    REQUIRE(statistics.observe(1000000 + 10 * PERIOD + 1, 10));
+    REQUIRE(3 == counter(statistics, "dropped"));
+
+    // The same number again is a duplicate, even with a new time stamp.
+    REQUIRE_FALSE(statistics.observe(1000000 + 11 * PERIOD, 10));
+    REQUIRE(1 == counter(statistics, "duplicates"));
+
+    // A restarted producer counts from 1 again without dropping frames.
+    REQUIRE(statistics.observe(5000000, 1));
+    REQUIRE(statistics.observe(5000000 + PERIOD, 2));
+    REQUIRE(3 == counter(statistics, "dropped"));
+    REQUIRE(1 == counter(statistics, "duplicates"));
+}
+
+TEST_CASE("FrameStatistics estimates the dropped frames from gaps in the sample times.")
+{
+    constexpr int64_t PERIOD{33333};
+    FrameStatistics statistics;
+    int64_t t{1000000};
+    REQUIRE(statistics.observe(t));
+    REQUIRE(0 == statistics.period());
+    t += PERIOD;
+    REQUIRE(statistics.observe(t));
+    REQUIRE(PERIOD == statistics.period());
+
+    // A repeated time stamp is a duplicate and leaves the period.
+    REQUIRE_FALSE(statistics.observe(t));
+    REQUIRE_FALSE(statistics.observe(t));
+    REQUIRE(2 == counter(statistics, "duplicates"));
+    REQUIRE(PERIOD == statistics.period());
+
+    // 1.5 periods is jitter, which moves the period by an eighth of the difference.
+    t += PERIOD + PERIOD / 2;
+    REQUIRE(statistics.observe(t));
+    REQUIRE(0 == counter(statistics, "dropped"));
+    REQUIRE(PERIOD + (PERIOD / 2) / 8 == statistics.period());
+    const int64_t period{statistics.period()};
+
+    // Three periods hide two frames and leave the period as it was.
+    t += 3 * period;
+    REQUIRE(statistics.observe(t));
+    REQUIRE(2 == counter(statistics, "dropped"));
+    REQUIRE(period == statistics.period());
+    t += 2 * period - period / 3;
+    REQUIRE(statistics.observe(t));
+    REQUIRE(3 == counter(statistics, "dropped"));
+
+    // Going back in time (a restarted recording) neither drops frames nor changes the period.
+    t -= 100 * period;
+    REQUIRE(statistics.observe(t));
+    REQUIRE(3 == counter(statistics, "dropped"));
+    REQUIRE(period == statistics.period());
+
+    statistics.countProcessed();
+    statistics.countOverflow();
+    statistics.countOverflow();
+    statistics.countTorn();
+    REQUIRE(("processed=1;dropped=3;duplicates=2;overflows=2;torn=1;period=" + std::to_string(period)) == statistics.summary());
+}
+
+cv::Mat frameOf(uint8_t value)
+{
+    cv::Mat frame(4, 8, CV_8UC4);
+    for (int y = 0; y < frame.rows; y++)
+    {
+        uint8_t *row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < 4 * frame.cols; x++)
+        {
+            row[x] = value;
+        }
+    }
+    return frame;
+}
+
+bool frameIs(const cv::Mat &frame, uint8_t value)
+{
+    bool retVal{(4 == frame.rows) && (8 == frame.cols)};
+    for (int y = 0; retVal && (y < frame.rows); y++)
+    {
+        const uint8_t *row = frame.ptr<uint8_t>(y);
+        for (int x = 0; retVal && (x < 4 * frame.cols); x++)
+        {
+            retVal = (value == row[x]);
+        }
+    }
+    return retVal;
+}
+
+TEST_CASE("FrameQueue drops the oldest frame when it is full.")
+{
+    REQUIRE(1 == FrameQueue{0}.capacity());
+    FrameQueue queue{3};
+    REQUIRE(3 == queue.capacity());
+    for (uint8_t i = 1; i <= 3; i++)
+    {
+        REQUIRE(queue.push(frameOf(i), i));
+    }
+    REQUIRE_FALSE(queue.push(frameOf(4), 4));
+    REQUIRE_FALSE(queue.push(frameOf(5), 5));
+
+    cv::Mat img;
+    int64_t sampleTimeStamp{0};
+    for (uint8_t i = 3; i <= 5; i++)
+    {
+        REQUIRE(queue.pop(img, sampleTimeStamp, std::chrono::milliseconds(0)));
+        REQUIRE(i == sampleTimeStamp);
+        REQUIRE(frameIs(img, i));
+    }
+    const auto start{std::chrono::steady_clock::now()};
+    REQUIRE_FALSE(queue.pop(img, sampleTimeStamp, std::chrono::milliseconds(20)));
+    REQUIRE(std::chrono::milliseconds(20) <= std::chrono::steady_clock::now() - start);
+    REQUIRE(5 == sampleTimeStamp);
+    REQUIRE(frameIs(img, 5));
+}
+
+// In the steady state, the copies go into the images handed back by pop(),
+// recycled, or taken from a dropped frame.
+TEST_CASE("FrameQueue copies into recycled images.")
+{
+    FrameQueue queue{1};
+    cv::Mat spare(4, 8, CV_8UC4);
+    const uint8_t *spareData{spare.data};
+    queue.recycle(std::move(spare));
+    REQUIRE(queue.push(frameOf(1), 1));
+
+    cv::Mat img(4, 8, CV_8UC4);
+    const uint8_t *imgData{img.data};
+    int64_t sampleTimeStamp{0};
+    REQUIRE(queue.pop(img, sampleTimeStamp, std::chrono::milliseconds(0)));
+    REQUIRE(spareData == img.data);
+    REQUIRE(frameIs(img, 1));
+
+    // The image img held before goes into the next copy.
+    REQUIRE(queue.push(frameOf(2), 2));
+    // The frame dropped for the next one leaves its image to it.
+    REQUIRE_FALSE(queue.push(frameOf(3), 3));
+    REQUIRE(queue.pop(img, sampleTimeStamp, std::chrono::milliseconds(0)));
+    REQUIRE(3 == sampleTimeStamp);
+    REQUIRE(imgData == img.data);
+    REQUIRE(frameIs(img, 3));
+
+    for (uint8_t i = 4; i < 20; i++)
+    {
+        REQUIRE(queue.push(frameOf(i), i));
+        REQUIRE(queue.pop(img, sampleTimeStamp, std::chrono::milliseconds(0)));
+        REQUIRE(((spareData == img.data) || (imgData == img.data)));
+        REQUIRE(frameIs(img, i));
+    }
+}
+
+// Feeds the governor the same processing time until it reaches the row step; returns the number of updates.
+size_t updatesUntil(QualityGovernor &governor, uint32_t rowStep, int64_t processingTime, int64_t period)
+{
+    size_t updates{0};
+    while ((rowStep != governor.rowStep()) && (updates < 100))
+    {
+        governor.update(std::chrono::microseconds(processingTime), period);
+        updates++;
+    }
+    return updates;
+}
+
+TEST_CASE("QualityGovernor coarsens the row step while frames take too long and refines it when they are fast again.")
+{
+    constexpr int64_t PERIOD{33333};
+    const uint32_t maxRowStep{QualityGovernor::MAX_ROW_STEP};
+    QualityGovernor governor;
+    REQUIRE(1 == governor.rowStep());
+
+    // Without a period, nothing changes.
+    for (size_t i = 0; i < 20; i++)
+    {
+        governor.update(std::chrono::microseconds(10 * PERIOD), 0);
+    }
+    REQUIRE(1 == governor.rowStep());
+
+    // Frames taking 1.2 periods: every second, then every fourth row, but no coarser.
+    const size_t toTwo{updatesUntil(governor, 2, 12 * PERIOD / 10, PERIOD)};
+    REQUIRE(1 <= toTwo);
+    REQUIRE(10 >= toTwo);
+    const size_t toFour{updatesUntil(governor, maxRowStep, 12 * PERIOD / 10, PERIOD)};
+    REQUIRE(1 <= toFour);
+    REQUIRE(10 >= toFour);
+    for (size_t i = 0; i < 50; i++)
+    {
+        governor.update(std::chrono::microseconds(12 * PERIOD / 10), PERIOD);
+        REQUIRE(maxRowStep == governor.rowStep());
+    }
+
+    // Between 0.4 and 0.9 periods, the row step is kept.
+    for (size_t i = 0; i < 50; i++)
+    {
+        governor.update(std::chrono::microseconds(6 * PERIOD / 10), PERIOD);
+        REQUIRE(maxRowStep == governor.rowStep());
+    }
+
+    // Frames taking 0.2 periods: back to every second, then every row.
+    const size_t backToTwo{updatesUntil(governor, 2, 2 * PERIOD / 10, PERIOD)};
+    REQUIRE(1 <= backToTwo);
+    REQUIRE(10 >= backToTwo);
+    const size_t backToOne{updatesUntil(governor, 1, 2 * PERIOD / 10, PERIOD)};
+    REQUIRE(1 <= backToOne);
+    REQUIRE(10 >= backToOne);
+    for (size_t i = 0; i < 50; i++)
+    {
+        governor.update(std::chrono::microseconds(2 * PERIOD / 10), PERIOD);
+        REQUIRE(1 == governor.rowStep());
+    }
+}
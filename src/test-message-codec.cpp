@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+#include "opendlv-standard-message-set.hpp"
+#include "test-messages.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+template <typename T>
+std::string encodeWithVisitor(T &message)
+{
+    cluon::ToProtoVisitor encoder;
+    message.accept(encoder);
+    return encoder.encodedData();
+}
+
+template <typename T>
+T decodeWithVisitor(const std::string &data)
+{
+    std::stringstream buffer(data);
+    cluon::FromProtoVisitor decoder;
+    decoder.decodeFrom(buffer);
+    T message;
+    message.accept(decoder);
+    return message;
+}
+
+// Offsets at which a field of the given Proto data ends, including 0.
+std::set<size_t> fieldBoundaries(const std::string &data)
+{
+    auto varInt = [&data](size_t &i)
+    {
+        uint64_t value{0};
+        for (uint32_t shift = 0; (i < data.size()); shift += 7)
+        {
+            const uint8_t byte{static_cast<uint8_t>(data[i++])};
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (0 == (byte & 0x80))
+            {
+                break;
+            }
+        }
+        return value;
+    };
+    std::set<size_t> boundaries{0};
+    size_t i{0};
+    while (i < data.size())
+    {
+        const uint64_t key{varInt(i)};
+        switch (key & 0x7)
+        {
+        case 0:
+            varInt(i);
+            break;
+        case 1:
+            i += 8;
+            break;
+        case 2:
+            i += varInt(i);
+            break;
+        case 5:
+            i += 4;
+            break;
+        }
+        boundaries.insert(i);
+    }
+    return boundaries;
+}
+
+// Random values favouring the extremes, which need the longest varints.
+testdata::AllScalars randomAllScalars(std::mt19937_64 &generator)
+{
+    std::uniform_int_distribution<uint32_t> shift{0, 70};
+    auto value = [&generator, &shift]()
+    {
+        const uint32_t s{shift(generator)};
+        return (s < 64) ? (generator() >> s) : ((s & 1) ? UINT64_MAX : 0);
+    };
+    testdata::AllScalars message;
+    message.b(0 != (value() & 1))
+        .c(static_cast<char>(value()))
+        .i8(static_cast<int8_t>(value()))
+        .u8(static_cast<uint8_t>(value()))
+        .i16(static_cast<int16_t>(value()))
+        .u16(static_cast<uint16_t>(value()))
+        .i32(static_cast<int32_t>(value()))
+        .u32(static_cast<uint32_t>(value()))
+        .i64(static_cast<int64_t>(value()))
+        .u64(value());
+    const uint32_t floatBits{static_cast<uint32_t>(value())};
+    const uint64_t doubleBits{value()};
+    float f;
+    double d;
+    std::memcpy(&f, &floatBits, sizeof(f));
+    std::memcpy(&d, &doubleBits, sizeof(d));
+    message.f(f).d(d);
+    return message;
+}
+
+// The fixed-layout codec generated by cluon-msc must write the bytes of
+// ToProtoVisitor and read what FromProtoVisitor reads. The seed is fixed, so
+// that a failure can be reproduced.
+TEST_CASE("encodeTo and decodeFrom match the Proto visitors on random messages.")
+{
+    std::mt19937_64 generator{20220514};
+    for (size_t round = 0; round < 20000; round++)
+    {
+        testdata::AllScalars message{randomAllScalars(generator)};
+        const std::string expected{encodeWithVisitor(message)};
+        INFO("round " << round);
+
+        char buffer[testdata::AllScalars::MAX_ENCODED_SIZE];
+        const size_t size{message.encodeTo(buffer, sizeof(buffer))};
+        REQUIRE(expected == std::string(buffer, size));
+
+        testdata::AllScalars decoded;
+        REQUIRE(decoded.decodeFrom(expected.data(), expected.size()));
+        REQUIRE(expected == encodeWithVisitor(decoded));
+
+        testdata::AllScalars decodedWithVisitor{decodeWithVisitor<testdata::AllScalars>(std::string(buffer, size))};
+        REQUIRE(expected == encodeWithVisitor(decodedWithVisitor));
+    }
+
+    opendlv::proxy::VoltageReading voltage;
+    voltage.voltage(0.0123f);
+    char buffer[opendlv::proxy::VoltageReading::MAX_ENCODED_SIZE];
+    const size_t size{voltage.encodeTo(buffer, sizeof(buffer))};
+    REQUIRE(encodeWithVisitor(voltage) == std::string(buffer, size));
+    REQUIRE(0 == voltage.encodeTo(buffer, sizeof(buffer) - 1));
+}
+
+// Data cut within a field is rejected; data cut between two fields is a
+// message without the remaining fields. A copy of exactly the given size is
+// decoded, so that reading beyond it shows up under a memory checker.
+TEST_CASE("decodeFrom rejects data cut within a field.")
+{
+    std::mt19937_64 generator{20220514};
+    for (size_t round = 0; round < 2000; round++)
+    {
+        testdata::AllScalars message{randomAllScalars(generator)};
+        const std::string data{encodeWithVisitor(message)};
+        const std::set<size_t> boundaries{fieldBoundaries(data)};
+        for (size_t size = 0; size <= data.size(); size++)
+        {
+            const std::vector<char> truncated(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(size));
+            testdata::AllScalars decoded;
+            INFO("round " << round << ", " << size << " of " << data.size() << " bytes");
+            REQUIRE((0 != boundaries.count(size)) == decoded.decodeFrom(truncated.data(), truncated.size()));
+        }
+    }
+}
+
+// Fields the message does not know, including those of another wire type
+// like a string, are skipped.
+TEST_CASE("decodeFrom skips unknown fields.")
+{
+    testdata::WithString withString;
+    withString.f(3.5f).s("a string that is not a float");
+    const std::string data{encodeWithVisitor(withString)};
+
+    opendlv::proxy::VoltageReading voltage;
+    REQUIRE(voltage.decodeFrom(data.data(), data.size()));
+    REQUIRE(0.0f >= voltage.voltage());
+    REQUIRE(0.0f <= voltage.voltage());
+
+    testdata::AllScalars allScalars;
+    REQUIRE(allScalars.decodeFrom(data.data(), data.size()));
+    REQUIRE(3.5f <= allScalars.f());
+    REQUIRE(3.5f >= allScalars.f());
+    REQUIRE_FALSE(allScalars.decodeFrom(data.data(), data.size() - 1));
+}
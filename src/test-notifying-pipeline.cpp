@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+// Entry of a producer: its index and a number counting up from 0.
+using Entry = std::pair<uint32_t, uint32_t>;
+
+// Collects the entries the delegate got; the delegate blocks while closed.
+struct Sink
+{
+    std::mutex mutex{};
+    std::vector<Entry> entries{};
+    std::atomic<bool> open{true};
+    std::atomic<uint32_t> entered{0};
+
+    void take(Entry &&entry)
+    {
+        entered++;
+        while (!open.load())
+        {
+            std::this_thread::yield();
+        }
+        std::lock_guard<std::mutex> lck(mutex);
+        entries.push_back(entry);
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lck(mutex);
+        return entries.size();
+    }
+
+    // Waits up to a second for the given number of entries.
+    bool waitFor(size_t count)
+    {
+        const auto deadline{std::chrono::steady_clock::now() + std::chrono::seconds(1)};
+        while ((size() < count) && (std::chrono::steady_clock::now() < deadline))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return size() >= count;
+    }
+};
+
+void waitUntilEntered(Sink &sink, uint32_t count)
+{
+    while (sink.entered.load() < count)
+    {
+        std::this_thread::yield();
+    }
+}
+} // namespace
+
+// Below the capacity nothing is dropped, and the entries of every producer
+// arrive in the order they were added; nobody calls notifyAll().
+TEST_CASE("NotifyingPipeline delivers the entries of several producers in order.")
+{
+    constexpr uint32_t PRODUCERS{4};
+    constexpr uint32_t ENTRIES{1000};
+    Sink sink;
+    cluon::NotifyingPipeline<Entry> pipeline{[&sink](Entry &&e) { sink.take(std::move(e)); }, PRODUCERS * ENTRIES};
+
+    std::vector<std::thread> producers;
+    std::atomic<uint32_t> rejected{0};
+    for (uint32_t p = 0; p < PRODUCERS; p++)
+    {
+        producers.emplace_back(
+            [&pipeline, &rejected, p]()
+            {
+                for (uint32_t n = 0; n < ENTRIES; n++)
+                {
+                    rejected += pipeline.add(Entry{p, n}) ? 0 : 1;
+                }
+            });
+    }
+    for (auto &t : producers)
+    {
+        t.join();
+    }
+    REQUIRE(sink.waitFor(PRODUCERS * ENTRIES));
+    REQUIRE(0 == rejected.load());
+    REQUIRE(0 == pipeline.overflows());
+
+    std::vector<uint32_t> next(PRODUCERS, 0);
+    for (const Entry &e : sink.entries)
+    {
+        REQUIRE(e.first < PRODUCERS);
+        REQUIRE(next[e.first] == e.second);
+        next[e.first]++;
+    }
+}
+
+// A sleeping delegate's thread is woken by add() itself: without it, an
+// entry would wait for the 100 ms time-out of the sleep.
+TEST_CASE("NotifyingPipeline::add wakes the sleeping delegate's thread.")
+{
+    Sink sink;
+    cluon::NotifyingPipeline<Entry> pipeline{[&sink](Entry &&e) { sink.take(std::move(e)); }};
+    std::vector<std::chrono::steady_clock::duration> latencies;
+    for (uint32_t n = 0; n < 9; n++)
+    {
+        // Long enough for the thread to stop spinning and sleep.
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        const auto before{std::chrono::steady_clock::now()};
+        REQUIRE(pipeline.add(Entry{0, n}));
+        REQUIRE(sink.waitFor(n + 1));
+        latencies.push_back(std::chrono::steady_clock::now() - before);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    REQUIRE(std::chrono::milliseconds(50) > latencies[latencies.size() / 2]);
+}
+
+// With the delegate busy, the ring of four cells fills up and every further
+// entry is dropped and counted; the ones in the ring are still delivered.
+TEST_CASE("NotifyingPipeline drops and counts the entries that do not fit.")
+{
+    Sink sink;
+    sink.open.store(false);
+    cluon::NotifyingPipeline<Entry> pipeline{[&sink](Entry &&e) { sink.take(std::move(e)); }, 4};
+    REQUIRE(pipeline.add(Entry{0, 0}));
+    waitUntilEntered(sink, 1);
+    for (uint32_t n = 1; n <= 4; n++)
+    {
+        REQUIRE(pipeline.add(Entry{0, n}));
+    }
+    REQUIRE(0 == pipeline.overflows());
+    for (uint32_t n = 5; n < 8; n++)
+    {
+        REQUIRE_FALSE(pipeline.add(Entry{0, n}));
+    }
+    REQUIRE(3 == pipeline.overflows());
+
+    sink.open.store(true);
+    REQUIRE(sink.waitFor(5));
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE(5 == sink.size());
+    for (uint32_t n = 0; n < 5; n++)
+    {
+        REQUIRE(n == sink.entries[n].second);
+    }
+}
+
+// As for TCP, add() waits for room instead of dropping; the waits are counted as overflows.
+TEST_CASE("NotifyingPipeline waits for room when asked to.")
+{
+    constexpr uint32_t ENTRIES{10};
+    Sink sink;
+    sink.open.store(false);
+    cluon::NotifyingPipeline<Entry> pipeline{[&sink](Entry &&e) { sink.take(std::move(e)); }, 4, true};
+    std::atomic<uint32_t> added{0};
+    std::thread producer{[&pipeline, &added]()
+                         {
+                             for (uint32_t n = 0; n < ENTRIES; n++)
+                             {
+                                 added += pipeline.add(Entry{0, n}) ? 1 : 0;
+                             }
+                         }};
+
+    // One entry is with the delegate and four are in the ring; the sixth has to wait.
+    waitUntilEntered(sink, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(5 == added.load());
+    REQUIRE(0 < pipeline.overflows());
+
+    sink.open.store(true);
+    producer.join();
+    REQUIRE(ENTRIES == added.load());
+    REQUIRE(sink.waitFor(ENTRIES));
+    for (uint32_t n = 0; n < ENTRIES; n++)
+    {
+        REQUIRE(n == sink.entries[n].second);
+    }
+}
+
+// Destroying the pipeline wakes its sleeping thread instead of waiting for the time-out.
+TEST_CASE("NotifyingPipeline shuts down while its thread sleeps.")
+{
+    for (uint32_t round = 0; round < 5; round++)
+    {
+        Sink sink;
+        std::unique_ptr<cluon::NotifyingPipeline<Entry>> pipeline{
+            new cluon::NotifyingPipeline<Entry>{[&sink](Entry &&e) { sink.take(std::move(e)); }}};
+        REQUIRE(pipeline->isRunning());
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        const auto before{std::chrono::steady_clock::now()};
+        pipeline.reset();
+        REQUIRE(std::chrono::milliseconds(90) > std::chrono::steady_clock::now() - before);
+        REQUIRE(0 == sink.size());
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "rcu-value.hpp"
+
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+// Counts the values alive to tell when a replaced value is freed.
+struct Counted
+{
+    explicit Counted(int v)
+        : value{v}
+    {
+        alive++;
+    }
+    Counted(const Counted &other)
+        : value{other.value}
+    {
+        alive++;
+    }
+    Counted &operator=(const Counted &) = default;
+    ~Counted() { alive--; }
+
+    int value;
+    static int alive;
+};
+int Counted::alive{0};
+} // namespace
+
+TEST_CASE("RcuValue frees a replaced value once every reader was quiescent.")
+{
+    RcuValue<Counted> rcu{Counted{1}, 2};
+    RcuValue<Counted>::Reader first{rcu};
+    RcuValue<Counted>::Reader second{rcu};
+    const Counted &seen = rcu.read();
+
+    rcu.publish(std::unique_ptr<Counted>{new Counted{2}});
+    REQUIRE(2 == rcu.read().value);
+    REQUIRE(2 == Counted::alive);
+    REQUIRE(1 == seen.value);
+
+    first.quiescent();
+    rcu.reclaim();
+    REQUIRE(2 == Counted::alive);
+    second.quiescent();
+    rcu.reclaim();
+    REQUIRE(1 == Counted::alive);
+}
+
+TEST_CASE("RcuValue lets a reader that left hold back nothing and reuses its slot.")
+{
+    RcuValue<Counted> rcu{Counted{1}, 1};
+    {
+        RcuValue<Counted>::Reader reader{rcu};
+        rcu.publish(std::unique_ptr<Counted>{new Counted{2}});
+        REQUIRE(2 == Counted::alive);
+
+        // All slots are taken.
+        REQUIRE_THROWS_AS(RcuValue<Counted>::Reader{rcu}, std::length_error);
+    }
+    rcu.reclaim();
+    REQUIRE(1 == Counted::alive);
+
+    RcuValue<Counted>::Reader again{rcu};
+    REQUIRE(rcu.update([](Counted &c) {
+        c.value = 3;
+        return true;
+    }));
+    REQUIRE_FALSE(rcu.update([](Counted &) { return false; }));
+    REQUIRE(3 == rcu.read().value);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "realtime.hpp"
+
+#include <sched.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+TEST_CASE("parseCpuList accepts lists of CPU numbers only.")
+{
+    std::vector<int> cpus;
+    REQUIRE(parseCpuList("3", cpus));
+    REQUIRE((std::vector<int>{3}) == cpus);
+    REQUIRE(parseCpuList("0,2,1", cpus));
+    REQUIRE((std::vector<int>{0, 2, 1}) == cpus);
+    REQUIRE(parseCpuList(std::to_string(CPU_SETSIZE - 1), cpus));
+    REQUIRE((std::vector<int>{CPU_SETSIZE - 1}) == cpus);
+
+    // A rejected list leaves the previous one.
+    for (const std::string &text : {std::string{}, std::string{","}, std::string{"1,"}, std::string{",1"}, std::string{"1,,2"}, std::string{"-1"},
+                                    std::string{"+1"}, std::string{" 1"}, std::string{"1 "}, std::string{"1.0"}, std::string{"0x1"}, std::string{"a"},
+                                    std::string{"12345"}, std::to_string(CPU_SETSIZE)})
+    {
+        INFO("'" << text << "'");
+        REQUIRE(!parseCpuList(text, cpus));
+        REQUIRE((std::vector<int>{CPU_SETSIZE - 1}) == cpus);
+    }
+}
+
+TEST_CASE("parsePriority accepts the SCHED_FIFO priorities only.")
+{
+    int priority{50};
+    REQUIRE(parsePriority("1", priority));
+    REQUIRE(1 == priority);
+    REQUIRE(parsePriority("99", priority));
+    REQUIRE(99 == priority);
+    REQUIRE(parsePriority("07", priority));
+    REQUIRE(7 == priority);
+
+    for (const char *text : {"", "0", "00", "100", "-1", "+5", " 5", "5 ", "5.0", "x", "99999999999999999999"})
+    {
+        INFO("'" << text << "'");
+        REQUIRE(!parsePriority(text, priority));
+        REQUIRE(7 == priority);
+    }
+}
+
+TEST_CASE("WakeLagStatistics::quantile returns the upper bound of the bucket holding the rank.")
+{
+    const int64_t WIDTH{WakeLagStatistics::BUCKET_WIDTH};
+    const int64_t LAST{static_cast<int64_t>(WakeLagStatistics::BUCKETS) * WIDTH};
+
+    WakeLagStatistics empty;
+    REQUIRE(0 == empty.quantile(0.5));
+    REQUIRE(0 == empty.quantile(1.0));
+    REQUIRE("wakeLagMean=0;wakeLagP50=0;wakeLagP99=0;wakeLagMax=0" == empty.summary());
+
+    // 100 lags: 1 .. 100 times the bucket width minus one, i.e. one per bucket.
+    WakeLagStatistics spread;
+    for (int64_t i = 1; i <= 100; i++)
+    {
+        spread.observe(i * WIDTH - 1);
+    }
+    REQUIRE(WIDTH == spread.quantile(0.0));
+    REQUIRE(WIDTH == spread.quantile(0.005));
+    REQUIRE(2 * WIDTH == spread.quantile(0.01));
+    REQUIRE(51 * WIDTH == spread.quantile(0.5));
+    // The last bucket is capped by the largest lag seen.
+    REQUIRE(100 * WIDTH - 1 == spread.quantile(0.99));
+    REQUIRE(100 * WIDTH - 1 == spread.quantile(1.0));
+
+    // Negative lags (a producer clock ahead) count as 0, lags beyond the last bucket in it.
+    WakeLagStatistics clamped;
+    clamped.observe(-50);
+    clamped.observe(-1);
+    clamped.observe(3 * LAST);
+    REQUIRE(WIDTH == clamped.quantile(0.5));
+    REQUIRE(LAST == clamped.quantile(0.99));
+    REQUIRE(3 * LAST == clamped.quantile(1.0));
+    REQUIRE(("wakeLagMean=" + std::to_string(LAST) + ";wakeLagP50=" + std::to_string(WIDTH) + ";wakeLagP99=" + std::to_string(LAST) +
+             ";wakeLagMax=" + std::to_string(3 * LAST)) == clamped.summary());
+
+    // Quantiles in the last bucket report its bound; only the maximum stays exact.
+    WakeLagStatistics tail;
+    for (size_t i = 0; i < 9; i++)
+    {
+        tail.observe(5);
+    }
+    tail.observe(LAST + 7);
+    REQUIRE(WIDTH == tail.quantile(0.5));
+    REQUIRE(WIDTH == tail.quantile(0.89));
+    REQUIRE(LAST == tail.quantile(0.9));
+    REQUIRE(LAST + 7 == tail.quantile(1.0));
+}
@@ -0,0 +1,543 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What the readers found; Catch must only be used from the thread running the test.
+struct SlotFindings
+{
+    std::atomic<uint64_t> borrowed{0};
+    std::atomic<uint64_t> torn{0};
+    std::atomic<uint64_t> changedWhileBorrowed{0};
+    std::atomic<uint64_t> wentBackwards{0};
+    std::atomic<uint64_t> claimedWhileBorrowed{0};
+    std::atomic<uint64_t> noSlotForWriter{0};
+};
+
+// Every word of a sample holds its number, which is also its sample time stamp.
+void fillSample(char *sample, uint32_t size, uint32_t number)
+{
+    for (uint32_t offset = 0; offset + sizeof(number) <= size; offset += sizeof(number))
+    {
+        std::memcpy(sample + offset, &number, sizeof(number));
+    }
+}
+
+bool sampleIs(const char *sample, uint32_t size, uint32_t number)
+{
+    for (uint32_t offset = 0; offset + sizeof(number) <= size; offset += sizeof(number))
+    {
+        uint32_t word;
+        std::memcpy(&word, sample + offset, sizeof(word));
+        if (number != word)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Offset of a slot from the first one; the instances map the area to different addresses.
+std::ptrdiff_t slotOffset(cluon::SharedMemory &sharedMemory, const char *slot)
+{
+    return (nullptr == slot) ? -1 : (slot - sharedMemory.data());
+}
+
+// One writer and the two readers a shared memory area with four slots allows
+// borrow samples as fast as they can. The readers publish the slot they hold,
+// so that the writer can tell whether it was handed a borrowed slot; a slot
+// published late can only hide such a case, never report a false one.
+void exchangeSamples(const std::string &name, SlotFindings &findings)
+{
+    constexpr uint32_t SIZE{64 * 1024};
+    constexpr uint32_t SAMPLES{20000};
+    constexpr size_t READERS{2};
+
+    ::setenv("CLUON_SHAREDMEMORY_SLOTS", "4", 1);
+    cluon::SharedMemory writer{name, SIZE};
+    ::unsetenv("CLUON_SHAREDMEMORY_SLOTS");
+    REQUIRE(writer.valid());
+    REQUIRE(4 == writer.slots());
+
+    std::atomic<bool> writing{true};
+    std::atomic<size_t> attached{0};
+    std::atomic<std::ptrdiff_t> held[READERS];
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < READERS; r++)
+    {
+        held[r].store(-1);
+        readers.emplace_back(
+            [&name, &findings, &writing, &attached, &held, r]()
+            {
+                cluon::SharedMemory reader{name};
+                attached++;
+                uint32_t last{0};
+                while (reader.valid() && writing.load())
+                {
+                    cluon::data::TimeStamp ts;
+                    const char *sample{reader.borrowSlot(ts)};
+                    if (nullptr == sample)
+                    {
+                        continue;
+                    }
+                    held[r].store(slotOffset(reader, sample));
+                    findings.borrowed++;
+                    const uint32_t number{static_cast<uint32_t>(ts.microseconds())};
+                    findings.torn += sampleIs(sample, SIZE, number) ? 0 : 1;
+                    findings.wentBackwards += (number < last) ? 1 : 0;
+                    last = number;
+                    // Give the writer the time to go around all other slots before looking again.
+                    std::this_thread::yield();
+                    findings.changedWhileBorrowed += sampleIs(sample, SIZE, number) ? 0 : 1;
+                    held[r].store(-1);
+                    reader.returnSlot();
+                }
+            });
+    }
+
+    while (READERS > attached.load())
+    {
+        std::this_thread::yield();
+    }
+    for (uint32_t number = 1; number <= SAMPLES; number++)
+    {
+        // The newest slot and the two borrowed ones leave one slot to the writer.
+        char *sample{writer.beginSlot()};
+        if (nullptr == sample)
+        {
+            findings.noSlotForWriter++;
+            continue;
+        }
+        for (auto &h : held)
+        {
+            findings.claimedWhileBorrowed += (slotOffset(writer, sample) == h.load()) ? 1 : 0;
+        }
+        fillSample(sample, SIZE, number);
+        writer.commitSlot(cluon::data::TimeStamp{}.microseconds(static_cast<int32_t>(number)));
+    }
+    writing.store(false);
+    for (auto &t : readers)
+    {
+        t.join();
+    }
+}
+
+void requireNoFindings(const SlotFindings &findings)
+{
+    REQUIRE(0 < findings.borrowed.load());
+    REQUIRE(0 == findings.torn.load());
+    REQUIRE(0 == findings.changedWhileBorrowed.load());
+    REQUIRE(0 == findings.wentBackwards.load());
+    REQUIRE(0 == findings.claimedWhileBorrowed.load());
+    REQUIRE(0 == findings.noSlotForWriter.load());
+}
+
+TEST_CASE("SharedMemory slots are neither torn nor reused while borrowed (SysV).")
+{
+    SlotFindings findings;
+    exchangeSamples("test-shared-memory-slots-" + std::to_string(::getpid()), findings);
+    requireNoFindings(findings);
+}
+
+TEST_CASE("SharedMemory slots are neither torn nor reused while borrowed (POSIX).")
+{
+    ::setenv("CLUON_SHAREDMEMORY_POSIX", "1", 1);
+    SlotFindings findings;
+    exchangeSamples("test-shared-memory-slots-" + std::to_string(::getpid()), findings);
+    ::unsetenv("CLUON_SHAREDMEMORY_POSIX");
+    requireNoFindings(findings);
+}
+
+// The same protocol stepped through in one thread in a random but reproducible
+// order, including borrowing while the writer fills a slot: the writer always
+// gets a slot that is neither the newest nor borrowed, and a reader always gets
+// the newest complete sample.
+TEST_CASE("SharedMemory hands the writer neither the newest nor a borrowed slot.")
+{
+    constexpr uint32_t SIZE{1024};
+    constexpr size_t READERS{2};
+    const std::string name{"test-shared-memory-steps-" + std::to_string(::getpid())};
+    ::setenv("CLUON_SHAREDMEMORY_SLOTS", "4", 1);
+    cluon::SharedMemory writer{name, SIZE};
+    ::unsetenv("CLUON_SHAREDMEMORY_SLOTS");
+    REQUIRE(writer.valid());
+    cluon::SharedMemory first{name};
+    cluon::SharedMemory second{name};
+    cluon::SharedMemory *readers[READERS]{&first, &second};
+    const char *held[READERS]{nullptr, nullptr};
+    uint32_t heldNumber[READERS]{0, 0};
+
+    std::mt19937 generator{20220514};
+    std::uniform_int_distribution<size_t> pick{0, READERS};
+    char *writing{nullptr};
+    std::ptrdiff_t newest{-1};
+    uint32_t committed{0};
+    for (size_t step = 0; step < 100000; step++)
+    {
+        INFO("step " << step);
+        const size_t actor{pick(generator)};
+        if (READERS == actor)
+        {
+            if (nullptr == writing)
+            {
+                writing = writer.beginSlot();
+                REQUIRE(nullptr != writing);
+                REQUIRE(newest != slotOffset(writer, writing));
+                for (size_t r = 0; r < READERS; r++)
+                {
+                    REQUIRE(slotOffset(*readers[r], held[r]) != slotOffset(writer, writing));
+                }
+                fillSample(writing, SIZE, committed + 1);
+            }
+            else
+            {
+                committed++;
+                writer.commitSlot(cluon::data::TimeStamp{}.microseconds(static_cast<int32_t>(committed)));
+                newest = slotOffset(writer, writing);
+                writing = nullptr;
+            }
+        }
+        else if (nullptr == held[actor])
+        {
+            cluon::data::TimeStamp ts;
+            held[actor] = readers[actor]->borrowSlot(ts);
+            REQUIRE((0 == committed) == (nullptr == held[actor]));
+            if (nullptr != held[actor])
+            {
+                REQUIRE(newest == slotOffset(*readers[actor], held[actor]));
+                REQUIRE(committed == static_cast<uint32_t>(ts.microseconds()));
+                heldNumber[actor] = committed;
+            }
+        }
+        else
+        {
+            REQUIRE(sampleIs(held[actor], SIZE, heldNumber[actor]));
+            readers[actor]->returnSlot();
+            held[actor] = nullptr;
+        }
+    }
+    REQUIRE(0 < committed);
+}
+
+// With two slots, a borrowed one and the newest one would leave the writer
+// nothing; such values create an area without slots.
+TEST_CASE("CLUON_SHAREDMEMORY_SLOTS creates three or four slots only.")
+{
+    const std::string name{"test-shared-memory-slot-count-" + std::to_string(::getpid())};
+    struct SlotCount
+    {
+        const char *value;
+        uint32_t slots;
+    };
+    for (const SlotCount &c : {SlotCount{"3", 3}, SlotCount{"4", 4}, SlotCount{"1", 1}, SlotCount{"2", 1}, SlotCount{"5", 1}, SlotCount{"0", 1},
+                               SlotCount{"", 1}, SlotCount{"-3", 1}, SlotCount{"03", 1}, SlotCount{" 3", 1}, SlotCount{"3x", 1}, SlotCount{"34", 1}})
+    {
+        INFO("CLUON_SHAREDMEMORY_SLOTS='" << c.value << "'");
+        ::setenv("CLUON_SHAREDMEMORY_SLOTS", c.value, 1);
+        cluon::SharedMemory writer{name, 1024};
+        ::unsetenv("CLUON_SHAREDMEMORY_SLOTS");
+        REQUIRE(writer.valid());
+        REQUIRE(c.slots == writer.slots());
+        REQUIRE((1 < c.slots) == (nullptr != writer.beginSlot()));
+        cluon::SharedMemory reader{name};
+        REQUIRE(c.slots == reader.slots());
+    }
+}
+
+// A reader that ends while holding a slot must hand it back; otherwise, with
+// three slots and another reader holding one, the writer would find none.
+TEST_CASE("Destroying a SharedMemory returns the slot it borrowed.")
+{
+    constexpr uint32_t SIZE{1024};
+    const std::string name{"test-shared-memory-destroyed-reader-" + std::to_string(::getpid())};
+    ::setenv("CLUON_SHAREDMEMORY_SLOTS", "3", 1);
+    cluon::SharedMemory writer{name, SIZE};
+    ::unsetenv("CLUON_SHAREDMEMORY_SLOTS");
+    REQUIRE(writer.valid());
+    REQUIRE(3 == writer.slots());
+    auto publish = [&writer](uint32_t number)
+    {
+        char *slot{writer.beginSlot()};
+        if (nullptr != slot)
+        {
+            fillSample(slot, SIZE, number);
+            writer.commitSlot(cluon::data::TimeStamp{}.microseconds(static_cast<int32_t>(number)));
+        }
+        return slotOffset(writer, slot);
+    };
+
+    cluon::data::TimeStamp ts;
+    const std::ptrdiff_t pinned{publish(1)};
+    REQUIRE(0 <= pinned);
+    std::unique_ptr<cluon::SharedMemory> ending{new cluon::SharedMemory{name}};
+    const char *held{ending->borrowSlot(ts)};
+    REQUIRE(pinned == slotOffset(*ending, held));
+
+    REQUIRE(0 <= publish(2));
+    cluon::SharedMemory other{name};
+    const char *otherHeld{other.borrowSlot(ts)};
+    REQUIRE(nullptr != otherHeld);
+    REQUIRE(2 == ts.microseconds());
+
+    // Borrowed, borrowed and the newest one.
+    REQUIRE(0 <= publish(3));
+    REQUIRE(-1 == publish(4));
+
+    ending.reset();
+    REQUIRE(pinned == publish(4));
+    REQUIRE(sampleIs(otherHeld, SIZE, 2));
+    other.returnSlot();
+}
+
+int64_t monotonicNow()
+{
+    struct timespec now
+    {
+    };
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+// Readers measure how late they woke up against the time the writer published
+// a sample; it must be taken on CLOCK_MONOTONIC when the sample is published,
+// not be the sample time stamp.
+TEST_CASE("SharedMemory records when the writer published a sample.")
+{
+    constexpr uint32_t SIZE{1024};
+    const cluon::data::TimeStamp SAMPLE_TIME{cluon::data::TimeStamp{}.seconds(1652515200)};
+
+    const std::string plainName{"test-shared-memory-plain-" + std::to_string(::getpid())};
+    cluon::SharedMemory plain{plainName, SIZE};
+    REQUIRE(plain.valid());
+    plain.lock();
+    plain.setTimeStamp(SAMPLE_TIME);
+    plain.unlock();
+    REQUIRE(0 == plain.publishedAt());
+
+    const std::string sequenceName{"test-shared-memory-published-" + std::to_string(::getpid())};
+    ::setenv("CLUON_SHAREDMEMORY_SEQUENCE", "1", 1);
+    cluon::SharedMemory sequenceWriter{sequenceName, SIZE};
+    ::unsetenv("CLUON_SHAREDMEMORY_SEQUENCE");
+    REQUIRE(sequenceWriter.hasSequence());
+    cluon::SharedMemory sequenceReader{sequenceName};
+    REQUIRE(sequenceReader.hasSequence());
+    REQUIRE(0 == sequenceReader.publishedAt());
+    sequenceWriter.lock();
+    sequenceWriter.setTimeStamp(SAMPLE_TIME);
+    const int64_t beforeUnlock{monotonicNow()};
+    sequenceWriter.unlock();
+    const int64_t afterUnlock{monotonicNow()};
+    REQUIRE(beforeUnlock <= sequenceReader.publishedAt());
+    REQUIRE(afterUnlock >= sequenceReader.publishedAt());
+
+    const std::string slotName{"test-shared-memory-published-slots-" + std::to_string(::getpid())};
+    ::setenv("CLUON_SHAREDMEMORY_SLOTS", "3", 1);
+    cluon::SharedMemory slotWriter{slotName, SIZE};
+    ::unsetenv("CLUON_SHAREDMEMORY_SLOTS");
+    REQUIRE(3 == slotWriter.slots());
+    cluon::SharedMemory slotReader{slotName};
+    cluon::data::TimeStamp sampleTime;
+    int64_t published[2]{0, 0};
+    for (int64_t &p : published)
+    {
+        REQUIRE(nullptr != slotWriter.beginSlot());
+        const int64_t beforeCommit{monotonicNow()};
+        slotWriter.commitSlot(SAMPLE_TIME);
+        const int64_t afterCommit{monotonicNow()};
+        REQUIRE(nullptr != slotReader.borrowSlot(sampleTime));
+        p = slotReader.publishedAt();
+        REQUIRE(beforeCommit <= p);
+        REQUIRE(afterCommit >= p);
+        // The borrowed slot keeps its publish time while the writer goes on.
+        REQUIRE(nullptr != slotWriter.beginSlot());
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        slotWriter.commitSlot(SAMPLE_TIME);
+        REQUIRE(p == slotReader.publishedAt());
+        slotReader.returnSlot();
+        REQUIRE(p < slotReader.publishedAt());
+    }
+    REQUIRE(published[0] < published[1]);
+}
+
+// What the waiter found; the writer publishes one number after the other and
+// waits for the waiter to have seen it.
+struct WaitFindings
+{
+    std::atomic<uint32_t> seen{0};
+    std::atomic<uint64_t> skipped{0};
+    std::atomic<uint64_t> wrongNumber{0};
+    std::atomic<uint64_t> torn{0};
+    std::atomic<int64_t> publishedAt{0};
+    std::atomic<int64_t> maxLatency{0};
+};
+
+int64_t steadyMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Every second round, the writer waits before publishing, so that the waiter
+// is asleep in waitForSequence and has to be woken up; a missed wake-up only
+// ends with the time-out of one second.
+void publishInLockstep(const std::string &name, WaitFindings &findings, uint32_t rounds)
+{
+    constexpr uint32_t SIZE{1024};
+    ::setenv("CLUON_SHAREDMEMORY_SEQUENCE", "1", 1);
+    cluon::SharedMemory writer{name, SIZE};
+    ::unsetenv("CLUON_SHAREDMEMORY_SEQUENCE");
+    REQUIRE(writer.valid());
+    REQUIRE(writer.hasSequence());
+
+    std::atomic<bool> attached{false};
+    std::thread waiter(
+        [&name, &findings, &attached, rounds]()
+        {
+            cluon::SharedMemory reader{name};
+            // An odd sequence is never returned, so the current one comes back right away.
+            uint32_t last{reader.waitForSequence(1, std::chrono::seconds(1))};
+            attached.store(true);
+            for (uint32_t expected = 1; reader.hasSequence() && (expected <= rounds); expected++)
+            {
+                const uint32_t sequence{reader.waitForSequence(last, std::chrono::seconds(1))};
+                const int64_t latency{steadyMicroseconds() - findings.publishedAt.load()};
+                if (latency > findings.maxLatency.load())
+                {
+                    findings.maxLatency.store(latency);
+                }
+                findings.skipped += (last + 2 == sequence) ? 0 : 1;
+                uint32_t number{0};
+                std::memcpy(&number, reader.data(), sizeof(number));
+                findings.torn += reader.sequenceUnchanged(sequence) ? 0 : 1;
+                findings.wrongNumber += (expected == number) ? 0 : 1;
+                last = sequence;
+                findings.seen.store(number);
+            }
+        });
+
+    while (!attached.load())
+    {
+        std::this_thread::yield();
+    }
+    for (uint32_t number = 1; number <= rounds; number++)
+    {
+        if (0 == number % 2)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        writer.lock();
+        std::memcpy(writer.data(), &number, sizeof(number));
+        findings.publishedAt.store(steadyMicroseconds());
+        writer.unlock();
+        const auto deadline{std::chrono::steady_clock::now() + std::chrono::seconds(2)};
+        while ((number != findings.seen.load()) && (std::chrono::steady_clock::now() < deadline))
+        {
+            std::this_thread::yield();
+        }
+    }
+    waiter.join();
+}
+
+void requireEveryNumberSeen(const WaitFindings &findings, uint32_t rounds)
+{
+    REQUIRE(rounds == findings.seen.load());
+    REQUIRE(0 == findings.skipped.load());
+    REQUIRE(0 == findings.wrongNumber.load());
+    REQUIRE(0 == findings.torn.load());
+    // Far below the time-out of one second.
+    REQUIRE(300000 > findings.maxLatency.load());
+}
+
+TEST_CASE("SharedMemory::waitForSequence sees every increment of the sequence (SysV).")
+{
+    WaitFindings findings;
+    publishInLockstep("test-shared-memory-wait-" + std::to_string(::getpid()), findings, 200);
+    requireEveryNumberSeen(findings, 200);
+}
+
+TEST_CASE("SharedMemory::waitForSequence sees every increment of the sequence (POSIX).")
+{
+    ::setenv("CLUON_SHAREDMEMORY_POSIX", "1", 1);
+    WaitFindings findings;
+    publishInLockstep("test-shared-memory-wait-" + std::to_string(::getpid()), findings, 200);
+    ::unsetenv("CLUON_SHAREDMEMORY_POSIX");
+    requireEveryNumberSeen(findings, 200);
+}
+
+// Without a new sample, and while the writer holds the lock, the waiter gets
+// its last sequence back once the time-out passed.
+void waitForNothing(const std::string &name, bool posix)
+{
+    if (posix)
+    {
+        ::setenv("CLUON_SHAREDMEMORY_POSIX", "1", 1);
+    }
+    ::setenv("CLUON_SHAREDMEMORY_SEQUENCE", "1", 1);
+    cluon::SharedMemory writer{name, 64};
+    ::unsetenv("CLUON_SHAREDMEMORY_SEQUENCE");
+    cluon::SharedMemory reader{name};
+    ::unsetenv("CLUON_SHAREDMEMORY_POSIX");
+    REQUIRE(reader.hasSequence());
+    const uint32_t sequence{reader.waitForSequence(1, std::chrono::milliseconds(0))};
+    REQUIRE(0 == sequence % 2);
+    REQUIRE(reader.sequenceUnchanged(sequence));
+
+    for (bool locked : {false, true})
+    {
+        INFO((locked ? "locked" : "unlocked"));
+        if (locked)
+        {
+            writer.lock();
+        }
+        const auto start{std::chrono::steady_clock::now()};
+        REQUIRE(sequence == reader.waitForSequence(sequence, std::chrono::milliseconds(50)));
+        const auto waited{std::chrono::steady_clock::now() - start};
+        REQUIRE(std::chrono::milliseconds(50) <= waited);
+        REQUIRE(std::chrono::milliseconds(500) > waited);
+        // A copy taken while the writer holds the lock is torn.
+        REQUIRE(locked != reader.sequenceUnchanged(sequence));
+    }
+    writer.unlock();
+    REQUIRE_FALSE(reader.sequenceUnchanged(sequence));
+    REQUIRE(sequence + 2 == reader.waitForSequence(sequence, std::chrono::milliseconds(0)));
+}
+
+TEST_CASE("SharedMemory::waitForSequence times out without a new sample (SysV).")
+{
+    waitForNothing("test-shared-memory-timeout-" + std::to_string(::getpid()), false);
+}
+
+TEST_CASE("SharedMemory::waitForSequence times out without a new sample (POSIX).")
+{
+    waitForNothing("test-shared-memory-timeout-" + std::to_string(::getpid()), true);
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "cluon-complete.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Runs the classic BPF program on a datagram as the kernel does for a UDP
+// socket, which passes the packet from the UDP header on. Only the
+// instructions dataTypeSocketFilter emits are known; valid turns false on
+// any other instruction or a jump out of the program.
+uint32_t runSocketFilter(const std::vector<struct sock_filter> &program, const std::string &datagram, bool &valid)
+{
+    const std::string packet{std::string(8, '\0') + datagram};
+    uint32_t a{0};
+    size_t pc{0};
+    valid = true;
+    while (pc < program.size())
+    {
+        const struct sock_filter &instruction = program[pc++];
+        switch (instruction.code)
+        {
+        case BPF_LD | BPF_W | BPF_LEN:
+            a = static_cast<uint32_t>(packet.size());
+            break;
+        case BPF_LD | BPF_B | BPF_ABS:
+            // Loading beyond the end drops the packet.
+            if (instruction.k >= packet.size())
+            {
+                return 0;
+            }
+            a = static_cast<uint8_t>(packet[instruction.k]);
+            break;
+        case BPF_JMP | BPF_JEQ | BPF_K:
+            pc += (a == instruction.k) ? instruction.jt : instruction.jf;
+            break;
+        case BPF_JMP | BPF_JGE | BPF_K:
+            pc += (a >= instruction.k) ? instruction.jt : instruction.jf;
+            break;
+        case BPF_RET | BPF_K:
+            return instruction.k;
+        default:
+            valid = false;
+            return 0;
+        }
+    }
+    valid = false;
+    return 0;
+}
+
+std::string envelopeOf(int32_t dataType, const std::string &payload)
+{
+    cluon::data::Envelope envelope;
+    envelope.dataType(dataType).serializedData(payload).sampleTimeStamp(cluon::data::TimeStamp{}.seconds(1652515200));
+    return cluon::serializeEnvelope(std::move(envelope));
+}
+
+// What the filter is documented to do: datagrams too short to hold the
+// dataType or not starting like an OD4 Envelope pass to user space, which
+// rejects them; Envelopes pass when their dataType is one of the given ones.
+bool passes(const std::string &datagram, const std::set<int32_t> &dataTypes)
+{
+    // OD4 header (5 bytes), key of the dataType and the longest VarInt of an int32_t.
+    if (datagram.size() < 5 + 1 + 5)
+    {
+        return true;
+    }
+    if ((0x0D != static_cast<uint8_t>(datagram[0])) || (0xA4 != static_cast<uint8_t>(datagram[1])) || (0x08 != datagram[5]))
+    {
+        return true;
+    }
+    // Only the dataType is judged; the rest of the Envelope may be cut off.
+    uint32_t zigZag{0};
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        const uint8_t byte{static_cast<uint8_t>(datagram[6 + i])};
+        zigZag |= static_cast<uint32_t>(byte & 0x7F) << (7 * i);
+        if (0 == (byte & 0x80))
+        {
+            break;
+        }
+    }
+    const int32_t dataType{static_cast<int32_t>((zigZag >> 1) ^ (0u - (zigZag & 1)))};
+    return 0 != dataTypes.count(dataType);
+}
+
+// Identifiers around the boundaries of the zig-zag VarInt encoding (one byte
+// up to 63, two up to 8191, ...), the extremes, and ones sharing the first or
+// the last byte of their encoding with a filtered one.
+std::vector<int32_t> interestingDataTypes()
+{
+    std::vector<int32_t> dataTypes;
+    for (int32_t id = -300; id <= 300; id++)
+    {
+        dataTypes.push_back(id);
+    }
+    for (int64_t bound : {63LL, 8191LL, 1048575LL, 134217727LL, 2147483647LL})
+    {
+        for (int64_t d = -2; d <= 2; d++)
+        {
+            for (int64_t id : {bound + d, -bound - 1 + d})
+            {
+                if ((std::numeric_limits<int32_t>::min() <= id) && (std::numeric_limits<int32_t>::max() >= id))
+                {
+                    dataTypes.push_back(static_cast<int32_t>(id));
+                }
+            }
+        }
+    }
+    for (int32_t id : {1037, 1038, 1090, 1091, 1090 + 64, 1090 + 8192, 1090 - 64, 2000000000, 2000000000 + 64})
+    {
+        dataTypes.push_back(id);
+    }
+    return dataTypes;
+}
+
+// The filter is checked on Envelopes of every interesting dataType with and
+// without payload, on every truncation of them, and with a wrong magic
+// number or a wrong key of the first field.
+std::vector<std::string> craftedDatagrams()
+{
+    std::vector<std::string> datagrams;
+    for (int32_t dataType : interestingDataTypes())
+    {
+        for (const std::string &payload : {std::string{}, std::string(40, 'p')})
+        {
+            const std::string envelope{envelopeOf(dataType, payload)};
+            datagrams.push_back(envelope);
+            std::string wrongMagic{envelope};
+            wrongMagic[0] = static_cast<char>(0xA4);
+            wrongMagic[1] = static_cast<char>(0x0D);
+            datagrams.push_back(wrongMagic);
+            std::string wrongKey{envelope};
+            wrongKey[5] = static_cast<char>((1 << 3) | 2);
+            datagrams.push_back(wrongKey);
+        }
+    }
+    for (int32_t dataType : {1090, 1091, 64, -65})
+    {
+        const std::string envelope{envelopeOf(dataType, "payload")};
+        for (size_t size = 0; size < envelope.size(); size++)
+        {
+            datagrams.push_back(envelope.substr(0, size));
+        }
+    }
+    return datagrams;
+}
+
+const std::vector<std::set<int32_t>> FILTERED_DATA_TYPES{
+    {},
+    {1090},
+    {1037, 1090, 63, 64, -64, -65},
+    {0, 1, -1, 8191, 8192, -8193, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min()},
+    {1090 + 8192, 2000000000, 1048575, -1048576, 134217728}};
+
+TEST_CASE("dataTypeSocketFilter passes exactly the given dataTypes and what it cannot judge.")
+{
+    const std::vector<std::string> datagrams{craftedDatagrams()};
+    for (const std::set<int32_t> &dataTypes : FILTERED_DATA_TYPES)
+    {
+        const std::vector<struct sock_filter> program{cluon::dataTypeSocketFilter(std::vector<int32_t>(dataTypes.begin(), dataTypes.end()))};
+        REQUIRE(!program.empty());
+        REQUIRE(BPF_MAXINSNS >= program.size());
+        for (const std::string &datagram : datagrams)
+        {
+            INFO(dataTypes.size() << " dataTypes, datagram of " << datagram.size() << " bytes");
+            bool valid{false};
+            const uint32_t verdict{runSocketFilter(program, datagram, valid)};
+            REQUIRE(valid);
+            REQUIRE(passes(datagram, dataTypes) == (0 != verdict));
+        }
+    }
+}
+
+// The kernel must accept the program and come to the same verdict. Every
+// datagram is followed by one too short to be judged, so that a dropped
+// datagram shows up without waiting for a time-out.
+TEST_CASE("dataTypeSocketFilter drops the same datagrams in the kernel.")
+{
+    const int receiver{::socket(AF_INET, SOCK_DGRAM, 0)};
+    const int sender{::socket(AF_INET, SOCK_DGRAM, 0)};
+    REQUIRE(0 <= receiver);
+    REQUIRE(0 <= sender);
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t addressLength{sizeof(address)};
+    REQUIRE(0 == ::bind(receiver, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+    REQUIRE(0 == ::getsockname(receiver, reinterpret_cast<struct sockaddr *>(&address), &addressLength));
+    struct timeval timeout{};
+    timeout.tv_sec = 1;
+    REQUIRE(0 == ::setsockopt(receiver, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)));
+
+    const std::set<int32_t> dataTypes{FILTERED_DATA_TYPES[2]};
+    std::vector<struct sock_filter> program{cluon::dataTypeSocketFilter(std::vector<int32_t>(dataTypes.begin(), dataTypes.end()))};
+    struct sock_fprog filter{};
+    filter.len = static_cast<unsigned short>(program.size());
+    filter.filter = program.data();
+    REQUIRE(0 == ::setsockopt(receiver, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)));
+
+    const std::string SEPARATOR{"-"};
+    char buffer[2048];
+    for (const std::string &datagram : craftedDatagrams())
+    {
+        INFO("datagram of " << datagram.size() << " bytes");
+        for (const std::string &d : {datagram, SEPARATOR})
+        {
+            REQUIRE(static_cast<ssize_t>(d.size()) ==
+                    ::sendto(sender, d.data(), d.size(), 0, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)));
+        }
+        ssize_t size{::recv(receiver, buffer, sizeof(buffer), 0)};
+        REQUIRE(0 <= size);
+        const bool received{SEPARATOR != std::string(buffer, static_cast<size_t>(size))};
+        REQUIRE(passes(datagram, dataTypes) == received);
+        if (received)
+        {
+            size = ::recv(receiver, buffer, sizeof(buffer), 0);
+            REQUIRE(SEPARATOR == std::string(buffer, static_cast<size_t>((0 < size) ? size : 0)));
+        }
+    }
+    ::close(sender);
+    ::close(receiver);
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "steering-features.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+std::vector<FrameFeatures> randomFrameFeatures(size_t count)
+{
+    std::mt19937 generator{20220514};
+    std::uniform_int_distribution<int32_t> coordinate{-10, 2000};
+    std::uniform_real_distribution<double> value{-1.0, 1.0};
+    std::vector<FrameFeatures> frames(count);
+    int64_t sampleTimeStamp{1652515200000000};
+    for (FrameFeatures &f : frames)
+    {
+        sampleTimeStamp += 33333 + static_cast<int64_t>(generator() % 100);
+        f.sampleTimeStamp = sampleTimeStamp;
+        for (int32_t *i : {&f.yellowCones, &f.blueCones, &f.largestYellowX, &f.largestYellowY, &f.largestYellowWidth, &f.largestYellowHeight, &f.largestBlueX,
+                           &f.largestBlueY, &f.largestBlueWidth, &f.largestBlueHeight})
+        {
+            *i = coordinate(generator);
+        }
+        f.leftIR = value(generator);
+        f.rightIR = value(generator);
+        f.groundSteering = value(generator);
+    }
+    return frames;
+}
+
+bool sameDouble(double a, double b)
+{
+    return (a <= b) && (a >= b);
+}
+
+void requireSameFrame(const FrameFeatures &expected, const FrameFeatures &actual)
+{
+    REQUIRE(expected.sampleTimeStamp == actual.sampleTimeStamp);
+    REQUIRE(expected.yellowCones == actual.yellowCones);
+    REQUIRE(expected.blueCones == actual.blueCones);
+    REQUIRE(expected.largestYellowX == actual.largestYellowX);
+    REQUIRE(expected.largestYellowY == actual.largestYellowY);
+    REQUIRE(expected.largestYellowWidth == actual.largestYellowWidth);
+    REQUIRE(expected.largestYellowHeight == actual.largestYellowHeight);
+    REQUIRE(expected.largestBlueX == actual.largestBlueX);
+    REQUIRE(expected.largestBlueY == actual.largestBlueY);
+    REQUIRE(expected.largestBlueWidth == actual.largestBlueWidth);
+    REQUIRE(expected.largestBlueHeight == actual.largestBlueHeight);
+    REQUIRE(sameDouble(expected.leftIR, actual.leftIR));
+    REQUIRE(sameDouble(expected.rightIR, actual.rightIR));
+    REQUIRE(sameDouble(expected.groundSteering, actual.groundSteering));
+}
+
+void writeFrames(const std::string &path, const std::vector<FrameFeatures> &frames)
+{
+    FeatureWriter writer;
+    REQUIRE(writer.open(path));
+    for (const FrameFeatures &f : frames)
+    {
+        writer.append(f);
+    }
+}
+
+std::string readFile(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+void writeFile(const std::string &path, const std::string &content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), static_cast<std::streamsize>(content.size()));
+}
+
+template <typename T>
+void patch(std::string &content, size_t offset, T value)
+{
+    std::memcpy(&content[offset], &value, sizeof(value));
+}
+
+// Byte offset of the description of a column and of the first block.
+size_t descriptionOffset(size_t c)
+{
+    return sizeof(features::FileHeader) + c * sizeof(features::ColumnDescription);
+}
+
+const size_t FIRST_BLOCK{descriptionOffset(features::NUMBER_OF_COLUMNS)};
+
+// Bytes of a block of the given number of frames with all columns of version 1.
+size_t blockSize(size_t frames)
+{
+    size_t size{sizeof(features::BlockHeader)};
+    for (const features::Column &column : features::COLUMNS)
+    {
+        size += features::padded(frames * features::elementSize(column.type));
+    }
+    return size;
+}
+
+TEST_CASE("FeatureWriter and FeatureFile round-trip 2500 frames in three blocks.")
+{
+    const std::string path{"roundTrip.features"};
+    const std::vector<FrameFeatures> written{randomFrameFeatures(2500)};
+    writeFrames(path, written);
+    REQUIRE((FIRST_BLOCK + 2 * blockSize(1024) + blockSize(452)) == readFile(path).size());
+
+    FeatureFile file;
+    std::string error;
+    REQUIRE(file.open(path, error));
+    REQUIRE(2500 == file.frames());
+    REQUIRE(3 == file.blocks().size());
+    REQUIRE(1024 == file.blocks()[0].frames);
+    REQUIRE(1024 == file.blocks()[1].frames);
+    REQUIRE(452 == file.blocks()[2].frames);
+
+    std::vector<FrameFeatures> read;
+    REQUIRE(readFrameFeatures(path, read, error));
+    REQUIRE(written.size() == read.size());
+    for (size_t i = 0; i < written.size(); i++)
+    {
+        INFO("frame " << i);
+        requireSameFrame(written[i], read[i]);
+    }
+
+    // Without frames, there is no block.
+    writeFrames(path, {});
+    FeatureFile empty;
+    REQUIRE(empty.open(path, error));
+    REQUIRE(0 == empty.frames());
+    REQUIRE(empty.blocks().empty());
+    std::remove(path.c_str());
+}
+
+// A run that ended while writing its last block loses only that block,
+// wherever it was cut off.
+TEST_CASE("FeatureFile skips a truncated last block.")
+{
+    const std::string path{"truncated.features"};
+    const std::vector<FrameFeatures> written{randomFrameFeatures(2500)};
+    writeFrames(path, written);
+    const std::string complete{readFile(path)};
+    const size_t lastBlock{FIRST_BLOCK + 2 * blockSize(1024)};
+    for (size_t size : {complete.size() - 1, complete.size() - 8, lastBlock + sizeof(features::BlockHeader) + 8, lastBlock + sizeof(features::BlockHeader),
+                        lastBlock + 3, lastBlock + 1})
+    {
+        INFO("cut after " << size << " of " << complete.size() << " bytes");
+        writeFile(path, complete.substr(0, size));
+        std::vector<FrameFeatures> read;
+        std::string error;
+        REQUIRE(readFrameFeatures(path, read, error));
+        REQUIRE(2048 == read.size());
+        requireSameFrame(written[2047], read[2047]);
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("FeatureFile rejects files with a bad magic number, version or block.")
+{
+    const std::string path{"corrupt.features"};
+    writeFrames(path, randomFrameFeatures(1500));
+    const std::string complete{readFile(path)};
+    struct Corruption
+    {
+        size_t offset;
+        uint32_t value;
+        std::string error;
+    };
+    const uint32_t VERSION_AND_COLUMNS{static_cast<uint32_t>(features::NUMBER_OF_COLUMNS) << 16};
+    for (const Corruption &corruption :
+         {Corruption{0, features::FILE_MAGIC + 1, "not a feature file"}, Corruption{0, __builtin_bswap32(features::FILE_MAGIC), "feature file of the other byte order"},
+          Corruption{4, VERSION_AND_COLUMNS | 2, "feature file version 2 is newer than 1"}, Corruption{4, VERSION_AND_COLUMNS, "feature file without version"},
+          Corruption{FIRST_BLOCK, 0x4B434C43, "corrupt block at byte " + std::to_string(FIRST_BLOCK)},
+          Corruption{FIRST_BLOCK + blockSize(1024), 0, "corrupt block at byte " + std::to_string(FIRST_BLOCK + blockSize(1024))}})
+    {
+        std::string content{complete};
+        patch(content, corruption.offset, corruption.value);
+        writeFile(path, content);
+        FeatureFile file;
+        std::string error;
+        REQUIRE_FALSE(file.open(path, error));
+        REQUIRE((path + ": " + corruption.error) == error);
+    }
+
+    writeFile(path, complete.substr(0, 6));
+    FeatureFile tooShort;
+    std::string error;
+    REQUIRE_FALSE(tooShort.open(path, error));
+    REQUIRE((path + ": not a feature file") == error);
+
+    writeFile(path, complete.substr(0, FIRST_BLOCK - 1));
+    FeatureFile withoutColumns;
+    REQUIRE_FALSE(withoutColumns.open(path, error));
+    REQUIRE((path + ": truncated column table") == error);
+    std::remove(path.c_str());
+}
+
+// A known column must have the size of its type, as its values are read with
+// it; unknown columns are skipped with whatever size they have.
+TEST_CASE("FeatureFile checks the element size of the columns it reads.")
+{
+    const std::string path{"elementSize.features"};
+    const std::vector<FrameFeatures> written{randomFrameFeatures(100)};
+    writeFrames(path, written);
+    const std::string complete{readFile(path)};
+    const size_t ELEMENT_SIZE{offsetof(features::ColumnDescription, elementSize)};
+
+    for (size_t c : {size_t{0}, size_t{1}, features::NUMBER_OF_COLUMNS - 1})
+    {
+        const uint32_t expected{features::elementSize(features::COLUMNS[c].type)};
+        for (uint32_t elementSize : {uint32_t{0}, expected / 2, 2 * expected})
+        {
+            INFO("column " << features::COLUMNS[c].name << " with elements of " << elementSize << " bytes");
+            std::string content{complete};
+            patch(content, descriptionOffset(c) + ELEMENT_SIZE, elementSize);
+            writeFile(path, content);
+            FeatureFile file;
+            std::string error;
+            REQUIRE_FALSE(file.open(path, error));
+            REQUIRE((path + ": column '" + features::COLUMNS[c].name + "' has elements of " + std::to_string(elementSize) + " bytes instead of " +
+                     std::to_string(expected)) == error);
+        }
+    }
+
+    // Renamed, the blueCones column becomes unknown: its values are skipped and blueCones keeps its default.
+    const size_t BLUE_CONES{2};
+    REQUIRE(std::string{"blueCones"} == features::COLUMNS[BLUE_CONES].name);
+    std::string content{complete};
+    content[descriptionOffset(BLUE_CONES)] = 'B';
+    writeFile(path, content);
+    std::vector<FrameFeatures> read;
+    std::string error;
+    REQUIRE(readFrameFeatures(path, read, error));
+    REQUIRE(written.size() == read.size());
+    for (size_t i = 0; i < written.size(); i++)
+    {
+        INFO("frame " << i);
+        FrameFeatures expected{written[i]};
+        expected.blueCones = 0;
+        requireSameFrame(expected, read[i]);
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "steering-watchdog.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+namespace
+{
+constexpr int64_t PERIOD{50000};
+const std::chrono::steady_clock::time_point T0{std::chrono::seconds(1000)};
+
+std::chrono::steady_clock::time_point at(int64_t microseconds)
+{
+    return T0 + std::chrono::microseconds(microseconds);
+}
+} // namespace
+
+TEST_CASE("SteeringWatchdog sets no deadline when off or before the period is known.")
+{
+    SteeringWatchdog off{WatchdogMode::Off};
+    REQUIRE(off.frameDone(1000000, 0.1, PERIOD, at(0)));
+    REQUIRE(std::chrono::steady_clock::time_point::max() == off.deadline(PERIOD));
+
+    SteeringWatchdog hold{WatchdogMode::Hold};
+    REQUIRE(std::chrono::steady_clock::time_point::max() == hold.deadline(PERIOD));
+    REQUIRE(hold.frameDone(1000000, 0.1, PERIOD, at(0)));
+    REQUIRE(std::chrono::steady_clock::time_point::max() == hold.deadline(0));
+    REQUIRE(at(PERIOD + PERIOD / 2) == hold.deadline(PERIOD));
+}
+
+TEST_CASE("SteeringWatchdog holds the last steering at the frame cadence and gives up.")
+{
+    SteeringWatchdog watchdog{WatchdogMode::Hold};
+    REQUIRE(watchdog.frameDone(1000000, 0.0, PERIOD, at(0)));
+    REQUIRE(watchdog.frameDone(1050000, 0.045, PERIOD, at(PERIOD)));
+
+    int64_t expected{0};
+    REQUIRE(0.045 == Approx(watchdog.predict(PERIOD, at(2 * PERIOD + PERIOD / 2), expected)));
+    REQUIRE(1100000 == expected);
+    REQUIRE(at(3 * PERIOD + PERIOD / 2) == watchdog.deadline(PERIOD));
+    REQUIRE(0.045 == Approx(watchdog.predict(PERIOD, at(3 * PERIOD + PERIOD / 2), expected)));
+    REQUIRE(1150000 == expected);
+    REQUIRE_FALSE(watchdog.gaveUp());
+    REQUIRE(0.045 == Approx(watchdog.predict(PERIOD, at(4 * PERIOD + PERIOD / 2), expected)));
+    REQUIRE(1200000 == expected);
+
+    // The camera is taken to have stopped.
+    const uint64_t maxPredictions{SteeringWatchdog::MAX_PREDICTIONS};
+    REQUIRE(maxPredictions == watchdog.overruns());
+    REQUIRE(watchdog.gaveUp());
+    REQUIRE(std::chrono::steady_clock::time_point::max() == watchdog.deadline(PERIOD));
+
+    // A frame after the predictions is emitted and arms the deadline again.
+    REQUIRE(watchdog.frameDone(1250000, 0.09, PERIOD, at(10 * PERIOD)));
+    REQUIRE_FALSE(watchdog.gaveUp());
+    REQUIRE(at(11 * PERIOD + PERIOD / 2) == watchdog.deadline(PERIOD));
+}
+
+TEST_CASE("SteeringWatchdog extrapolates the last change for at most as long as it took.")
+{
+    SteeringWatchdog watchdog{WatchdogMode::Extrapolate};
+    int64_t expected{0};
+
+    // A single frame has no change to continue.
+    REQUIRE(watchdog.frameDone(1000000, 0.045, PERIOD, at(0)));
+    REQUIRE(0.045 == Approx(watchdog.predict(PERIOD, at(PERIOD + PERIOD / 2), expected)));
+
+    REQUIRE(watchdog.frameDone(1100000, 0.0, PERIOD, at(2 * PERIOD)));
+    REQUIRE(watchdog.frameDone(1150000, 0.045, PERIOD, at(3 * PERIOD)));
+    REQUIRE(0.09 == Approx(watchdog.predict(PERIOD, at(4 * PERIOD + PERIOD / 2), expected)));
+    REQUIRE(1200000 == expected);
+    REQUIRE(0.09 == Approx(watchdog.predict(PERIOD, at(5 * PERIOD + PERIOD / 2), expected)));
+    REQUIRE(1250000 == expected);
+}
+
+TEST_CASE("SteeringWatchdog does not emit a late frame a prediction stood in for.")
+{
+    SteeringWatchdog watchdog{WatchdogMode::Hold};
+    REQUIRE(watchdog.frameDone(1000000, 0.0, PERIOD, at(0)));
+    REQUIRE(watchdog.frameDone(1050000, 0.045, PERIOD, at(PERIOD)));
+
+    int64_t expected{0};
+    watchdog.predict(PERIOD, at(2 * PERIOD + PERIOD / 2), expected);
+    watchdog.predict(PERIOD, at(3 * PERIOD + PERIOD / 2), expected);
+    REQUIRE(1150000 == expected);
+
+    // Both late frames were predicted (with some jitter); the next one is new.
+    REQUIRE_FALSE(watchdog.frameDone(1101000, 0.09, PERIOD, at(4 * PERIOD)));
+    REQUIRE_FALSE(watchdog.frameDone(1149000, 0.09, PERIOD, at(4 * PERIOD + 100)));
+    REQUIRE(watchdog.frameDone(1200000, 0.09, PERIOD, at(5 * PERIOD)));
+
+    // Predictions continue after the last output, whether it was predicted or not.
+    watchdog.predict(PERIOD, at(6 * PERIOD + PERIOD / 2), expected);
+    REQUIRE(1250000 == expected);
+}
+
+TEST_CASE("SteeringWatchdog emits the frames of a restarted recording.")
+{
+    SteeringWatchdog watchdog{WatchdogMode::Hold};
+    REQUIRE(watchdog.frameDone(1000000, 0.0, PERIOD, at(0)));
+    int64_t expected{0};
+    watchdog.predict(PERIOD, at(PERIOD + PERIOD / 2), expected);
+    REQUIRE(watchdog.frameDone(500000, 0.0, PERIOD, at(2 * PERIOD)));
+}
+
+TEST_CASE("parseWatchdogMode accepts the documented modes only.")
+{
+    WatchdogMode mode{WatchdogMode::Off};
+    REQUIRE(parseWatchdogMode("hold", mode));
+    REQUIRE(WatchdogMode::Hold == mode);
+    REQUIRE(parseWatchdogMode("extrapolate", mode));
+    REQUIRE(WatchdogMode::Extrapolate == mode);
+    REQUIRE(parseWatchdogMode("off", mode));
+    REQUIRE(WatchdogMode::Off == mode);
+    REQUIRE_FALSE(parseWatchdogMode("predict", mode));
+    REQUIRE(WatchdogMode::Off == mode);
+}
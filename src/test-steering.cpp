@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "catch.hpp"
+
+#include "steering.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// calculateSteeringBatch must return what calculateSteering returns for random
+// parameters and inputs, favouring the boundaries: voltages at the threshold,
+// no cones and NaN. The seed is fixed, so that a failure can be reproduced.
+TEST_CASE("calculateSteeringBatch matches calculateSteering on random input.")
+{
+    std::mt19937 generator{20220514};
+    std::uniform_real_distribution<double> value{-0.5, 0.5};
+    std::uniform_int_distribution<int> pick{0, 5};
+    for (size_t round = 0; round < 10000; round++)
+    {
+        SteeringParameters parameters;
+        parameters.incrementSteering = value(generator);
+        parameters.infraredThreshold = (0 == pick(generator)) ? 0.0 : value(generator);
+        parameters.fallbackSteering = value(generator);
+
+        // Odd sizes also cover the remainder of the vectorised loop.
+        const size_t n{1 + round % 67};
+        std::vector<double> rightIR(n), leftIR(n), steering(n);
+        std::vector<int32_t> rightCones(n), leftCones(n);
+        auto voltage = [&generator, &value, &pick, &parameters]()
+        {
+            switch (pick(generator))
+            {
+            case 0:
+                return parameters.infraredThreshold;
+            case 1:
+                return std::nextafter(parameters.infraredThreshold, 1.0);
+            case 2:
+                return std::numeric_limits<double>::quiet_NaN();
+            default:
+                return value(generator);
+            }
+        };
+        for (size_t i = 0; i < n; i++)
+        {
+            rightIR[i] = voltage();
+            leftIR[i] = voltage();
+            rightCones[i] = (pick(generator) < 2) ? 0 : pick(generator);
+            leftCones[i] = (pick(generator) < 2) ? 0 : pick(generator);
+        }
+
+        calculateSteeringBatch(parameters, rightIR.data(), leftIR.data(), rightCones.data(), leftCones.data(), steering.data(), n);
+        for (size_t i = 0; i < n; i++)
+        {
+            const double expected{calculateSteering(parameters, rightIR[i], leftIR[i], rightCones[i], leftCones[i])};
+            INFO("round " << round << ", frame " << i << ": rightIR=" << rightIR[i] << ", leftIR=" << leftIR[i] << ", rightCones=" << rightCones[i]
+                          << ", leftCones=" << leftCones[i]);
+            REQUIRE(((expected <= steering[i]) && (expected >= steering[i])));
+        }
+    }
+}
+
+// The parameter files written by steering-sweep must load back every value,
+// not only the swept ones.
+TEST_CASE("formatSteeringParameters round-trips through loadSteeringParameters.")
+{
+    std::mt19937 generator{20220514};
+    std::uniform_real_distribution<double> value{-0.5, 0.5};
+    std::uniform_int_distribution<int> bound{0, 255};
+    std::uniform_int_distribution<int32_t> area{0, 10000};
+    const std::string path{"formatSteeringParameters.parameters"};
+    for (size_t round = 0; round < 100; round++)
+    {
+        SteeringParameters written;
+        written.incrementSteering = value(generator);
+        written.infraredThreshold = value(generator);
+        written.fallbackSteering = (0 == round) ? 0.045 : value(generator);
+        written.minBlobArea = area(generator);
+        written.minConeArea = area(generator);
+        for (HsvRange *range : {&written.thresholds.yellow, &written.thresholds.yellowLow, &written.thresholds.blue})
+        {
+            for (uint8_t *b : {&range->hLow, &range->sLow, &range->vLow, &range->hHigh, &range->sHigh, &range->vHigh})
+            {
+                *b = static_cast<uint8_t>(bound(generator));
+            }
+        }
+        {
+            std::ofstream file(path);
+            file << formatSteeringParameters(written);
+        }
+
+        SteeringParameters loaded;
+        std::string error;
+        INFO(formatSteeringParameters(written));
+        REQUIRE(loadSteeringParameters(path, loaded, error));
+        REQUIRE(((written.incrementSteering <= loaded.incrementSteering) && (written.incrementSteering >= loaded.incrementSteering)));
+        REQUIRE(((written.infraredThreshold <= loaded.infraredThreshold) && (written.infraredThreshold >= loaded.infraredThreshold)));
+        REQUIRE(((written.fallbackSteering <= loaded.fallbackSteering) && (written.fallbackSteering >= loaded.fallbackSteering)));
+        REQUIRE(written.minBlobArea == loaded.minBlobArea);
+        REQUIRE(written.minConeArea == loaded.minConeArea);
+        REQUIRE(written.thresholds == loaded.thresholds);
+    }
+    std::remove(path.c_str());
+    REQUIRE(std::string::npos != formatSteeringParameters(SteeringParameters{}).find("incrementSteering=0.045\n"));
+}
+
+// Values std::stod and std::stoi would partly read or that make no sense as parameter.
+const std::vector<std::string> REJECTED_ENTRIES{
+    "incrementSteering=0.1x", "incrementSteering=", "incrementSteering=inf", "incrementSteering=-inf", "infraredThreshold=nan",
+    "infraredThreshold=1e999", "fallbackSteering=0.2.3", "fallbackSteering=0,2", "minBlobArea=12abc", "minBlobArea=1.5",
+    "minBlobArea=-1", "minConeArea=-100", "minConeArea=99999999999", "yellow=1,2,3,4,5", "yellow=1,2,3,4,5,6,",
+    "yellowLow=1,2,3,4,5,6,7", "blue=1,2,3,4,5,256", "blue=1,2,3,4,5,-1", "blue=1,2,3x,4,5,6", "blue=1,2,,4,5,6", "unknown=1", "minBlobArea"};
+
+TEST_CASE("Malformed steering parameters are rejected in a file and in a SystemOperationState.")
+{
+    const std::string path{"rejectedSteeringParameters.parameters"};
+    for (const std::string &entry : REJECTED_ENTRIES)
+    {
+        INFO("'" << entry << "'");
+        {
+            std::ofstream file(path);
+            file << "incrementSteering=0.05\n" << entry << "\nminConeArea=7\n";
+        }
+        SteeringParameters parameters;
+        parameters.minBlobArea = 42;
+        std::string error;
+        REQUIRE(!loadSteeringParameters(path, parameters, error));
+        REQUIRE(("invalid entry '" + entry + "'") == error);
+        REQUIRE(42 == parameters.minBlobArea);
+        REQUIRE(((0.045 <= parameters.incrementSteering) && (0.045 >= parameters.incrementSteering)));
+
+        // The description of a SystemOperationState after "steering:".
+        SteeringParameters changed;
+        error.clear();
+        REQUIRE(!parseSteeringParameters("incrementSteering=0.05;" + entry + ";minConeArea=7", ';', changed, error));
+        REQUIRE(("invalid entry '" + entry + "'") == error);
+
+        // A rejected value leaves the parameter as it was.
+        const size_t equals{entry.find('=')};
+        if (std::string::npos != equals)
+        {
+            SteeringParameters single;
+            REQUIRE(!setSteeringParameter(single, entry.substr(0, equals), entry.substr(equals + 1)));
+            REQUIRE(formatSteeringParameters(SteeringParameters{}) == formatSteeringParameters(single));
+        }
+    }
+    std::remove(path.c_str());
+
+    SteeringParameters accepted;
+    std::string error;
+    REQUIRE(parseSteeringParameters(" minBlobArea = 0 ;incrementSteering=-1e-3;blue=0,0,0,255,255,255;# comment;", ';', accepted, error));
+    REQUIRE(0 == accepted.minBlobArea);
+    REQUIRE(((-1e-3 <= accepted.incrementSteering) && (-1e-3 >= accepted.incrementSteering)));
+    REQUIRE(255 == accepted.thresholds.blue.vHigh);
+}
+
+TEST_CASE("parseCount accepts whole decimal counts within their bounds only.")
+{
+    uint64_t count{3};
+    REQUIRE(parseCount("1", 1, 1024, count));
+    REQUIRE(1 == count);
+    REQUIRE(parseCount("1024", 1, 1024, count));
+    REQUIRE(1024 == count);
+    REQUIRE(parseCount("0008", 1, 1024, count));
+    REQUIRE(8 == count);
+    REQUIRE(parseCount("0", 0, 4294967295u, count));
+    REQUIRE(0 == count);
+    REQUIRE(parseCount("4294967295", 0, 4294967295u, count));
+    REQUIRE(4294967295u == count);
+    REQUIRE(parseCount("999999999999999999", 0, std::numeric_limits<uint64_t>::max(), count));
+    REQUIRE(999999999999999999u == count);
+    count = 8;
+    // "-1" would wrap around to 2^64 - 1 with std::stoul.
+    for (const char *text : {"", "0", "1025", "-1", "+2", " 2", "2 ", "2x", "0x10", "3.5", "1e3", "18446744073709551615", "99999999999999999999"})
+    {
+        INFO("'" << text << "'");
+        REQUIRE_FALSE(parseCount(text, 1, 1024, count));
+        REQUIRE(8 == count);
+    }
+    REQUIRE_FALSE(parseCount("4294967296", 0, 4294967295u, count));
+    REQUIRE(8 == count);
+}
+
+// One frame of evidence: blue cones left of the yellow ones point clockwise.
+void observeFrame(DirectionEstimator &estimator, int64_t sampleTimeStamp, bool clockwise)
+{
+    estimator.observe(sampleTimeStamp, clockwise ? 100 : 400, 20, clockwise ? 400 : 100, 20);
+}
+
+// With a frame reliability of 0.8 and an error rate of 1%, the third
+// consistent frame is not yet enough and the fourth one locks.
+TEST_CASE("DirectionEstimator locks after four consistent frames.")
+{
+    for (const bool clockwise : {true, false})
+    {
+        DirectionEstimator estimator;
+        int64_t t{1000};
+        for (size_t frame = 0; frame < 3; frame++)
+        {
+            observeFrame(estimator, t += 1000, clockwise);
+            REQUIRE(DirectionState::Searching == estimator.state());
+            REQUIRE(CarDirection::Unknown == estimator.direction());
+        }
+        observeFrame(estimator, t += 1000, clockwise);
+        REQUIRE(DirectionState::Locked == estimator.state());
+        REQUIRE((clockwise ? CarDirection::Clockwise : CarDirection::CounterClockwise) == estimator.direction());
+    }
+
+    // Frames without both colours or with both centres on top of each other carry no evidence.
+    DirectionEstimator estimator;
+    int64_t t{1000};
+    for (size_t frame = 0; frame < 3; frame++)
+    {
+        observeFrame(estimator, t += 1000, true);
+        estimator.observe(t += 1000, 100, 0, 400, 20);
+        estimator.observe(t += 1000, 100, 20, 400, 0);
+        estimator.observe(t += 1000, 200, 20, 190, 40);
+    }
+    REQUIRE(DirectionState::Searching == estimator.state());
+
+    // A contradicting frame takes one consistent frame to make up for.
+    observeFrame(estimator, t += 1000, false);
+    observeFrame(estimator, t += 1000, true);
+    REQUIRE(DirectionState::Searching == estimator.state());
+    observeFrame(estimator, t += 1000, true);
+    REQUIRE(CarDirection::Clockwise == estimator.direction());
+}
+
+// Once locked, the CUSUM needs seven contradicting frames in a row (or more
+// with consistent ones in between) to start the test again; the locked
+// direction is kept until the test decides, which takes another four frames.
+TEST_CASE("DirectionEstimator revalidates the direction after a change of the lap direction.")
+{
+    DirectionEstimator estimator;
+    int64_t t{1000};
+    for (size_t frame = 0; frame < 4; frame++)
+    {
+        observeFrame(estimator, t += 1000, true);
+    }
+    REQUIRE(DirectionState::Locked == estimator.state());
+
+    // Isolated contradicting frames are noise.
+    for (size_t frame = 0; frame < 100; frame++)
+    {
+        observeFrame(estimator, t += 1000, 0 != frame % 2);
+    }
+    for (size_t frame = 0; frame < 6; frame++)
+    {
+        observeFrame(estimator, t += 1000, false);
+    }
+    observeFrame(estimator, t += 1000, true);
+    observeFrame(estimator, t += 1000, false);
+    REQUIRE(DirectionState::Locked == estimator.state());
+    REQUIRE(CarDirection::Clockwise == estimator.direction());
+
+    // The next one reaches the threshold of the CUSUM.
+    observeFrame(estimator, t += 1000, false);
+    REQUIRE(DirectionState::Revalidating == estimator.state());
+    REQUIRE(CarDirection::Clockwise == estimator.direction());
+    for (size_t frame = 0; frame < 3; frame++)
+    {
+        observeFrame(estimator, t += 1000, false);
+        REQUIRE(DirectionState::Revalidating == estimator.state());
+        REQUIRE(CarDirection::Clockwise == estimator.direction());
+    }
+    observeFrame(estimator, t += 1000, false);
+    REQUIRE(DirectionState::Locked == estimator.state());
+    REQUIRE(CarDirection::CounterClockwise == estimator.direction());
+
+    // A revalidation can also confirm the locked direction.
+    for (size_t frame = 0; frame < 7; frame++)
+    {
+        observeFrame(estimator, t += 1000, true);
+    }
+    REQUIRE(DirectionState::Revalidating == estimator.state());
+    for (size_t frame = 0; frame < 4; frame++)
+    {
+        observeFrame(estimator, t += 1000, false);
+    }
+    REQUIRE(DirectionState::Locked == estimator.state());
+    REQUIRE(CarDirection::CounterClockwise == estimator.direction());
+}
+
+// A restarted replay or a new recording starts the search from scratch, also while revalidating.
+TEST_CASE("DirectionEstimator starts over when time goes backwards.")
+{
+    DirectionEstimator estimator;
+    for (int64_t t = 1000; t <= 4000; t += 1000)
+    {
+        observeFrame(estimator, t, true);
+    }
+    REQUIRE(CarDirection::Clockwise == estimator.direction());
+
+    // The same sample time again is not going backwards.
+    observeFrame(estimator, 4000, true);
+    REQUIRE(DirectionState::Locked == estimator.state());
+
+    estimator.observe(3999, 100, 0, 400, 0);
+    REQUIRE(DirectionState::Searching == estimator.state());
+    REQUIRE(CarDirection::Unknown == estimator.direction());
+
+    // The evidence before going back is gone: the new recording needs four frames of its own.
+    for (int64_t t = 5000; t <= 7000; t += 1000)
+    {
+        observeFrame(estimator, t, false);
+        REQUIRE(CarDirection::Unknown == estimator.direction());
+    }
+    observeFrame(estimator, 8000, false);
+    REQUIRE(CarDirection::CounterClockwise == estimator.direction());
+
+    for (int64_t t = 9000; t <= 15000; t += 1000)
+    {
+        observeFrame(estimator, t, true);
+    }
+    REQUIRE(DirectionState::Revalidating == estimator.state());
+    observeFrame(estimator, 1000, true);
+    REQUIRE(DirectionState::Searching == estimator.state());
+    REQUIRE(CarDirection::Unknown == estimator.direction());
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2022  Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Include the single-file, header-only middleware libcluon for the UDP sender and receiver
+#include "cluon-complete.hpp"
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+struct BenchmarkResult
+{
+    uint64_t sent;
+    uint64_t received;
+    double seconds;
+    // CPU time of the receiving side, i.e., the process without the sending thread.
+    double cpuSeconds;
+};
+
+double cpuSeconds(int who)
+{
+    struct rusage usage
+    {
+    };
+    ::getrusage(who, &usage);
+    return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+// Sends datagrams of the given size over loopback for the given time (at the given rate
+// per second or as fast as possible with 0) and counts what the receiver delivers.
+BenchmarkResult runBenchmark(uint16_t port, uint32_t batchSize, size_t size, double seconds, uint64_t rate)
+{
+    std::atomic<uint64_t> received{0};
+    cluon::UDPReceiver receiver("127.0.0.1", port,
+                                [&received](std::string &&, std::string &&, std::chrono::system_clock::time_point &&) { received++; });
+    if ((1 < batchSize) && !receiver.receiveInBatches(batchSize))
+    {
+        std::cerr << "Cannot receive in batches of " << batchSize << "." << std::endl;
+    }
+    cluon::UDPSender sender("127.0.0.1", port);
+    const std::string payload(size, 'x');
+
+    uint64_t sent{0};
+    double senderCpuSeconds{0.0};
+    const double cpuBefore{cpuSeconds(RUSAGE_SELF)};
+    const auto start{std::chrono::steady_clock::now()};
+    std::thread sending([&]()
+                        {
+                            const double threadCpuBefore{cpuSeconds(RUSAGE_THREAD)};
+                            const auto end{start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds))};
+                            for (auto now = start; now < end; now = std::chrono::steady_clock::now())
+                            {
+                                if (0 < sender.send(std::string(payload)).first)
+                                {
+                                    sent++;
+                                }
+                                if (0 != rate)
+                                {
+                                    std::this_thread::sleep_until(start + std::chrono::nanoseconds(sent * 1000000000ull / rate));
+                                }
+                            }
+                            senderCpuSeconds = cpuSeconds(RUSAGE_THREAD) - threadCpuBefore;
+                        });
+    sending.join();
+
+    // Let the receiver drain its socket.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const double elapsed{std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+    return BenchmarkResult{sent, received.load(), elapsed, cpuSeconds(RUSAGE_SELF) - cpuBefore - senderCpuSeconds};
+}
+
+void printResult(const std::string &mode, const BenchmarkResult &result, double seconds)
+{
+    const double delivered{(0 == result.sent) ? 0.0 : 100.0 * static_cast<double>(result.received) / static_cast<double>(result.sent)};
+    std::cout << std::setw(12) << std::left << mode << std::right << std::fixed << std::setprecision(1) << " sent " << std::setw(10) << result.sent
+              << ", received " << std::setw(10) << result.received << " (" << delivered << "%), " << std::setw(10)
+              << static_cast<double>(result.received) / seconds << " packets/s, receiver CPU " << 100.0 * result.cpuSeconds / result.seconds << "% of a core"
+              << std::endl;
+}
+
+int32_t main(int32_t argc, char **argv)
+{
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if (0 != commandlineArguments.count("help"))
+    {
+        std::cerr << argv[0] << " compares receiving datagram by datagram with receiving in batches (recvmmsg) over loopback." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " [--size=<bytes>] [--seconds=<s>] [--rate=<packets/s>] [--batch=<n>] [--port=<port>]" << std::endl;
+        std::cerr << "         --size:    payload of a datagram (default: 200)" << std::endl;
+        std::cerr << "         --seconds: sending time per mode (default: 3)" << std::endl;
+        std::cerr << "         --rate:    datagrams sent per second; 0 sends as fast as possible (default: 0)" << std::endl;
+        std::cerr << "         --batch:   datagrams per batch (default: 32)" << std::endl;
+        std::cerr << "         --port:    loopback port (default: 23456)" << std::endl;
+        return 1;
+    }
+
+    const size_t SIZE{(commandlineArguments.count("size") != 0) ? static_cast<size_t>(std::stoi(commandlineArguments["size"])) : 200};
+    const double SECONDS{(commandlineArguments.count("seconds") != 0) ? std::stod(commandlineArguments["seconds"]) : 3.0};
+    const uint64_t RATE{(commandlineArguments.count("rate") != 0) ? static_cast<uint64_t>(std::stoull(commandlineArguments["rate"])) : 0};
+    const uint32_t BATCH{(commandlineArguments.count("batch") != 0) ? static_cast<uint32_t>(std::stoul(commandlineArguments["batch"])) : 32};
+    const uint16_t PORT{static_cast<uint16_t>((commandlineArguments.count("port") != 0) ? std::stoi(commandlineArguments["port"]) : 23456)};
+
+    std::cout << "Datagrams of " << SIZE << " bytes for " << SECONDS << " s per mode at " << ((0 == RATE) ? std::string{"full"} : std::to_string(RATE) + "/s")
+              << " rate." << std::endl;
+    const BenchmarkResult single{runBenchmark(PORT, 1, SIZE, SECONDS, RATE)};
+    printResult("recvfrom", single, SECONDS);
+    const BenchmarkResult batched{runBenchmark(PORT, BATCH, SIZE, SECONDS, RATE)};
+    printResult("recvmmsg/" + std::to_string(BATCH), batched, SECONDS);
+    return 0;
+}